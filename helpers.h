@@ -11,42 +11,619 @@ struct PipedArgs
     char **args1;
     char **args2;
 };
+struct CommandList;
+struct ListEntry
+{
+    int type;       //ENTRY_PIPELINE, or the kind of compound command
+    char **args;    //NULL terminated slice of the list's token array for a pipeline
+    int connector;  //LIST_SEQ, LIST_AND or LIST_OR, how the entry depends on the status of the one before it
+    int background; //boolean, the entry was ended by '&'
+    int negate;     //boolean, the entry started with '!'
+    struct CommandList **parts; //lists making up a compound command, see parseCompound, or the stages of a pipe
+    int partCount;
+    char *name;     //variable of a for loop
+    char **words;   //words of a for loop, NULL for the positional parameters, or the word of a case
+    char ***patterns; //patterns of each case item
+    char **redirs;  //redirections following a compound command, pairs of '<' or '>' and a file name
+    char *text;     //the compound command as written, for the jobs table
+    int needsFork;  //boolean, the subshell changes shell state and can't run in this process
+};
+struct CommandList
+{
+    char **tokens;  //token array every entry points into, only set on the outermost list
+    struct ListEntry *entries;
+    int count;
+};
+struct Parser
+{
+    char **tokens;  //cut into slices while parsing
+    char **words;   //untouched copy of the token pointers
+    int wordCount;
+    int pos;
+};
+struct SavedFd
+{
+    int fd;
+    int saved;      //copy of what fd referred to before the redirection, -1 if it was closed
+};
+struct Program
+{
+    int *code;      //instructions, each an OP_ code followed by its operands
+    int codeLength;
+    int codeCapacity;
+    char *strings;  //every word the code uses, referred to by offset
+    int stringsLength;
+    int stringsCapacity;
+    int slotCount;  //frames the code needs for loops, case words and redirected groups
+    struct Program *bodies; //compiled bodies of the functions the code defines
+    int bodyCount;
+    int references; //users of a program copied for the function table
+    int borrowed;   //boolean, code and strings point into a mapped cache and are not freed with the program
+};
+struct ProgramImage
+{
+    int32_t codeLength; //followed by the code, the strings padded to CACHE_ALIGNMENT and each body's image
+    int32_t stringsLength;
+    int32_t slotCount;
+    int32_t bodyCount;
+};
+struct CacheHeader
+{
+    char magic[8];
+    int32_t version;    //RC_CACHE_VERSION, bumped whenever the bytecode changes
+    uint32_t pathLength; //the rc file's path follows the header, padded to CACHE_ALIGNMENT
+    int64_t size;       //size and modification time of the rc file the cache was made from
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+};
+struct LineBuffer
+{
+    char *text;
+    size_t length;
+    size_t capacity;
+};
+struct Candidates
+{
+    char **names;
+    int count;
+    int capacity;
+};
+struct TrieNode
+{
+    char c;
+    int count;      //PATH directories and built ins providing the name ending here, 0 if there is none
+    int child;      //first child, -1 for none
+    int sibling;    //next child of the same parent in byte order, -1 for none
+};
+struct CommandTrie
+{
+    struct TrieNode *nodes; //node 0 is the root
+    int nodeCount;
+    int nodeCapacity;
+    char *path;     //PATH the trie was built from
+    char **dirs;    //each directory of path
+    int *dirFds;    //open descriptor of each directory, -1 if it couldn't be opened
+    int *watches;   //inotify watch of each directory
+    int dirCount;
+    int inotifyFd;
+    int built;      //boolean
+};
+struct LinuxDirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+struct DirReader
+{
+    int fd;
+    long length;    //bytes getdents64 put in the buffer
+    long offset;    //next entry in the buffer
+    char *buffer;   //DIR_BUFFER_SIZE bytes, aligned for the entries
+};
+struct Substitution
+{
+    int fd;     //end of the pipe given to the command, open across exec. -1 once the shell closed it
+    int other;  //end used by the substituted process, close on exec
+    int output; //boolean, >(cmd) which reads what the command writes
+    char *text; //commands of the substituted process
+    char *path; //the /dev/fd path of fd that replaces the word
+};
+struct Function
+{
+    char *name;
+    struct Program *body;
+    struct Function *next;
+};
+struct LoopLabel
+{
+    int continueTarget;
+    int *breaks;    //jumps to patch to the end of the loop
+    int breakCount;
+    int groupDepth; //redirected groups open when the loop started
+};
+struct Compiler
+{
+    struct Program *program;
+    struct LoopLabel *loops;
+    int loopCount;
+    int loopCapacity;
+    int loopBase;   //loops below this are outside the current subshell
+    int *groups;    //slots of the redirected groups being compiled
+    int groupCount;
+};
+struct Frame
+{
+    char **items;   //words of a for loop or the word of a case, one allocation
+    int itemCount;
+    int index;
+    int status;     //status of the last body command of a loop
+    struct SavedFd *saved; //descriptors replaced by a redirected group, MAX_GROUP_REDIRS of them
+    int savedCount;
+    int open;       //boolean, a redirected group has its descriptors applied
+};
+struct Expansion
+{
+    char *text;     //fields one after another, each NUL terminated
+    size_t length;
+    size_t capacity;
+    size_t *starts; //offset of each field in text
+    int count;
+    int fieldCapacity;
+    char **argv;    //the fields, valid once finishFields has run
+    int fieldOpen;  //boolean
+    int failed;     //boolean, an arithmetic error stopped the expansion
+};
+struct ArithNode
+{
+    int type;       //ARITH_NUMBER, ARITH_VARIABLE, ARITH_UNARY and so on
+    int op;         //operator, packed by ARITH_OP when it has more than one character
+    int64_t value;  //for a number
+    char *name;     //for a variable
+    int left;       //operands, as indexes of other nodes
+    int right;
+    int third;
+};
+struct ArithExpr
+{
+    char *text;     //the expression as written, the key in the cache
+    struct ArithNode *nodes;
+    int nodeCount;
+    int nodeCapacity;
+    int root;
+    struct ArithExpr *next;
+};
+struct ArithParser
+{
+    struct ArithExpr *expr;
+    char *p;
+    int token;
+    int64_t number;
+    char *name;
+    size_t nameLength;
+    int error;      //boolean
+};
+struct Var
+{
+    char *name;
+    char *value;
+    int exported;   //boolean
+    struct Var *next;
+};
+struct Process
+{
+    int pid;
+    int pidfd;  //-1 when the kernel has no pidfd support
+    int done;   //boolean
+    int status; //waitpid format, valid once done
+    int auxiliary; //boolean, a substituted process whose status isn't the job's
+};
+struct FinishedJob
+{
+    int task_no;
+    int pid_no;
+    int status; //exit status of the job, kept for wait after the job left the table
+};
+struct AllocSite
+{
+    const char *function; //NULL for an unused entry
+    int line;
+    long calls;
+    long long bytes;
+    long lineCalls;       //made by the command line being run
+    long long lineBytes;
+    long lastCalls;       //made by the command line before it
+    long long lastBytes;
+    long liveBlocks;      //allocated here and not freed yet
+    long long liveBytes;
+};
+struct AllocBlock
+{
+    void *pointer;        //NULL for an empty entry
+    size_t size;
+    int site;
+};
+struct ServeWorker
+{
+    int pid;        //0 for a free slot
+    int pidfd;
+    int connection; //answered with the exit status once the worker is done
+    int status;     //waitpid format, for a worker reaped without a pidfd
+};
+struct Timer
+{
+    int pid_no;         //job the timer belongs to
+    long long deadline; //ms on CLOCK_MONOTONIC
+    int signal;         //the job's timeout signal when the time limit runs out, then SIGKILL
+    struct Timer *next; //next timer in the same wheel slot
+};
 struct Job
 {
     char *line;
-    int pid_no;
+    int pid_no; //pid of the first process started for the job
     int runningStatus; //boolean
     int task_no;
+    struct Process *procs;
+    int procCount;
+    int timeoutMs;   //time limit set with the timeout prefix, 0 for none
+    int killAfterMs; //time between SIGTERM and SIGKILL once the limit runs out
+    int timedOut;    //boolean, the time limit ran out
+    int timeoutSignal;  //signal sent when the time limit runs out, SIGTERM unless timeout -s gave another
+    int preserveStatus; //boolean, timeout --preserve-status, the job keeps its own status when the limit runs out
+    struct Timer *timer; //pending timer of the job, NULL when there is none
+    int pgid;            //process group of the job, only looked up for a timed job or while a job board is open
+    long long startedNs; //ns on CLOCK_REALTIME its first process started at
+    int queued;          //boolean, started by the queue built in and counted against its limit
+    int hidden;          //boolean, the job of builtin | cmd while the built in runs, which the built in doesn't see
+};
+struct LoadedBuiltin
+{
+    char *name;                 //the command name, a copy of builtin->name
+    char *path;                 //library it was loaded from, as given to enable
+    void *handle;               //from dlopen, closed when the built in is disabled
+    struct YashBuiltin *builtin;
+};
+struct ReadWindow
+{
+    char *data;     //bytes of the file at offset, READ_CHUNK of them at most
+    size_t length;
+    off_t offset;
+    dev_t dev;      //file the bytes came from, with its size and change time to tell when they went stale
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+};
+struct QueuedJob
+{
+    char **args;  //expanded words of the command, each its own copy
+    char *line;   //the words joined, for the jobs table
+    int priority; //higher runs sooner, ties in the order they were queued
 };
 char *readLineIn(void);
-char **parseLine(char *line);
+char **parseLine(char *line, int *incomplete);
+char *nextToken(char *p, char **start, size_t *length, int *incomplete);
+char *skipWordPart(char *p, int *incomplete);
+size_t plainRun(char *p);
+size_t plainRunScalar(char *p);
+size_t plainRunSse2(char *p);
+size_t plainRunAvx2(char *p);
+char *skipBracketed(char *p);
+int parseList(char *line, struct CommandList *list);
+int parseEntries(struct Parser *parser, struct CommandList *list, char **closers);
+int parseCommand(struct Parser *parser, struct ListEntry *entry);
+int parsePipe(struct Parser *parser, struct ListEntry *entry);
+struct CommandList *addStage(struct ListEntry *entry);
+int parseCompound(struct Parser *parser, struct ListEntry *entry);
+int parseFunction(struct Parser *parser, struct ListEntry *entry);
+int parsePart(struct Parser *parser, struct ListEntry *entry, char **closers, int allowEmpty);
+int parseForHead(struct Parser *parser, struct ListEntry *entry);
+int parseCaseItems(struct Parser *parser, struct ListEntry *entry);
+int parseRedirections(struct Parser *parser, struct ListEntry *entry);
+int expectWord(struct Parser *parser, char *word);
+void skipNewlines(struct Parser *parser);
+int changesShellState(struct CommandList *list);
+int isStateBuiltIn(char *name);
+int isLoopControl(char *name);
+int hasArithmetic(char **words);
+int isListOperator(char *token);
+int isFunctionStart(char **words, int pos);
+int isCompoundStart(char *token);
+int isReservedCloser(char *token);
+int isWordIn(char *word, char **list);
+int syntaxError(char *token);
+void freeList(struct CommandList *list);
+char *joinArgs(char **args, int inBackground);
+char *joinWords(char **words, int count, int inBackground);
+void compileProgram(struct Program *program, struct CommandList *list);
+int runText(char *text);
+char *readFile(char *path);
+int loadRcFile(void);
+int loadProgramCache(char *cachePath, char *path, struct stat *st, struct Program *program, void **map, size_t *mapSize);
+int mapProgramImage(char **cursor, char *end, struct Program *program);
+int validateProgram(struct Program *program);
+int isCacheString(struct Program *program, int offset);
+int isCacheTarget(char *starts, int length, int target);
+void saveProgramCache(char *cachePath, char *path, struct stat *st, struct Program *program);
+int writeProgramImage(FILE *file, struct Program *program, uint32_t *checksum);
+int writeCachePadded(FILE *file, char *data, size_t length, uint32_t *checksum);
+int writeCache(FILE *file, const void *data, size_t length, uint32_t *checksum);
+size_t cacheAlign(size_t length);
+void compileList(struct Compiler *compiler, struct CommandList *list);
+void compileEntry(struct Compiler *compiler, struct ListEntry *entry);
+void compilePipeline(struct Compiler *compiler, struct ListEntry *entry);
+void compileFunction(struct Compiler *compiler, struct ListEntry *entry);
+void compileLoopJump(struct Compiler *compiler, int isBreak, int count);
+void compileSubshell(struct Compiler *compiler, struct ListEntry *entry);
+void compilePipe(struct Compiler *compiler, struct ListEntry *entry);
+void compileRedirected(struct Compiler *compiler, struct ListEntry *entry);
+void compileCompound(struct Compiler *compiler, struct ListEntry *entry);
+void pushLoop(struct Compiler *compiler, int top);
+void popLoop(struct Compiler *compiler);
+void initProgram(struct Program *program);
+void freeProgram(struct Program *program);
+int emit(struct Program *program, int value);
+int emitJump(struct Program *program, int op);
+void patchJump(struct Program *program, int index);
+void emitStatus(struct Program *program, int status);
+int addWord(struct Program *program, char *word);
+int operatorIndex(char *word);
+int isOperator(char *word, int op);
+int isOperatorWord(char *word);
+int addString(struct Program *program, char *text);
+int runProgram(struct Program *program, int start, int end);
+int isTailPosition(int *code, int pc, int end);
+void runSubshell(struct Program *program, int start, int end, char *text, int inBackground);
+void runPipe(struct Program *program, int start, int *ends, int count, char *text);
+int callsFunction(struct Program *program, int start, int end);
+int instructionLength(int *code, int pc);
+char **copyWords(char **words, int count);
+void initExpansion(struct Expansion *expansion);
+void freeExpansion(struct Expansion *expansion);
+char **expandWords(struct Expansion *expansion, char *strings, int *offsets, int count, int expand);
+char *expandString(struct Expansion *expansion, char *word, int mode);
+void expandWord(struct Expansion *expansion, char *word, int mode);
+char *expandParameter(struct Expansion *expansion, char *p, int inDouble, int mode);
+void expandText(struct Expansion *expansion, char *p, char *end, int mode);
+char *parameterValue(char *name, size_t length, char *number, size_t size);
+size_t parameterNameLength(char *p, char *end);
+struct Expansion *takeScratch(void);
+int expandScratchField(struct Expansion *scratch, char *p, char *end, int mode);
+char *findUnquoted(char *p, char *end, char c);
+void expandBraced(struct Expansion *expansion, char *body, char *close, int inDouble, int mode);
+void sliceValue(struct Expansion *expansion, struct Expansion *scratch, int offsetField, int lengthField, char *value,
+                int inDouble, int mode);
+void trimValue(struct Expansion *expansion, struct Expansion *scratch, int patternField, int stringField, char kind,
+               int twice, int anchor, char *value, int inDouble, int mode);
+int findMatch(char *value, char *copy, size_t valueLength, char *pattern, size_t patternLength, int literal,
+              int anchor, int longest, size_t from, size_t *start, size_t *length);
+int unescapeLiteral(char *pattern);
+int detectSimd(void);
+char *findLiteral(char *haystack, size_t length, char *needle, size_t needleLength);
+char *findLiteralSse2(char *haystack, size_t length, char *needle, size_t needleLength);
+char *findLiteralAvx2(char *haystack, size_t length, char *needle, size_t needleLength);
+void appendText(struct Expansion *expansion, char *text, size_t length, int quoted, int mode);
+void appendOperator(struct Expansion *expansion, int op);
+void openField(struct Expansion *expansion);
+void closeField(struct Expansion *expansion);
+char **finishFields(struct Expansion *expansion);
+void reserveText(struct Expansion *expansion, size_t length);
+void reserveFields(struct Expansion *expansion, int count);
+char *expandArithmetic(struct Expansion *expansion, char *p, int inDouble, int mode);
+int evaluateArithmetic(char *text, int64_t *value);
+struct ArithExpr *parseArithmetic(char *text);
+void nextArithToken(struct ArithParser *parser);
+int parseArithComma(struct ArithParser *parser);
+int parseArithAssign(struct ArithParser *parser);
+int parseArithTernary(struct ArithParser *parser);
+int parseArithBinary(struct ArithParser *parser, int minPrecedence);
+int parseArithUnary(struct ArithParser *parser);
+int parseArithPrimary(struct ArithParser *parser);
+int addArithNode(struct ArithParser *parser, int type, int op, int left, int right, int third);
+int arithPrecedence(int op);
+int isArithAssignOp(int op);
+int arithAssignToBinary(int op);
+int64_t arithValue(struct ArithExpr *expr, int index, int *error);
+int64_t arithApply(int op, int64_t left, int64_t right, int *error);
+int64_t arithVariable(char *name, int *error);
+void setArithVariable(char *name, int64_t value);
+void freeArithExpr(struct ArithExpr *expr);
+void clearArithCache(void);
+int isAssignment(char *word);
+int isValidName(char *name, size_t length);
+unsigned int hashName(char *name, size_t length);
+unsigned int hashBytes(unsigned int hash, const void *data, size_t length);
+struct Var *findVar(char *name, size_t length);
+char *getVar(char *name, size_t length);
+void setVar(char *name, char *value);
+void unsetVar(char *name);
+void importEnvironment(void);
+int yash_export(char **args);
+int yash_unset(char **args);
+struct Function *findFunction(char *name);
+void defineFunction(char *name, struct Program *body);
+void unsetFunction(char *name);
+int callFunction(struct Function *function, char **args);
+int execCommand(char **args);
+struct Program *copyProgram(struct Program *program);
+void releaseProgram(struct Program *program);
+int startCommand(char **args, int inBackground, int inputPiped, int capacity, int adaptive);
+int startProcesses(char **args, int inBackground, int inputPiped, int capacity, int adaptive);
+int isSubstitution(char *word);
+int hasSubstitution(char **args);
+int prepareSubstitutions(char **args);
+void enterJobGroup(pid_t pid);
+void setTerminalGroup(pid_t pgid);
+void launchSubstitutions(int pgid);
+void finishSubstitutions(void);
+void closeSubstitutionEnds(int commandEnds);
+void restoreEnvironment(char **saved, int count);
+char **setPrefixVars(char **args, int count);
+void restoreVars(char **saved, int count);
+int isBuiltIn(char *name);
+int runBuiltIn(char **args);
+int rewritePipeline(struct PipedArgs *piped);
+int isPlainCat(char **args, int operands);
+void traceRewrite(struct PipedArgs *piped, int rewrite);
+int startProducerPipe(char **args1, char **args2, int capacity);
+int takeRedirections(char **args, char **redirs);
+int applyRedirections(char **redirs, struct SavedFd *saved);
+void restoreRedirections(struct SavedFd *saved, int savedCount);
+void enterSubshell(void);
+int yash_cd(char **args);
+int yash_exit(char **args);
+int statusToExitCode(int status);
 int countArgs(char **args);
 int pipeQty(char **args);
-int pipeBGExclusive(char **args);
 struct PipedArgs getTwoArgs(char **args);
 void yash_fg(struct Job *jobs, int activeJobSize, int *pActiveJobSize);
 void yash_bg(struct Job *jobs, int activeJobSize);
 int yash_jobs(struct Job *jobs, int activeJobsSize);
 int containsInRedir(char **args);
 int containsOutRedir(char **args);
-void addToJobs(struct Job *jobs, char *line, int *activeJobsSize);
+void addToJobs(struct Job **pJobs, char *line, int *activeJobsSize, int *jobsCapacity);
 void startJobsPID(struct Job *jobs, int pid, int activeJobsSize);
 void removeFromJobs(struct Job *jobs, int pid, int *activeJobsSize);
 void setJobStatus(struct Job *jobs, int pid, int activeJobsSize, int runningStatus);
 void killProcs(struct Job *jobs, int *activeJobsSize);
-int containsAmp(char **args);
 void removeLastFromJobs(struct Job *jobs, int *activeJobsSize);
-void removeAmp(char **args);
 void removeRedirArgs(char **args, int redirIndex);
 void fg_handler(int signo);
+char *editLine(void);
+void appendLine(struct LineBuffer *line, char *text, size_t length);
+void eraseChars(struct LineBuffer *line, size_t count);
+void redrawLine(struct LineBuffer *line);
+void writeText(char *text, size_t length);
+void writeAll(int fd, char *text, size_t length);
+void buildPrompt(void);
+void startPromptHelper(void);
+void stopPromptHelper(void);
+void readPromptSegments(struct LineBuffer *line);
+void findGitSegment(char *value, size_t size);
+void findLoadSegment(char *value, size_t size);
+int captureOutput(char **args, char *value, size_t size);
+void completeLine(struct LineBuffer *line, int listCandidates);
+void listCompletions(struct Candidates *candidates);
+void addCandidate(struct Candidates *candidates, char *name, size_t length);
+void completeCommand(char *prefix, struct Candidates *candidates);
+void collectTrieNames(struct CommandTrie *trie, int node, struct LineBuffer *name, struct Candidates *candidates);
+int findTrieChild(struct CommandTrie *trie, int node, char c);
+int addTrieName(struct CommandTrie *trie, char *name);
+void buildCommandTrie(struct CommandTrie *trie, char *path);
+void scanCommandDir(struct CommandTrie *trie, int dirFd);
+void updateCommandTrie(struct CommandTrie *trie);
+void recountCommand(struct CommandTrie *trie, char *name);
+char **completedBuiltIns(void);
+int isExecutableAt(int dirFd, char *name, unsigned char type);
+void freeCommandTrie(struct CommandTrie *trie);
+void completeFilename(char *word, struct Candidates *candidates);
+int compareNames(const void *a, const void *b);
+struct LinuxDirent64 *nextDirEntry(struct DirReader *reader);
 static void proc_exit(int signo);
+void reapJobs(struct Job *jobs, int *activeJobsSize);
+int reapProcess(struct Job *jobs, int pid, int *activeJobsSize);
+int reportIfFinished(struct Job *jobs, int i, int *activeJobsSize);
+int waitProcess(struct Process *proc, int options, int *status);
+void finishProcess(struct Process *proc, int status);
+void waitForJob(struct Job *jobs, int pid, int *activeJobsSize);
+int collectProcess(struct Job *jobs, int pid, int activeJobsSize);
+int jobExitCode(struct Job *job);
+int jobFinished(struct Job *job);
+void rememberFinishedJob(struct Job *job);
+int yash_wait(char **args);
+int findJobOperand(char *operand);
+int takeJobStatus(int pid, int *status);
+void collectUntracked(void);
+int parseTimeout(char **args, int *timeoutMs, int *killAfterMs, int *signo, int *preserveStatus);
+int parseSignal(char *text);
+int parseDuration(char *text, int *ms);
+long long monotonicMs(void);
+void startJobTimer(struct Job *job);
+void addTimer(struct Timer *timer);
+void cancelTimer(struct Timer *timer);
+void runTimers(void);
+void fireTimer(struct Timer *timer);
+void signalJob(struct Job *job, int signo);
+void armTimerFd(void);
+void clearTimers(void);
+int openTimerFd(void);
+int yash_read(char **args);
+int readRecord(int fd, struct LineBuffer *line);
+int readFileRecord(int fd, struct stat *st, struct LineBuffer *line);
+int readPeekedRecord(int fd, int isSocket, struct LineBuffer *line);
+ssize_t peekInput(int fd, int isSocket, char *buffer, size_t length);
+int readByteRecord(int fd, struct LineBuffer *line);
+char *nextReadField(char **text, char *ifs, int raw, int rest);
+int yash_queue(char **args);
+int yash_enable(char **args);
+int loadBuiltin(char *path, char *name);
+void unloadBuiltin(int index);
+struct LoadedBuiltin *findLoadedBuiltin(char *name);
+int runLoadedBuiltin(struct LoadedBuiltin *loaded, char **args);
+const char *pluginGetVar(const char *name);
+int pluginSetVar(const char *name, const char *value);
+int pluginUnsetVar(const char *name);
+void enqueueJob(char **args, int priority);
+int admitQueued(void);
+void startQueuedJob(struct QueuedJob *queued);
+int runningQueuedJobs(void);
+int queueOverloaded(void);
+double readPressure(char *path);
+void startQueueTimer(void);
+void clearQueue(void);
+int openJobBoard(char *name);
+int isStaleJobBoard(char *name);
+void closeJobBoard(void);
+void publishJobs(void);
+int yash_allocs(char **args);
+void startAllocLine(void);
+void *accountMalloc(size_t size, const char *function, int line);
+void *accountCalloc(size_t count, size_t size, const char *function, int line);
+void *accountRealloc(void *pointer, size_t size, const char *function, int line);
+char *accountStrdup(const char *text, const char *function, int line);
+char *accountStrndup(const char *text, size_t length, const char *function, int line);
+void accountFree(void *pointer);
+void *recordBlock(void *pointer, size_t size, const char *function, int line);
+void restoreBlock(struct AllocBlock *block);
+void insertBlock(void *pointer, size_t size, int s);
+size_t forgetBlock(void *pointer);
+int findAllocSite(const char *function, int line);
+struct AllocBlock *findBlock(void *pointer);
+int compareSites(const void *a, const void *b);
+size_t hashBlock(void *pointer);
+int waitJobProcess(struct Process *proc, int *status);
+int findJob(struct Job *jobs, int pid, int activeJobsSize);
 int setRedirIn(char **args, int redirIn, FILE *readFilePointer, int argCount);
 int setRedirOut(char **args, int redirOut, FILE *writeFilePointer, int argCount);
+int setMultiRedirOut(char **args, int argCount, int targets);
+int startFanOutOperation(char **args, int fanOuts, int capacity);
+void execSegment(char **args);
+int fanOutQty(char **args);
+void startFanOut(int *outputs, int count);
+void fanOut(int input, int *outputs, int count);
+int teeStage(int i, ssize_t chunk, ssize_t teed, int *ins, int (*chains)[2], int (*privates)[2], int *outputs);
+int spliceAll(int in, int out, ssize_t length);
+void copyFanOut(int input, int *outputs, int count);
+int serveCommands(char *path, int limit);
+int isOwnPeer(int connection);
+int startServeWorker(struct ServeWorker *worker, int w, int connection, char *text, int serveEpoll, int workerEpoll);
+int finishServeWorker(struct ServeWorker *worker, int serveEpoll);
+ssize_t receiveRequest(int connection, char *text, int *fds);
+int runClient(char *path, char *command);
+int yash_pipesize(char **args);
+int parsePipeSize(char *text, int *capacity, int *adaptive);
+int maxPipeCapacity(void);
+int setPipeCapacity(int fd, int capacity);
+void monitorPipe(int readFd, struct Job *job);
 
 //#include "helpers.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/wait.h>
 
 #define MAX_INPUT_LENGTH 200
 #define DELIMS " \n"
@@ -54,9 +631,151 @@ int setRedirOut(char **args, int redirOut, FILE *writeFilePointer, int argCount)
 #define BUILT_IN_FG "fg"
 #define BUILT_IN_BG "bg"
 #define BUILT_IN_JOBS "jobs"
+#define BUILT_IN_PIPESIZE "pipesize"
+#define BUILT_IN_CD "cd"
+#define BUILT_IN_EXIT "exit"
+#define BUILT_IN_EXPORT "export"
+#define BUILT_IN_UNSET "unset"
+#define BUILT_IN_TRUE "true"
+#define BUILT_IN_FALSE "false"
+#define BUILT_IN_COLON ":"
+#define BUILT_IN_RETURN "return"
+#define BUILT_IN_BREAK "break"
+#define BUILT_IN_CONTINUE "continue"
+#define BUILT_IN_WAIT "wait"
+#define BUILT_IN_ALLOCS "allocs"
+#define BUILT_IN_QUEUE "queue"
+#define BUILT_IN_READ "read"
+#define BUILT_IN_ENABLE "enable"
+#define BUILTIN_SYMBOL_PREFIX "yash_builtin_"
+#define LOADED_BUILTINS_INITIAL 8
+#define TIMEOUT_PREFIX "timeout"
+#define PIPESIZE_PREFIX "YASH_PIPESIZE="
+#define FAN_OUT_OPERATOR "|+"
+#define OPERATOR_PIPE 0
+#define OPERATOR_FAN_OUT 1
+#define OPERATOR_IN 2
+#define OPERATOR_OUT 3
+#define OPERATOR_COUNT 4
+#define OPERATOR_FIELD(op) (SIZE_MAX - (size_t) (op)) //start of an operator field in an expansion
+#define REWRITE_NONE 0
+#define REWRITE_CAT_INPUT 1
+#define REWRITE_TRAILING_CAT 2
+#define REWRITE_PRODUCER 3
+#define DEFAULT_PIPE_MAX_SIZE 1048576
+#define PIPE_MONITOR_INTERVAL_MS 5
 #define MAX_NUMBER_JOBS 50
 #define RUNNING 1
 #define STOPPED 0
+#define LIST_SEQ 0
+#define LIST_AND 1
+#define LIST_OR 2
+#define ENTRY_PIPELINE 0
+#define ENTRY_BRACE 1
+#define ENTRY_SUBSHELL 2
+#define ENTRY_IF 3
+#define ENTRY_WHILE 4
+#define ENTRY_UNTIL 5
+#define ENTRY_FOR 6
+#define ENTRY_CASE 7
+#define ENTRY_FUNCTION 8
+#define ENTRY_PIPE 9 //a pipeline with a compound command as one of its stages
+#define PARSE_ERROR -1
+#define PARSE_INCOMPLETE -2
+#define OP_PIPELINE 1
+#define OP_ASSIGN 2
+#define OP_JUMP 3
+#define OP_JUMP_IF_FALSE 4
+#define OP_JUMP_IF_TRUE 5
+#define OP_NOT 6
+#define OP_STATUS 7
+#define OP_LOOP_STATUS 8
+#define OP_GROUP_BEGIN 9
+#define OP_GROUP_END 10
+#define OP_SUBSHELL 11
+#define OP_FOR_BEGIN 12
+#define OP_FOR_NEXT 13
+#define OP_CASE_WORD 14
+#define OP_CASE_MATCH 15
+#define OP_FUNCTION 16
+#define OP_RETURN 17
+#define OP_PIPE 18
+#define PIPELINE_BACKGROUND 1
+#define PIPELINE_EXPAND 2
+#define SUBSHELL_FORK 2 //flag of OP_SUBSHELL, the subshell changes shell state and always forks
+#define LOOP_STATUS_CLEAR 0
+#define LOOP_STATUS_SAVE 1
+#define LOOP_STATUS_RESTORE 2
+#define EXPANSION_CHARS "$'\"\\~"
+#define EXPAND_FIELDS 0
+#define EXPAND_SPLIT 1
+#define EXPAND_STRING 2
+#define EXPAND_PATTERN 3
+#define BRACED_SCRATCH_DEPTH 8
+#define SIMD_UNKNOWN -1
+#define SIMD_SCALAR 0
+#define SIMD_SSE2 1
+#define SIMD_AVX2 2
+#define VAR_TABLE_SIZE 256
+#define FUNCTION_TABLE_SIZE 64
+#define RC_FILE_NAME ".yashrc"
+#define RC_CACHE_SUFFIX ".cache"
+#define RC_CACHE_MAGIC "yashrc\0\0"
+#define RC_CACHE_VERSION 7
+#define CACHE_ALIGNMENT 8
+#define FNV_BASIS 2166136261u
+#define CTRL_KEY(k) ((k) & 0x1f)
+#define COMPLETION_LIST_LIMIT 200
+#define INOTIFY_BUFFER_SIZE 4096
+#define DIR_BUFFER_SIZE 32768
+#define ARITH_CACHE_SIZE 128
+#define ARITH_CACHE_LIMIT 512
+#define ARITH_OP(a, b, c) ((a) | ((b) << 8) | ((c) << 16)) //packs a multi-character operator into one token
+#define ARITH_END -1
+#define ARITH_LITERAL -2
+#define ARITH_NAME -3
+#define ARITH_NUMBER 0
+#define ARITH_VARIABLE 1
+#define ARITH_UNARY 2
+#define ARITH_BINARY 3
+#define ARITH_ASSIGN 4
+#define ARITH_TERNARY 5
+#define ARITH_PREFIX 6
+#define ARITH_POSTFIX 7
+#define MAX_GROUP_REDIRS 16
+#define SAVED_FD_BASE 10
+#define MAX_REAP_EVENTS 64
+#define FINISHED_JOBS_LIMIT 64
+#define TIMED_OUT_STATUS 124
+#define TIMEOUT_FAILED_STATUS 125
+#define TIMEOUT_KILL_AFTER_MS 5000
+#define TIMER_WHEEL_SLOTS 256
+#define TIMER_TICK_MS 10
+#define TIMER_EPOLL_KEY 0
+#define QUEUE_RECHECK_MS 1000
+#define READ_CHUNK 65536
+#define READ_PEEK_INITIAL 4096
+#define DEFAULT_IFS " \t\n"
+#define YASH_P_PIDFD ((idtype_t) 3) //P_PIDFD, missing from older C libraries
+#define SERVE_MESSAGE_MAX 65536
+#define TAIL_JUMP_LIMIT 16
+#define PROMPT_GIT 0
+#define PROMPT_LOAD 1
+#define PROMPT_SEGMENT_COUNT 2
+#define PROMPT_SEGMENT_MAX 256
+#define ALLOC_SITE_LIMIT 1024
+#define ALLOC_BLOCKS_INITIAL 1024
+
+// built with -DYASH_ALLOC_STATS=ON every allocation made by the shell is counted under the function and line that
+// made it, for the allocs built in
+#ifdef YASH_ALLOC_STATS
+#define malloc(size) accountMalloc(size, __func__, __LINE__)
+#define calloc(count, size) accountCalloc(count, size, __func__, __LINE__)
+#define realloc(pointer, size) accountRealloc(pointer, size, __func__, __LINE__)
+#define strdup(text) accountStrdup(text, __func__, __LINE__)
+#define strndup(text, length) accountStrndup(text, length, __func__, __LINE__)
+#define free(pointer) accountFree(pointer)
+#endif
 
 //global vars
 int shell_pid;
@@ -1,15 +1,42 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "yash_builtin.h"
+#include "yash_board.h"
 #include "helpers.h"
 #include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <limits.h>
+#include <ctype.h>
+#include <fnmatch.h>
+#include <sys/mman.h>
+#include <termios.h>
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <pwd.h>
+#include <dlfcn.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 //function declarations
-int executeLine(char **args, char *line);
+int executeLine(char **args, char *line, int inBackground);
 void mainLoop(void);
-int startPipedOperation(char **args1, char **args2);
+int startPipedOperation(char **args1, char **args2, int capacity, int adaptive);
 int startOperation(char **args);
 int startBgOperation(char **args);
 static void sig_int(int signo);
@@ -19,18 +46,196 @@ static void sig_handler(int signo);
 // Global Vars
 int pid_ch1 = -1, pid_ch2 = -1, pid = -1;
 int activeJobsSize; //goes up and down as jobs finish
+int jobsCapacity;   //allocated size of the jobs table, grows as needed
 struct Job *jobs;
 int *pactiveJobsSize = &activeJobsSize;
+int jobsEpollFd = -1; //epoll set of every tracked pidfd, readable entries are finished processes
+volatile sig_atomic_t childExited = 0; //set by SIGCHLD, children are reaped outside of signal context
+volatile sig_atomic_t childSignals = 0; //counts SIGCHLD deliveries so a wait loop can tell a child changed state
+volatile sig_atomic_t interrupts = 0; //counts SIGINT deliveries so wait can tell ctrl+c came with a SIGCHLD
+int pipeCapacity = 0; //capacity given to new pipes, 0 keeps the kernel default. set with the pipesize built in
+int pipeAdaptive = 0; //boolean, grow a pipeline's pipe while its producer is blocked on it
+int lastStatus = 0; //exit status of the last command, decides whether && and || run the next one
+int lastBackgroundPid = -1; //pid of the last job started in the background, for $!
+char *shellName = "yash"; //$0
+char **positionalParams = NULL; //$1 and on, without a copy of their text
+int positionalCount = 0;
+struct Var *varTable[VAR_TABLE_SIZE]; //shell variables, chained by hash of the name
+struct Function *functionTable[FUNCTION_TABLE_SIZE]; //shell functions, chained by hash of the name
+int functionCount = 0;
+struct ArithExpr *arithCache[ARITH_CACHE_SIZE]; //parsed $(( )) expressions, chained by hash of their text
+int arithCacheCount = 0;
+char *promptText = "# "; //prompt the line editor prints again when it redraws the line
+char *promptLine = NULL; //primary prompt built from PS1
+char *promptSegments[PROMPT_SEGMENT_COUNT]; //last values of the slow prompt segments, NULL until the helper sends one
+char *promptSegmentsDir = NULL; //directory the prompt helper last ran in
+int promptHelperPid = -1; //process finding the slow prompt segments, -1 when there is none
+int promptHelperFd = -1; //read end of its pipe
+char promptHelperBuffer[PROMPT_SEGMENT_MAX + 3]; //what it sent that isn't a whole segment yet
+size_t promptHelperLength = 0;
+long long lastCommandMs = 0; //how long the last command line took to run, for \T
+struct CommandTrie commandTrie; //command names for completion, built on the first TAB
+struct Substitution *substitutions = NULL; //<(cmd) and >(cmd) words of the command being started
+int substitutionCount = 0;
+struct FinishedJob finishedJobs[FINISHED_JOBS_LIMIT]; //background jobs reported as done, oldest first, for wait
+int finishedJobCount = 0;
+struct Timer *timerWheel[TIMER_WHEEL_SLOTS]; //time limits of jobs, in the slot of the tick they run out on
+int timerCount = 0;
+long long wheelTime = 0; //ms on CLOCK_MONOTONIC the wheel has been advanced to
+int timerFd = -1; //timerfd in the jobs epoll set, armed for the next wheel slot holding a timer
+struct QueuedJob *queuedJobs = NULL; //commands waiting for the queue built in to start them, in the order they'll run
+int queuedCount = 0;
+int queuedCapacity = 0;
+int queueLimit = 0;           //queued jobs allowed to run at once, 0 for one per processor
+double queueMaxLoad = -1;     //1 minute load average above which nothing more is started, -1 for the processor count
+double queueMaxPressure = 0;  //percentage of time stalled over the last 10s on cpu, io or memory, 0 for no limit
+struct Timer *queueTimer = NULL; //pending check of the load limits while they hold back the queue
+int queueDue = 0; //boolean, the queue timer ran out during runTimers
+struct ReadWindow readWindow; //last chunk of a regular file read by the read built in
+struct Expansion bracedScratch[BRACED_SCRATCH_DEPTH]; //pattern and string of a ${...} operator, one per nesting level
+int scratchDepth = 0;
+int simdLevel = SIMD_UNKNOWN; //vector instructions the processor has, found on first use by detectSimd
+int readScratch[2] = {-1, -1}; //pipe the read built in tees a piped stdin into to look ahead without consuming
+struct LoadedBuiltin *loadedBuiltins = NULL; //built ins loaded from libraries by enable -f, in the order they came
+int loadedCount = 0;
+int loadedCapacity = 0;
+int tailExecEnabled = 1; //boolean, a process about to exit execs its last command instead of forking it. --notailexec
+int execTail = 0; //boolean, set just before a runProgram whose last command may replace the process
+int execInPlace = 0; //boolean, the command being started replaces the shell instead of running in a child
+int pipelineRewrite = 1; //boolean, pipelines are run with fewer processes where that can't be told apart. --norewrite
+int showRewrites = 0; //boolean, print the rewritten form of a pipeline on stderr. --showrewrite
+int jobGroup = -1; //group of the timed foreground job being started, 0 before its first process, -1 for the shell's
+int terminalShell = 0; //boolean, the shell is the foreground of its terminal and hands it to jobs in their own group
+// the operators a command's words can hold, indexed by OPERATOR_ number. expansion points a word at one of these
+// strings only when it was that operator unquoted, so quoted or expanded text that reads the same is never one
+char *operatorWords[OPERATOR_COUNT] = {"|", FAN_OUT_OPERATOR, "<", ">"};
+struct JobBoard *jobBoard = NULL; //shared memory copy of the jobs table, NULL without --board
+char *jobBoardName = NULL;
+int jobBoardOwner = 0; //pid of the shell writing the board, forked children that still hold the mapping don't
+#ifdef YASH_ALLOC_STATS
+struct AllocSite allocSites[ALLOC_SITE_LIMIT]; //call sites of malloc and the others, hashed by line
+struct AllocBlock *allocBlocks = NULL; //live blocks by address, open addressing with linear probing
+size_t allocBlockCapacity = 0; //a power of two
+size_t allocBlockCount = 0;
+#endif
 
-//main to take arguments and start a loop
+//main to take arguments and start a loop. 'yash -c command [name [arg...]]' runs command, 'yash file [arg...]' runs
+//the file as a script and with neither the shell reads commands from stdin. ~/.yashrc runs first unless --norc is given
+//and 'yash --serve socket [--limit n]' serves commands sent by 'yash --client socket -c command' on a unix socket.
+//--notailexec keeps the shell from replacing itself with the last command of -c, a script or a subshell, and
+//--board name keeps a copy of the jobs table in the shared memory object name for monitors to read. --norewrite runs
+//every stage of a pipeline in a process of its own and --showrewrite prints the pipelines that were rewritten
 int main(int argc, char **argv)
 {
-    jobs = malloc(sizeof(struct Job) * MAX_NUMBER_JOBS);
+    char *command = NULL;
+    char *script = NULL;
+    char *servePath = NULL;
+    char *clientPath = NULL;
+    char *boardName = NULL;
+    int serveLimit = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int noRc = 0;
+    int argi = 1;
 
-    mainLoop();
+    for(; argi < argc && argv[argi][0] == '-'; argi++)
+    {
+        if(strcmp(argv[argi], "--norc") == 0)
+            noRc = 1;
+        else if(strcmp(argv[argi], "--notailexec") == 0)
+            tailExecEnabled = 0;
+        else if(strcmp(argv[argi], "--norewrite") == 0)
+            pipelineRewrite = 0;
+        else if(strcmp(argv[argi], "--showrewrite") == 0)
+            showRewrites = 1;
+        else if(strcmp(argv[argi], "--serve") == 0 && argi + 1 < argc)
+            servePath = argv[++argi];
+        else if(strcmp(argv[argi], "--board") == 0 && argi + 1 < argc)
+            boardName = argv[++argi];
+        else if(strcmp(argv[argi], "--client") == 0 && argi + 1 < argc)
+            clientPath = argv[++argi];
+        else if(strcmp(argv[argi], "--limit") == 0 && argi + 1 < argc && atoi(argv[argi + 1]) > 0)
+            serveLimit = atoi(argv[++argi]);
+        else if(strcmp(argv[argi], "-c") == 0 && argi + 1 < argc)
+            command = argv[++argi];
+        else if(strcmp(argv[argi], "--") == 0)
+        {
+            argi++;
+            break;
+        } else
+        {
+            fprintf(stderr, "usage: yash [--norc] [--notailexec] [--norewrite] [--showrewrite] [--board name]\n"
+                            "            [-c command [name [arg...]] | file [arg...]]\n"
+                            "       yash [--norc] --serve socket [--limit n]\n"
+                            "       yash --client socket -c command\n");
+            return 2;
+        }
+        if(command)
+        {
+            argi++;
+            break;
+        }
+    }
+    if(!command && argi < argc) script = argv[argi++];
+    if(clientPath)
+    {
+        if(!command)
+        {
+            fprintf(stderr, "yash: --client needs -c command\n");
+            return 2;
+        }
+        return runClient(clientPath, command);
+    }
+    if(serveLimit < 1) serveLimit = 1;
+
+    jobsCapacity = MAX_NUMBER_JOBS;
+    jobs = malloc(sizeof(struct Job) * jobsCapacity);
+    jobsEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    shell_pid = getpid();
+    shellName = argv[0];
+    if(script)
+        shellName = script;
+    else if(command && argi < argc)
+        shellName = argv[argi++];
+    // the positional parameters point straight at argv
+    positionalParams = &argv[argi];
+    positionalCount = argc - argi;
+    importEnvironment();
+    terminalShell = isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp();
+    signal(SIGINT, sig_int);
+    signal(SIGTSTP, sig_tstp);
+    signal(SIGCHLD, proc_exit);
+    if(boardName && openJobBoard(boardName) == -1) return 2;
+
+    int status = noRc ? FINISHED_INPUT : loadRcFile();
+    if(status && servePath)
+    {
+        lastStatus = serveCommands(servePath, serveLimit);
+    } else if(status && command)
+    {
+        execTail = tailExecEnabled;
+        runText(command);
+    } else if(status && script)
+    {
+        char *text = readFile(script);
+        if(!text)
+        {
+            perror(script);
+            lastStatus = 127;
+        } else
+        {
+            execTail = tailExecEnabled;
+            runText(text);
+            free(text);
+        }
+    } else if(status)
+    {
+        mainLoop();
+    }
 
+    closeJobBoard();
+    clearQueue();
     free(jobs);
-    return EXIT_SUCCESS;
+    if(jobsEpollFd >= 0) close(jobsEpollFd);
+    return lastStatus;
 }
 
 
@@ -38,77 +243,350 @@ void mainLoop(void)
 {
     int status = 1;
     char *line;
-    char **args;
-    activeJobsSize = 0;
-    signal(SIGINT, sig_int);
-    signal(SIGTSTP, sig_tstp);
-    signal(SIGCHLD, proc_exit);
+    struct CommandList list;
+    struct Program program;
     //read input line
     //parse input
     //stay in loop until an exit is requested
     //while waiting for user input SIGINT is ignored so ctrl+c will not stop the shell
     do
     {
+        // report background jobs that finished since the last prompt
+        reapJobs(jobs, pactiveJobsSize);
+        startAllocLine();
         // ignore sigint and sigtstp while waiting for input
-        printf("# ");
+        startPromptHelper();
+        buildPrompt();
+        promptText = promptLine;
+        printf("%s", promptText);
         line = readLineIn();
         if(line == NULL)
         {
             printf("\n");
+            stopPromptHelper();
             killProcs(jobs, pactiveJobsSize);
             break;
         }
-        if(strcmp(line,"") == 0) continue;
-        char *lineCpy = strdup(line);
-        args = parseLine(line);
-        status = executeLine(args, lineCpy);
+        if(strcmp(line,"") == 0)
+        {
+            free(line);
+            continue;
+        }
+
+        // a command that isn't finished at the end of the line, like an if without its fi, carries on in the next
+        int result;
+        while((result = parseList(line, &list)) == PARSE_INCOMPLETE)
+        {
+            promptText = "> ";
+            printf("%s", promptText);
+            char *more = readLineIn();
+            if(more == NULL)
+            {
+                fprintf(stderr, "yash: syntax error: unexpected end of file\n");
+                break;
+            }
+            line = realloc(line, strlen(line) + strlen(more) + 1);
+            strcat(line, more);
+            free(more);
+        }
+        if(result != 1)
+        {
+            free(line);
+            continue;
+        }
+
+        compileProgram(&program, &list);
+        freeList(&list);
+        free(line);
+        long long started = monotonicMs();
+        status = runProgram(&program, 0, program.codeLength);
+        lastCommandMs = monotonicMs() - started;
+        freeProgram(&program);
         printf("\n");
     } while(status);
     return;
 }
 
+// applies a group's redirections to this process. when saved is not NULL the descriptors being replaced are kept in it
+// so restoreRedirections can put them back. returns the number of saved descriptors, or -1 if a file can't be opened
+int applyRedirections(char **redirs, struct SavedFd *saved)
+{
+    int savedCount = 0;
+
+    fflush(stdout);
+    for(int i=0; redirs && redirs[i]; i += 2)
+    {
+        int target = isOperator(redirs[i], OPERATOR_IN) ? STDIN_FILENO : STDOUT_FILENO;
+        int flags = target == STDIN_FILENO ? O_RDONLY : O_WRONLY | O_CREAT | O_TRUNC;
+        int fd = open(redirs[i + 1], flags, 0666);
+        if(fd == -1)
+        {
+            fprintf(stderr, "Cannot open file %s\n", redirs[i + 1]);
+            restoreRedirections(saved, savedCount);
+            return -1;
+        }
+        if(saved && savedCount < MAX_GROUP_REDIRS)
+        {
+            saved[savedCount].fd = target;
+            saved[savedCount].saved = fcntl(target, F_DUPFD_CLOEXEC, SAVED_FD_BASE);
+            savedCount++;
+        }
+        dup2(fd, target);
+        close(fd);
+    }
+    return savedCount;
+}
+
+// puts back the descriptors saved by applyRedirections, most recent first
+void restoreRedirections(struct SavedFd *saved, int savedCount)
+{
+    fflush(stdout);
+    for(int i=savedCount-1; i>=0; i--)
+    {
+        if(saved[i].saved >= 0)
+        {
+            dup2(saved[i].saved, saved[i].fd);
+            close(saved[i].saved);
+        } else
+        {
+            close(saved[i].fd);
+        }
+    }
+    return;
+}
+
+// called in a forked child that keeps running shell code. the child gets its own empty jobs table and epoll set so it
+// never waits on or reports the parent's jobs
+void enterSubshell(void)
+{
+    for(int i=0; i<activeJobsSize; i++)
+    {
+        for(int p=0; p<jobs[i].procCount; p++)
+        {
+            if(jobs[i].procs[p].pidfd >= 0) close(jobs[i].procs[p].pidfd);
+        }
+        free(jobs[i].procs);
+        free(jobs[i].line);
+    }
+    activeJobsSize = 0;
+    if(jobsEpollFd >= 0) close(jobsEpollFd);
+    jobsEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    clearTimers();
+    clearQueue();
+    if(jobBoard) munmap(jobBoard, sizeof(struct JobBoard));
+    jobBoard = NULL;
+    // a function run for a command keeps the pipe ends given to the command, but not the ends of the substituted
+    // processes, which would hold off their end of file
+    closeSubstitutionEnds(0);
+    substitutionCount = 0;
+    execInPlace = 0;
+    jobGroup = -1;
+    return;
+}
+
+// built in cd command. changes to the given directory, or to $HOME without one
+int yash_cd(char **args)
+{
+    char *dir = args[1] ? args[1] : getenv("HOME");
+
+    if(dir == NULL || chdir(dir) == -1)
+    {
+        perror("cd");
+        lastStatus = 1;
+    }
+    return FINISHED_INPUT;
+}
+
+// built in exit command. stops the shell with the given status, or with the status of the last command
+int yash_exit(char **args)
+{
+    if(args[1]) lastStatus = atoi(args[1]) & 0xff;
+    return 0;
+}
 
-int executeLine(char **args, char *line)
+// runs a single command or pipeline and sets lastStatus. args holds the expanded words of the command, line is the
+// text recorded in the jobs table
+int executeLine(char **args, char *line, int inBackground)
 {
     if(!*args) return FINISHED_INPUT;
     int returnVal;
-    int inBackground = containsAmp(args);   //check if args contains '&'
+    int capacity = pipeCapacity;
+    int adaptive = pipeAdaptive;
+    int prefixCount = 0;
+
+    // leading NAME=value words only apply to this command: they are put in its environment and taken out again
+    // afterwards. YASH_PIPESIZE=SIZE overrides the pipe capacity for this pipeline instead
+    while(args[prefixCount] && isAssignment(args[prefixCount]))
+        prefixCount++;
+    char **savedEnv = calloc(prefixCount * 2 + 1, sizeof(char*));
+    for(int i=0; i<prefixCount; i++)
+    {
+        if(strncmp(args[i], PIPESIZE_PREFIX, strlen(PIPESIZE_PREFIX)) == 0)
+        {
+            if(parsePipeSize(args[i] + strlen(PIPESIZE_PREFIX), &capacity, &adaptive) == -1)
+            {
+                fprintf(stderr, "yash: invalid pipe size %s\n", args[i] + strlen(PIPESIZE_PREFIX));
+                restoreEnvironment(savedEnv, i);
+                lastStatus = 1;
+                return FINISHED_INPUT;
+            }
+            continue;
+        }
+        char *equals = strchr(args[i], '=');
+        savedEnv[i * 2] = strndup(args[i], equals - args[i]);
+        savedEnv[i * 2 + 1] = getenv(savedEnv[i * 2]) ? strdup(getenv(savedEnv[i * 2])) : NULL;
+        setenv(savedEnv[i * 2], equals + 1, 1);
+    }
+    args += prefixCount;
+    if(!*args)
+    {
+        restoreEnvironment(savedEnv, prefixCount);
+        lastStatus = 0;
+        return FINISHED_INPUT;
+    }
+
+    // timeout [OPTION]... DURATION puts a time limit on the job started for the rest of the command
+    int timeoutMs = 0;
+    int killAfterMs = TIMEOUT_KILL_AFTER_MS;
+    int timeoutSignal = SIGTERM;
+    int preserveStatus = 0;
+    if(strcmp(args[0], TIMEOUT_PREFIX) == 0)
+    {
+        int used = parseTimeout(args, &timeoutMs, &killAfterMs, &timeoutSignal, &preserveStatus);
+        if(used == -1 || (used > 0 && !args[used]))
+        {
+            fprintf(stderr, "yash: timeout: usage: timeout [-k DURATION] [-s SIGNAL] [--preserve-status] DURATION "
+                            "COMMAND [ARG ...]\n");
+            restoreEnvironment(savedEnv, prefixCount);
+            lastStatus = TIMEOUT_FAILED_STATUS;
+            return FINISHED_INPUT;
+        }
+        // with an option only the timeout program knows, used is 0 and the command runs that program instead
+        args += used;
+        // the shell has to stay to enforce the limit
+        if(used > 0) execInPlace = 0;
+    }
+
     int inputPiped = pipeQty(args);         //get number of pipes in the command
 
-    if(!(
-            (strcmp(args[0], BUILT_IN_BG) == 0) ||
-            (strcmp(args[0], BUILT_IN_FG) == 0) ||
-            (strcmp(args[0], BUILT_IN_JOBS) == 0)))
+    // a pipeline is started as a job even when one of its stages is a built in, and so is a timed built in, which
+    // runs in a child that can be killed. a timed job in the foreground gets a process group of its own, so the
+    // signals of its time limit reach every process it started
+    if(inputPiped > 0 || !isBuiltIn(args[0]) || timeoutMs > 0)
+    {
+        addToJobs(&jobs, line, pactiveJobsSize, &jobsCapacity);
+        jobs[activeJobsSize-1].timeoutMs = timeoutMs;
+        jobs[activeJobsSize-1].killAfterMs = killAfterMs;
+        jobs[activeJobsSize-1].timeoutSignal = timeoutSignal;
+        jobs[activeJobsSize-1].preserveStatus = preserveStatus;
+        jobGroup = timeoutMs > 0 && !inBackground ? 0 : -1;
+        returnVal = startCommand(args, inBackground, inputPiped, capacity, adaptive);
+        if(jobGroup > 0) setTerminalGroup(getpgrp());
+        jobGroup = -1;
+    } else
     {
-        addToJobs(jobs, line, pactiveJobsSize);
+        // a built in reads the shell's variables, not its environment, so they hold the assignments as well
+        char **savedVars = setPrefixVars(args - prefixCount, prefixCount);
+        returnVal = runBuiltIn(args);
+        restoreVars(savedVars, prefixCount);
     }
+    restoreEnvironment(savedEnv, prefixCount);
+    return returnVal;
+}
+
+// runs the built in command args[0] in the current process and sets lastStatus
+int runBuiltIn(char **args)
+{
+    int returnVal = FINISHED_INPUT;
 
-    // check if command is a built in command
+    lastStatus = 0;
     if(strcmp(args[0], BUILT_IN_BG) == 0)
-    {
         yash_bg(jobs, activeJobsSize);
+    else if(strcmp(args[0], BUILT_IN_FG) == 0)
+        yash_fg(jobs, activeJobsSize, pactiveJobsSize);
+    else if(strcmp(args[0], BUILT_IN_JOBS) == 0)
+        returnVal = yash_jobs(jobs, activeJobsSize);
+    else if(strcmp(args[0], BUILT_IN_PIPESIZE) == 0)
+        returnVal = yash_pipesize(args);
+    else if(strcmp(args[0], BUILT_IN_CD) == 0)
+        returnVal = yash_cd(args);
+    else if(strcmp(args[0], BUILT_IN_EXIT) == 0)
+        returnVal = yash_exit(args);
+    else if(strcmp(args[0], BUILT_IN_EXPORT) == 0)
+        returnVal = yash_export(args);
+    else if(strcmp(args[0], BUILT_IN_UNSET) == 0)
+        returnVal = yash_unset(args);
+    else if(strcmp(args[0], BUILT_IN_WAIT) == 0)
+        returnVal = yash_wait(args);
+    else if(strcmp(args[0], BUILT_IN_ALLOCS) == 0)
+        returnVal = yash_allocs(args);
+    else if(strcmp(args[0], BUILT_IN_QUEUE) == 0)
+        returnVal = yash_queue(args);
+    else if(strcmp(args[0], BUILT_IN_READ) == 0)
+        returnVal = yash_read(args);
+    else if(strcmp(args[0], BUILT_IN_ENABLE) == 0)
+        returnVal = yash_enable(args);
+    else if(strcmp(args[0], BUILT_IN_FALSE) == 0)
+        lastStatus = 1;
+    else if(findLoadedBuiltin(args[0]))
+        returnVal = runLoadedBuiltin(findLoadedBuiltin(args[0]), args);
+    return returnVal;
+}
+
+// starts a command that is not a built in, or a pipeline of two commands. <(cmd) and >(cmd) words are replaced by
+// /dev/fd paths first and their processes are started along with the command
+int startCommand(char **args, int inBackground, int inputPiped, int capacity, int adaptive)
+{
+    if(prepareSubstitutions(args) == -1)
+    {
+        finishSubstitutions();
+        removeLastFromJobs(jobs, pactiveJobsSize);
+        lastStatus = 1;
         return FINISHED_INPUT;
     }
-    if(strcmp(args[0], BUILT_IN_FG) == 0)
+    int returnVal = startProcesses(args, inBackground, inputPiped, capacity, adaptive);
+    finishSubstitutions();
+    return returnVal;
+}
+
+// starts the processes of a command whose substitutions are prepared
+int startProcesses(char **args, int inBackground, int inputPiped, int capacity, int adaptive)
+{
+    int returnVal;
+    // only a lone foreground command can take the shell's place
+    int inPlace = execInPlace;
+
+    execInPlace = 0;
+    int fanOuts = fanOutQty(args);
+
+    if(fanOuts > 0)
     {
-        yash_fg(jobs, activeJobsSize, pactiveJobsSize);
-        return FINISHED_INPUT;
+        if(inBackground || inputPiped > 0)
+        {
+            printf("'|+' can't be combined with '|' or '&'");
+            removeLastFromJobs(jobs, pactiveJobsSize);
+            lastStatus = 1;
+            return FINISHED_INPUT;
+        }
+        return startFanOutOperation(args, fanOuts, capacity);
     }
-    if(strcmp(args[0], BUILT_IN_JOBS) == 0)
-        return yash_jobs(jobs, activeJobsSize);
 
     //make sure & and | are not both in the argument
-    if(!pipeBGExclusive(args))
+    if(inBackground && inputPiped > 0)
     {
         printf("Cannot background and pipeline commands "
                        "('&' and '|' must be used separately).");
+        removeLastFromJobs(jobs, pactiveJobsSize);
+        lastStatus = 1;
         return FINISHED_INPUT;
     }
 
     // if there are more than 1 or less than 0 pipes reject the input as it is not a valid command
     if (inputPiped > 1 || inputPiped < 0)
     {
-        printf("Only one '|' allowed per line");
+        printf("Only one '|' allowed per command");
+        removeLastFromJobs(jobs, pactiveJobsSize);
+        lastStatus = 1;
         return FINISHED_INPUT;
     }
 
@@ -116,10 +594,27 @@ int executeLine(char **args, char *line)
     if(inputPiped == 1)
     {
         struct PipedArgs pipedArgs = getTwoArgs(args);
-        returnVal = startPipedOperation(pipedArgs.args1, pipedArgs.args2);
+        int rewrite = pipelineRewrite ? rewritePipeline(&pipedArgs) : REWRITE_NONE;
+        // a built in run by the shell itself couldn't be stopped by a time limit
+        if(rewrite == REWRITE_PRODUCER && jobGroup >= 0) rewrite = REWRITE_NONE;
+
+        if(showRewrites && rewrite != REWRITE_NONE)
+            traceRewrite(&pipedArgs, rewrite);
+        if(rewrite == REWRITE_NONE)
+            returnVal = startPipedOperation(pipedArgs.args1, pipedArgs.args2, capacity, adaptive);
+        else if(rewrite == REWRITE_PRODUCER)
+            returnVal = startProducerPipe(pipedArgs.args1, pipedArgs.args2, capacity);
+        else
+        {
+            // the pipeline became a single command in args1
+            execInPlace = inPlace;
+            returnVal = startOperation(pipedArgs.args1);
+            // a dropped cat would have ended the pipeline with its own status, which is 0 unless it was signalled
+            if(rewrite == REWRITE_TRAILING_CAT && lastStatus < 128 && lastStatus != TIMED_OUT_STATUS)
+                lastStatus = 0;
+        }
         free(pipedArgs.args1);
         free(pipedArgs.args2);
-        free(args);
         return returnVal;
     }
 
@@ -128,15 +623,87 @@ int executeLine(char **args, char *line)
         returnVal = startBgOperation(args);
     } else
     {
+        execInPlace = inPlace;
         returnVal = startOperation(args);
     }
-    free(args);
     return returnVal;
 }
 
+// puts back the environment variables changed for a single command. saved holds count name and old value pairs,
+// a NULL name for a pair that wasn't changed and a NULL value for a variable that wasn't set. frees saved
+void restoreEnvironment(char **saved, int count)
+{
+    for(int i=0; i<count; i++)
+    {
+        char *name = saved[i * 2];
+        if(!name) continue;
+        struct Var *var = findVar(name, strlen(name));
+        if(var && var->exported)
+            setenv(name, var->value, 1);
+        else if(saved[i * 2 + 1])
+            setenv(name, saved[i * 2 + 1], 1);
+        else
+            unsetenv(name);
+        free(name);
+        free(saved[i * 2 + 1]);
+    }
+    free(saved);
+    return;
+}
+
+// sets the count NAME=value words in args as shell variables for a built in. returns their old values for
+// restoreVars, in the layout restoreEnvironment takes
+char **setPrefixVars(char **args, int count)
+{
+    char **saved = calloc(count * 2 + 1, sizeof(char*));
+
+    if(!saved)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    for(int i=0; i<count; i++)
+    {
+        if(strncmp(args[i], PIPESIZE_PREFIX, strlen(PIPESIZE_PREFIX)) == 0) continue;
+        char *equals = strchr(args[i], '=');
+        char *old = getVar(args[i], equals - args[i]);
+        saved[i * 2] = strndup(args[i], equals - args[i]);
+        saved[i * 2 + 1] = old ? strdup(old) : NULL;
+        setVar(saved[i * 2], equals + 1);
+    }
+    return saved;
+}
+
+// puts back the shell variables set for a single command by setPrefixVars. frees saved
+void restoreVars(char **saved, int count)
+{
+    for(int i=0; i<count; i++)
+    {
+        char *name = saved[i * 2];
+        if(!name) continue;
+        if(saved[i * 2 + 1])
+            setVar(name, saved[i * 2 + 1]);
+        else
+            unsetVar(name);
+        free(name);
+        free(saved[i * 2 + 1]);
+    }
+    free(saved);
+    return;
+}
+
+// returns 1 for the commands run by the shell itself, which never go in the jobs table. this includes the ones loaded
+// with enable -f
+int isBuiltIn(char *name)
+{
+    static char *builtIns[] = {BUILT_IN_BG, BUILT_IN_FG, BUILT_IN_JOBS, BUILT_IN_PIPESIZE, BUILT_IN_CD, BUILT_IN_EXIT,
+                               BUILT_IN_EXPORT, BUILT_IN_UNSET, BUILT_IN_TRUE, BUILT_IN_FALSE, BUILT_IN_COLON,
+                               BUILT_IN_WAIT, BUILT_IN_ALLOCS, BUILT_IN_QUEUE, BUILT_IN_READ, BUILT_IN_ENABLE, NULL};
+    return isWordIn(name, builtIns) || findLoadedBuiltin(name) != NULL;
+}
+
 int startBgOperation(char **args)
 {
-    removeAmp(args);
     FILE *writeFilePointer = NULL;
     FILE *readFilePointer = NULL;
     int argCount = countArgs(args);
@@ -147,6 +714,8 @@ int startBgOperation(char **args)
     pid_ch1 = fork();
     if (pid_ch1 == 0)
     {
+        // own process group so signals meant for the foreground job do not reach it
+        setpgid(0, 0);
         if (redirOut >= 0)
         {
             if(setRedirOut(args, redirOut, writeFilePointer, argCount) == -1)
@@ -169,7 +738,7 @@ int startBgOperation(char **args)
 
         if((redirIn < 0 && redirOut <0) || (redirIn >= 0 && redirOut <0))
             dup2(fd, STDOUT_FILENO);
-        if(execvp(args[0], args) == -1)
+        if(execCommand(args) == -1)
         {
             perror("Problem executing command");
             removeLastFromJobs(jobs, pactiveJobsSize);
@@ -181,8 +750,15 @@ int startBgOperation(char **args)
         perror("error forking");
     } else if (pid_ch1 > 0)
     {
+        setpgid(pid_ch1, pid_ch1);
         startJobsPID(jobs, pid_ch1, activeJobsSize);
+        launchSubstitutions(pid_ch1);
+        lastBackgroundPid = pid_ch1;
+        lastStatus = 0;
+        // ctrl+c and ctrl+z are for the foreground, never for a background job
+        pid_ch1 = -1;
     }
+    close(fd);
     if(writeFilePointer != NULL) fclose(writeFilePointer);
     if(readFilePointer != NULL) fclose(readFilePointer);
     return FINISHED_INPUT;
@@ -190,18 +766,26 @@ int startBgOperation(char **args)
 
 int startOperation(char **args)
 {
-    int status;
-    removeAmp(args);
     FILE *writeFilePointer = NULL;
     FILE *readFilePointer = NULL;
     int argCount = countArgs(args);
     int redirIn = containsInRedir(args);
     int redirOut = containsOutRedir(args);
+    // the last command of a process about to exit runs in the process itself, as the child would have. substituted
+    // processes still need the shell to start them
+    int inPlace = execInPlace && substitutionCount == 0;
 
-    pid_ch1 = fork();
+    execInPlace = 0;
+    if(inPlace)
+    {
+        fflush(stdout);
+        closeJobBoard();
+    }
+    pid_ch1 = inPlace ? 0 : fork();
     if(pid_ch1 == 0)
     {
         // child process
+        if(!inPlace) enterJobGroup(0);
 
         if (redirOut >= 0)
         {
@@ -222,7 +806,9 @@ int startOperation(char **args)
             }
         }
 
-        if(execvp(args[0], args) == -1)
+        // a command of redirections alone only had its files to open, which is done
+        if(!args[0]) _exit(EXIT_SUCCESS);
+        if(execCommand(args) == -1)
         {
             perror("Problem executing command");
             removeLastFromJobs(jobs, pactiveJobsSize);
@@ -234,17 +820,10 @@ int startOperation(char **args)
     } else
     {
         // Parent process
+        enterJobGroup(pid_ch1);
         startJobsPID(jobs, pid_ch1, activeJobsSize);
-        // change sig catchers back to not ignore signals
-        pid = waitpid(-1, &status, WUNTRACED | WCONTINUED);
-        if (pid == -1) {
-            perror("waitpid");
-        }
-        if (WIFEXITED(status) | WIFSIGNALED(status)) {
-            removeFromJobs(jobs, pid_ch1, pactiveJobsSize);
-        } else if (WIFSTOPPED(status)) {
-            setJobStatus(jobs, pid_ch1, activeJobsSize, STOPPED);
-        }
+        launchSubstitutions(jobGroup > 0 ? jobGroup : 0);
+        waitForJob(jobs, pid_ch1, pactiveJobsSize);
     }
     if(writeFilePointer != NULL) fclose(writeFilePointer);
     if(readFilePointer != NULL) fclose(readFilePointer);
@@ -252,9 +831,8 @@ int startOperation(char **args)
 }
 
 
-int startPipedOperation(char **args1, char **args2)
+int startPipedOperation(char **args1, char **args2, int capacity, int adaptive)
 {
-    int status;
     int pfd[2];
     FILE *writeFilePointer = NULL;
     FILE *readFilePointer = NULL;
@@ -270,51 +848,31 @@ int startPipedOperation(char **args1, char **args2)
         perror("pipe");
         return FINISHED_INPUT;
     }
+    if (capacity > 0)
+        setPipeCapacity(pfd[0], capacity);
 
     pid_ch1 = fork();
     if(pid_ch1 > 0)
     {
         //parent
+        enterJobGroup(pid_ch1);
         pid_ch2 = fork();
         if(pid_ch2 > 0)
         {
-            close(pfd[0]);
+            enterJobGroup(pid_ch2);
             close(pfd[1]);
-            int count = 0;
-            while(count<2)
-            {
-                pid = waitpid(-1, &status, WUNTRACED | WCONTINUED);
-                startJobsPID(jobs, pid_ch1, activeJobsSize);
-                if(pid == -1)
-                {
-                    perror("waitpid");
-                    return FINISHED_INPUT;
-                }
-                if(WIFEXITED(status))
-                {
-                    removeFromJobs(jobs, pid_ch1, pactiveJobsSize);
-                    count++;
-                } else if(WIFSIGNALED(status))
-                {
-                    removeFromJobs(jobs, pid_ch1, pactiveJobsSize);
-                    count++;
-                } else if(WIFSTOPPED(status))
-                {
-                    setJobStatus(jobs, pid_ch1, activeJobsSize, STOPPED);
-                    count++;
-                    count++;
-                } else if(WIFCONTINUED(status))
-                {
-                    setJobStatus(jobs, pid_ch1, activeJobsSize, RUNNING);
-                    pid = waitpid(-1, &status, WUNTRACED | WCONTINUED);
-                }
-            }
+            startJobsPID(jobs, pid_ch1, activeJobsSize);
+            startJobsPID(jobs, pid_ch2, activeJobsSize);
+            launchSubstitutions(jobGroup > 0 ? jobGroup : 0);
+            if(adaptive)
+                monitorPipe(pfd[0], &jobs[activeJobsSize-1]);
+            close(pfd[0]);
+            waitForJob(jobs, pid_ch1, pactiveJobsSize);
             return FINISHED_INPUT;
         } else
         {
             // child 2
-            sleep(1);
-            setpgid(0, pid_ch1);
+            enterJobGroup(0);
             close(pfd[1]);
             dup2(pfd[0],STDIN_FILENO);
 
@@ -338,7 +896,7 @@ int startPipedOperation(char **args1, char **args2)
                 }
             }
 
-            if(execvp(args2[0], args2) == -1)
+            if(execCommand(args2) == -1)
             {
                 perror("Problem executing command 2");
                 removeLastFromJobs(jobs, pactiveJobsSize);
@@ -348,8 +906,11 @@ int startPipedOperation(char **args1, char **args2)
         }
     } else
     {
-        // child 1
-        setsid();
+        // child 1. a timed job keeps it in the job's group, otherwise it gets a session of its own
+        if(jobGroup >= 0)
+            enterJobGroup(0);
+        else
+            setsid();
         close(pfd[0]);
         dup2(pfd[1], STDOUT_FILENO);
         if (redirOut1 >= 0)
@@ -372,7 +933,7 @@ int startPipedOperation(char **args1, char **args2)
             }
         }
 
-        if(execvp(args1[0], args1) == -1)
+        if(execCommand(args1) == -1)
         {
             perror("Problem executing command 1");
             removeLastFromJobs(jobs, pactiveJobsSize);
@@ -385,9 +946,145 @@ int startPipedOperation(char **args1, char **args2)
     return FINISHED_INPUT;
 }
 
+// looks for a way to run the pipeline args1 | args2 with fewer processes. 'cat FILE | cmd' becomes 'cmd < FILE' and
+// 'cmd | cat' becomes 'cmd' when stdout isn't a terminal, both left in args1, and a built in that doesn't change the
+// shell feeds the pipe from the shell itself. returns one of the REWRITE_ values
+int rewritePipeline(struct PipedArgs *piped)
+{
+    char **first = piped->args1;
+    char **second = piped->args2;
+    struct stat st;
+
+    // a stage starting with a redirection may have no command word at all
+    if(!first[0] || !second[0] || isOperatorWord(first[0]) || isOperatorWord(second[0])) return REWRITE_NONE;
+    // only a readable regular file is sure to give cmd exactly what cat would have, without cat's error messages
+    if(isPlainCat(first, 1) && !isBuiltIn(second[0]) && containsInRedir(second) < 0 && stat(first[1], &st) == 0 &&
+       S_ISREG(st.st_mode) && access(first[1], R_OK) == 0)
+    {
+        char *path = first[1];
+        int count = countArgs(second);
+        memcpy(first, second, sizeof(char*) * count);
+        first[count] = operatorWords[OPERATOR_IN];
+        first[count + 1] = path;
+        first[count + 2] = NULL;
+        return REWRITE_CAT_INPUT;
+    }
+    // on a terminal cmd would notice its output isn't going through a pipe any more
+    if(isPlainCat(second, 0) && !isBuiltIn(first[0]) && !isatty(STDOUT_FILENO))
+        return REWRITE_TRAILING_CAT;
+    if(isBuiltIn(first[0]) && !isStateBuiltIn(first[0]) && !isBuiltIn(second[0]) && containsInRedir(first) < 0 &&
+       containsOutRedir(first) < 0)
+        return REWRITE_PRODUCER;
+    return REWRITE_NONE;
+}
+
+// returns 1 if args runs the cat program with exactly operands file operands and nothing else
+int isPlainCat(char **args, int operands)
+{
+    if(strcmp(args[0], "cat") != 0 || findFunction(args[0])) return 0;
+    for(int i=1; i<=operands; i++)
+    {
+        if(!args[i] || args[i][0] == '-' || isOperator(args[i], OPERATOR_IN) || isOperator(args[i], OPERATOR_OUT))
+            return 0;
+    }
+    return args[operands + 1] == NULL;
+}
+
+// prints what a pipeline was rewritten into on stderr, marked with + like the commands shown by set -x. a built in
+// run by the shell itself is shown as a { } group
+void traceRewrite(struct PipedArgs *piped, int rewrite)
+{
+    char *first = joinArgs(piped->args1, 0);
+
+    if(rewrite == REWRITE_PRODUCER)
+    {
+        char *second = joinArgs(piped->args2, 0);
+        fprintf(stderr, "+ { %s; } | %s\n", first, second);
+        free(second);
+    } else
+        fprintf(stderr, "+ %s\n", first);
+    free(first);
+    return;
+}
+
+// runs the pipeline builtin | cmd with the built in writing into the pipe from the shell process, so only cmd is
+// forked. cmd is started first so that output larger than the pipe can't block the shell
+int startProducerPipe(char **args1, char **args2, int capacity)
+{
+    int pfd[2];
+    FILE *writeFilePointer = NULL;
+    FILE *readFilePointer = NULL;
+    int argCount2 = countArgs(args2);
+    int redirIn2 = containsInRedir(args2);
+    int redirOut2 = containsOutRedir(args2);
+
+    if(pipe2(pfd, O_CLOEXEC) == -1)
+    {
+        perror("pipe");
+        removeLastFromJobs(jobs, pactiveJobsSize);
+        return FINISHED_INPUT;
+    }
+    if(capacity > 0)
+        setPipeCapacity(pfd[0], capacity);
+
+    fflush(stdout);
+    pid_ch1 = fork();
+    if(pid_ch1 == 0)
+    {
+        // a function run for cmd doesn't exec, so the write end has to go before it reads to end of file
+        close(pfd[1]);
+        dup2(pfd[0], STDIN_FILENO);
+        if(redirOut2 >= 0 && setRedirOut(args2, redirOut2, writeFilePointer, argCount2) == -1)
+            _exit(EXIT_FAILURE);
+        if(redirIn2 >= 0 && setRedirIn(args2, redirIn2, readFilePointer, argCount2) == -1)
+            _exit(EXIT_FAILURE);
+        if(execCommand(args2) == -1)
+        {
+            perror("Problem executing command 2");
+            _Exit(EXIT_FAILURE);
+        }
+    } else if(pid_ch1 < 0)
+    {
+        perror("error forking");
+        close(pfd[0]);
+        close(pfd[1]);
+        removeLastFromJobs(jobs, pactiveJobsSize);
+        return FINISHED_INPUT;
+    }
+
+    close(pfd[0]);
+    startJobsPID(jobs, pid_ch1, activeJobsSize);
+    launchSubstitutions(0);
+
+    // the built in's stdout is the pipe until it returns. a consumer that quits early must not take the shell down
+    // with SIGPIPE, and the pipeline's own job is hidden from the built in so jobs doesn't list it
+    struct sigaction ignore = {0};
+    struct sigaction previous;
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &previous);
+    int savedOut = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+    dup2(pfd[1], STDOUT_FILENO);
+    close(pfd[1]);
+    int own = findJob(jobs, pid_ch1, activeJobsSize);
+    jobs[own].hidden = 1;
+    runBuiltIn(args1);
+    // the built in may have added jobs and moved the table
+    own = findJob(jobs, pid_ch1, activeJobsSize);
+    if(own >= 0) jobs[own].hidden = 0;
+    fflush(stdout);
+    clearerr(stdout);
+    dup2(savedOut, STDOUT_FILENO);
+    close(savedOut);
+    sigaction(SIGPIPE, &previous, NULL);
+
+    waitForJob(jobs, pid_ch1, pactiveJobsSize);
+    return FINISHED_INPUT;
+}
+
 
 static void sig_int(int signo)
 {
+    interrupts++;
     if(pid_ch1 == -1)
         return;
     signal(SIGINT, sig_int);
@@ -404,33 +1101,269 @@ static void sig_tstp(int signo)
     kill(pid_ch1, SIGTSTP);
 }
 
+// only records that a child changed state. printf and the jobs table are not safe to touch from signal context, so
+// the children are reaped by reapJobs from the main loop
 static void proc_exit(int signo)
 {
-    int	sig_chld_pid;
+    childExited = 1;
+    childSignals++;
+    return;
+}
+
+// reaps the processes whose pidfds became readable since the last call and reports finished background jobs.
+// only processes that have actually exited are waited on, so the cost follows the number of exits rather than the
+// number of jobs, and each job is reported and removed exactly once
+void reapJobs(struct Job *jobs, int *activeJobsSize)
+{
+    struct epoll_event events[MAX_REAP_EVENTS];
     int status;
-    while((sig_chld_pid = waitpid(-1, &status, WNOHANG))>0) {
-        for (int i = 0; i < activeJobsSize; i++) {
-            if (jobs[i].pid_no == sig_chld_pid)
-                printf("\n[%d] DONE    %s\n", jobs[i].task_no, jobs[i].line);
+    int ready;
+
+    if(!childExited) return;
+    childExited = 0;
+    do
+    {
+        ready = epoll_wait(jobsEpollFd, events, MAX_REAP_EVENTS, 0);
+        for(int e=0; e<ready; e++)
+        {
+            if(events[e].data.u64 == TIMER_EPOLL_KEY)
+                runTimers();
+            else
+                reapProcess(jobs, (int) events[e].data.u64, activeJobsSize);
+        }
+    } while(ready == MAX_REAP_EVENTS);
+
+    // jobs whose processes were reaped by the wait built in are reported here, and processes without a pidfd are
+    // polled one at a time
+    for(int i=0; i<*activeJobsSize; i++)
+    {
+        if(reportIfFinished(jobs, i, activeJobsSize))
+        {
+            i--;
+            continue;
+        }
+        for(int p=0; p<jobs[i].procCount; p++)
+        {
+            struct Process *proc = &jobs[i].procs[p];
+            if(proc->done || proc->pidfd >= 0) continue;
+            if(waitProcess(proc, WNOHANG, &status) > 0 && !WIFSTOPPED(status))
+            {
+                finishProcess(proc, status);
+                publishJobs();
+                if(reportIfFinished(jobs, i, activeJobsSize)) i--;
+                break;
+            }
         }
-        printf("# ");
-        fflush(stdout);
-        removeFromJobs(jobs, sig_chld_pid, pactiveJobsSize);
     }
+    // finished jobs make room for queued ones
+    admitQueued();
+    fflush(stdout);
     return;
 }
 
-void fg_handler(int signo)
+// marks the process pid as finished. once every process of its job has finished the job is reported and removed.
+// returns 1 if the job was removed from the table
+int reapProcess(struct Job *jobs, int pid, int *activeJobsSize)
 {
-    pid_t	sig_chld_pid;
+    int i = collectProcess(jobs, pid, *activeJobsSize);
 
-    sig_chld_pid = wait(NULL);
-    removeFromJobs(jobs, sig_chld_pid, pactiveJobsSize);
+    return i >= 0 ? reportIfFinished(jobs, i, activeJobsSize) : 0;
 }
 
-static void sig_handler(int signo) {
-    switch(signo){
-        case SIGINT:
+// marks the process pid as finished if it has exited, without reporting its job. returns the index of its job, or
+// -1 when the process is unknown or still running
+int collectProcess(struct Job *jobs, int pid, int activeJobsSize)
+{
+    int status;
+
+    for(int i=0; i<activeJobsSize; i++)
+    {
+        for(int p=0; p<jobs[i].procCount; p++)
+        {
+            struct Process *proc = &jobs[i].procs[p];
+            if(proc->pid != pid || proc->done) continue;
+            if(waitProcess(proc, WNOHANG, &status) <= 0 || WIFSTOPPED(status)) return -1;
+            finishProcess(proc, status);
+            publishJobs();
+            return i;
+        }
+    }
+    return -1;
+}
+
+// reports and removes the job at index i once every one of its processes has finished. returns 1 if it was removed
+int reportIfFinished(struct Job *jobs, int i, int *activeJobsSize)
+{
+    if(!jobFinished(&jobs[i])) return 0;
+    printf("[%d] DONE    %s\n", jobs[i].task_no, jobs[i].line);
+    rememberFinishedJob(&jobs[i]);
+    removeFromJobs(jobs, jobs[i].pid_no, activeJobsSize);
+    return 1;
+}
+
+// returns 1 once a started job has no process left running
+int jobFinished(struct Job *job)
+{
+    if(job->procCount == 0) return 0;
+    for(int p=0; p<job->procCount; p++)
+    {
+        if(!job->procs[p].done) return 0;
+    }
+    return 1;
+}
+
+// the exit status of a finished job is the status of its last command, leaving out substituted processes, or 124
+// when its time limit ran out
+int jobExitCode(struct Job *job)
+{
+    int last = job->procCount - 1;
+
+    // like the timeout program, a job killed by a limit that sends SIGKILL keeps the status of the kill
+    if(job->timedOut && !job->preserveStatus && job->timeoutSignal != SIGKILL) return TIMED_OUT_STATUS;
+    while(last > 0 && job->procs[last].auxiliary)
+        last--;
+    return statusToExitCode(job->procs[last].status);
+}
+
+// keeps the status of a job that is about to leave the table so a later wait can still return it. the oldest entry
+// is dropped when the list is full
+void rememberFinishedJob(struct Job *job)
+{
+    if(finishedJobCount == FINISHED_JOBS_LIMIT)
+    {
+        memmove(finishedJobs, finishedJobs + 1, sizeof(struct FinishedJob) * (FINISHED_JOBS_LIMIT - 1));
+        finishedJobCount--;
+    }
+    finishedJobs[finishedJobCount].task_no = job->task_no;
+    finishedJobs[finishedJobCount].pid_no = job->pid_no;
+    finishedJobs[finishedJobCount].status = jobExitCode(job);
+    finishedJobCount++;
+    return;
+}
+
+// waits for a single process to exit, or to stop when WNOHANG is not given or WUNTRACED is. the process's pidfd is
+// used when it has one so that only this process can be reaped. returns the pid on a state change, 0 if nothing
+// changed and -1 on error. status is filled in the waitpid format
+int waitProcess(struct Process *proc, int options, int *status)
+{
+    int result;
+
+    if(proc->pidfd < 0)
+    {
+        do
+            result = waitpid(proc->pid, status, options | WUNTRACED);
+        while(result == -1 && errno == EINTR);
+        return result;
+    }
+
+    siginfo_t info;
+    info.si_pid = 0;
+    int waitOptions = WEXITED | (options & WNOHANG) | ((options & WUNTRACED) || !(options & WNOHANG) ? WSTOPPED : 0);
+    do
+        result = waitid(YASH_P_PIDFD, proc->pidfd, &info, waitOptions);
+    while(result == -1 && errno == EINTR);
+    if(result == -1) return -1;
+    if(info.si_pid == 0) return 0;
+
+    switch(info.si_code)
+    {
+        case CLD_EXITED:
+            *status = (info.si_status & 0xff) << 8;
+            break;
+        case CLD_KILLED:
+            *status = info.si_status & 0x7f;
+            break;
+        case CLD_DUMPED:
+            *status = (info.si_status & 0x7f) | 0x80;
+            break;
+        case CLD_STOPPED:
+            *status = ((info.si_status & 0xff) << 8) | 0x7f;
+            break;
+        default:
+            *status = 0xffff;
+    }
+    return info.si_pid;
+}
+
+// records that a process has exited and releases its pidfd
+void finishProcess(struct Process *proc, int status)
+{
+    proc->done = 1;
+    proc->status = status;
+    if(proc->pidfd >= 0)
+    {
+        epoll_ctl(jobsEpollFd, EPOLL_CTL_DEL, proc->pidfd, NULL);
+        close(proc->pidfd);
+        proc->pidfd = -1;
+    }
+    return;
+}
+
+// waits in the foreground for every process of the job started as pid. the job is removed from the table when all of
+// its processes have exited and marked as stopped when one of them stops. other jobs are never reaped here. either
+// way there is no foreground job afterwards, so ctrl+c and ctrl+z go nowhere
+void waitForJob(struct Job *jobs, int pid, int *activeJobsSize)
+{
+    int status;
+    int i = findJob(jobs, pid, *activeJobsSize);
+
+    if(i < 0)
+    {
+        pid_ch1 = -1;
+        return;
+    }
+    for(int p=0; p<jobs[i].procCount; p++)
+    {
+        struct Process *proc = &jobs[i].procs[p];
+        if(proc->done) continue;
+        if(waitJobProcess(proc, &status) == -1)
+        {
+            perror("waitpid");
+            pid_ch1 = -1;
+            return;
+        }
+        if(WIFSTOPPED(status))
+        {
+            jobs[i].runningStatus = STOPPED;
+            lastStatus = 128 + WSTOPSIG(status);
+            publishJobs();
+            pid_ch1 = -1;
+            return;
+        }
+        finishProcess(proc, status);
+    }
+    lastStatus = jobExitCode(&jobs[i]);
+    removeFromJobs(jobs, pid, activeJobsSize);
+    pid_ch1 = -1;
+    return;
+}
+
+// converts a waitpid status into a shell exit status, 128 plus the signal number for a killed process
+int statusToExitCode(int status)
+{
+    if(WIFEXITED(status)) return WEXITSTATUS(status);
+    if(WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return 0;
+}
+
+// returns the index of the job started as pid, or -1 if it is not in the table
+int findJob(struct Job *jobs, int pid, int activeJobsSize)
+{
+    for(int i=0; i<activeJobsSize; i++)
+    {
+        if(jobs[i].pid_no == pid) return i;
+    }
+    return -1;
+}
+
+void fg_handler(int signo)
+{
+    childExited = 1;
+}
+
+static void sig_handler(int signo) {
+    switch(signo){
+        case SIGINT:
             signal(signo,SIG_IGN);
             signal(SIGINT,sig_handler);
             break;
@@ -455,29 +1388,11 @@ int pipeQty(char **args)
     int numArgs = countArgs(args);
     for (int i=0; i<numArgs;i++)
     {
-        if(strstr(args[i],"|") && strlen(args[i]) == 1) pipeCount++;
+        if(isOperator(args[i], OPERATOR_PIPE)) pipeCount++;
     }
     return pipeCount;
 }
 
-//returns 0 if pipe and & are not exclusive
-int pipeBGExclusive(char **args)
-{
-    int pipeCount = 0;
-    int backgroundCount = 0;
-    int numArgs = countArgs(args);
-    for (int i=0; i<numArgs; i++)
-    {
-        if(strstr(args[i],"|")) pipeCount++;
-        if(strstr(args[i],"&")) backgroundCount++;
-    }
-    if((pipeCount>0) && (backgroundCount>0))
-    {
-        return 0;
-    }
-    return 1;
-}
-
 //determine how many arguments were given to input
 int countArgs(char **args)
 {
@@ -492,399 +1407,7482 @@ int countArgs(char **args)
     return numArgs;
 }
 
-//read input until end of file or new line
+//read input until end of file or new line. input from a terminal goes through the line editor
 char *readLineIn(void)
 {
-    char *line = calloc(MAX_INPUT_LENGTH + 1, sizeof(char));
+    if(isatty(STDIN_FILENO) && isatty(STDOUT_FILENO)) return editLine();
 
-    if(!line)
+    // getline grows the buffer to fit, so generated lines of any length come in whole
+    char *line = NULL;
+    size_t capacity = 0;
+
+    if(getline(&line, &capacity, stdin) == -1) {
+        free(line);
+        return NULL;
+    }
+    if(strcmp(line,"\n") == 0) line[0] = '\0';
+    return line;
+}
+
+// splits a line into words and operators. the operator characters ; & | < > ( ) end a word even without spaces around
+// them and && || ;; and |+ are kept together as one token. a newline is a token of its own since it ends a command like
+// ';' does. a word starting with # begins a comment that runs to the end of the line. quotes, backslashes and ${ } or
+// $( ) keep their contents in one word and are left in the word for expansion to remove. the token array and the text
+// of the tokens are allocated as one block, so freeing the returned array frees everything. incomplete is set when the
+// line ends inside quotes or right after | && or ||
+#define TOKEN_DELIMS " \t\r\a"
+#define TOKEN_OPERATORS ";&|<>()\n"
+char **parseLine(char *line, int *incomplete)
+{
+    int tokenCount = 0;
+    size_t textSize = 0;
+    char *start;
+    size_t length;
+    char *next = line;
+
+    // first pass sizes the block, second pass fills it
+    *incomplete = 0;
+    while((next = nextToken(next, &start, &length, incomplete)) != NULL)
     {
-        fprintf(stderr,"line in memory allocation error\n");
+        tokenCount++;
+        textSize += length + 1;
+    }
+
+    char **tokens = malloc(sizeof(char*) * (tokenCount + 1) + textSize);
+    if (!tokens) {
+        fprintf(stderr, "yash: allocation error\n");
         exit(EXIT_FAILURE);
     }
 
-    line = fgets(line,MAX_INPUT_LENGTH+1,stdin);
-    if(line == NULL) {
-        return NULL;
+    char *text = (char *) (tokens + tokenCount + 1);
+    int position = 0;
+    next = line;
+    while((next = nextToken(next, &start, &length, incomplete)) != NULL)
+    {
+        memcpy(text, start, length);
+        text[length] = '\0';
+        tokens[position++] = text;
+        text += length + 1;
+    }
+    tokens[position] = NULL;
+    return tokens;
+}
+
+// finds the token that starts at or after p. sets its start and length and returns where scanning continues,
+// or returns NULL when there are no tokens left
+char *nextToken(char *p, char **start, size_t *length, int *incomplete)
+{
+    p += strspn(p, TOKEN_DELIMS);
+    // a # starting a word comments out the rest of the line, the newline ending it is still a token
+    if(*p == '#') p += strcspn(p, "\n");
+    if(*p == '\0') return NULL;
+    *start = p;
+    if((*p == '<' || *p == '>') && p[1] == '(')
+    {
+        // <(cmd) and >(cmd) are a single word running to the matching bracket
+        char *close = skipBracketed(p + 1);
+        if(!close)
+        {
+            *incomplete = 1;
+            close = p + strlen(p) - 1;
+        }
+        *length = close + 1 - p;
+        return close + 1;
+    }
+    if(strchr(TOKEN_OPERATORS, *p))
+    {
+        // && || ;; and the |+ fan-out are the only two character operators
+        *length = (((*p == '&' || *p == '|' || *p == ';') && p[1] == *p) || (*p == '|' && p[1] == '+')) ? 2 : 1;
+        if(*p == '|' || (*p == '&' && *length == 2))
+        {
+            // a command may continue on the next line after | |+ && or ||, so newlines after them are skipped
+            char *after = p + *length + strspn(p + *length, TOKEN_DELIMS "\n");
+            if(*after == '\0') *incomplete = 1;
+            return after;
+        }
+        return p + *length;
+    }
+
+    // plain characters are skipped a block at a time, the rest one word part at a time
+    char *end = p + plainRun(p);
+    while(*end && !strchr(TOKEN_DELIMS TOKEN_OPERATORS, *end))
+    {
+        end = skipWordPart(end, incomplete);
+        end += plainRun(end);
+    }
+    *length = end - p;
+    return end;
+}
+
+// the bytes that end a run of plain word characters: the end of the string, delimiters, operators and the starts of
+// quotes, escapes and expansions
+static const unsigned char wordSpecial[256] = {[0] = 1, [' '] = 1, ['\t'] = 1, ['\r'] = 1, ['\a'] = 1, [';'] = 1,
+                                               ['&'] = 1, ['|'] = 1, ['<'] = 1, ['>'] = 1, ['('] = 1, [')'] = 1,
+                                               ['\n'] = 1, ['\\'] = 1, ['\''] = 1, ['"'] = 1, ['$'] = 1};
+
+// returns how many bytes at p are plain word characters, with the widest vector instructions the processor has
+size_t plainRun(char *p)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if(detectSimd() == SIMD_AVX2) return plainRunAvx2(p);
+    if(simdLevel == SIMD_SSE2) return plainRunSse2(p);
+#endif
+    return plainRunScalar(p);
+}
+
+size_t plainRunScalar(char *p)
+{
+    char *end = p;
+
+    while(!wordSpecial[(unsigned char) *end])
+        end++;
+    return end - p;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// the vector versions flag every byte up to ')' along with ; < > \ and |, which covers every special byte and a few
+// plain ones, and leave the flagged bytes to the caller. loads are aligned so they never cross into a page past the
+// end of the string, which ends in a flagged byte
+__attribute__((target("sse2"), no_sanitize_address))
+size_t plainRunSse2(char *p)
+{
+    size_t offset = (uintptr_t) p & 15;
+    char *block = p - offset;
+    __m128i limit = _mm_set1_epi8(')');
+    unsigned int mask;
+
+    for(;; block += 16)
+    {
+        __m128i bytes = _mm_load_si128((__m128i *) block);
+        __m128i flagged = _mm_cmpeq_epi8(_mm_min_epu8(bytes, limit), bytes);
+        flagged = _mm_or_si128(flagged, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(';')));
+        flagged = _mm_or_si128(flagged, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('<')));
+        flagged = _mm_or_si128(flagged, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('>')));
+        flagged = _mm_or_si128(flagged, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\')));
+        flagged = _mm_or_si128(flagged, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('|')));
+        mask = (unsigned int) _mm_movemask_epi8(flagged);
+        // bytes before p in the first block don't count
+        if(block < p) mask &= ~0U << offset;
+        // a flagged byte that is plain after all doesn't end the run
+        for(; mask; mask &= mask - 1)
+        {
+            char *at = block + __builtin_ctz(mask);
+            if(wordSpecial[(unsigned char) *at]) return at - p;
+        }
     }
-    if(strcmp(line,"\n") == 0) return "";
-    char *lineCopy = strdup(line);
+}
 
-    free(line);
-    return lineCopy;
+__attribute__((target("avx2"), no_sanitize_address))
+size_t plainRunAvx2(char *p)
+{
+    size_t offset = (uintptr_t) p & 31;
+    char *block = p - offset;
+    __m256i limit = _mm256_set1_epi8(')');
+    unsigned int mask;
+
+    for(;; block += 32)
+    {
+        __m256i bytes = _mm256_load_si256((__m256i *) block);
+        __m256i flagged = _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, limit), bytes);
+        flagged = _mm256_or_si256(flagged, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(';')));
+        flagged = _mm256_or_si256(flagged, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('<')));
+        flagged = _mm256_or_si256(flagged, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('>')));
+        flagged = _mm256_or_si256(flagged, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\')));
+        flagged = _mm256_or_si256(flagged, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('|')));
+        mask = (unsigned int) _mm256_movemask_epi8(flagged);
+        if(block < p) mask &= ~0U << offset;
+        for(; mask; mask &= mask - 1)
+        {
+            char *at = block + __builtin_ctz(mask);
+            if(wordSpecial[(unsigned char) *at]) return at - p;
+        }
+    }
 }
+#endif
 
-// the following line parser was taken from https://brennan.io/2015/01/16/write-a-shell-in-c/
-#define LSH_TOK_BUFSIZE 64
-#define LSH_TOK_DELIM " \t\r\n\a"
-char **parseLine(char *line)
+// skips one character of a word, or a whole quoted string, escaped character, ${ } or $( ) starting there
+char *skipWordPart(char *p, int *incomplete)
 {
-    int bufsize = LSH_TOK_BUFSIZE, position = 0;
-    char **tokens = malloc(bufsize * sizeof(char*));
-    char *token;
+    char *end;
 
-    if (!tokens) {
-        fprintf(stderr, "lsh: allocation error\n");
+    switch(*p)
+    {
+        case '\\':
+            return p[1] ? p + 2 : p + 1;
+        case '\'':
+            end = strchr(p + 1, '\'');
+            break;
+        case '"':
+            for(end = p + 1; *end && *end != '"'; end++)
+            {
+                if(*end == '\\' && end[1]) end++;
+                else if(*end == '$' && (end[1] == '{' || end[1] == '(')) end = skipWordPart(end, incomplete) - 1;
+            }
+            if(*end == '\0') end = NULL;
+            break;
+        case '$':
+            if(p[1] != '{' && p[1] != '(') return p + 1;
+            end = skipBracketed(p + 1);
+            break;
+        default:
+            return p + 1;
+    }
+    if(end == NULL)
+    {
+        *incomplete = 1;
+        return p + strlen(p);
+    }
+    return end + 1;
+}
+
+// returns the bracket closing the ( or { at p, taking nested brackets and quotes into account, or NULL
+char *skipBracketed(char *p)
+{
+    char open = *p;
+    char close = open == '(' ? ')' : '}';
+    int depth = 0;
+    int ignored = 0;
+
+    for(; *p; p++)
+    {
+        if(*p == '\\' && p[1])
+            p++;
+        else if(*p == '\'' || *p == '"')
+        {
+            char *end = skipWordPart(p, &ignored);
+            if(ignored) return NULL;
+            p = end - 1;
+        }
+        else if(*p == open)
+            depth++;
+        else if(*p == close && --depth == 0)
+            return p;
+    }
+    return NULL;
+}
+
+
+// parses a line into a list of commands separated by ; & && || or newlines. a command is a pipeline, a { } group, a
+// ( ) subshell or an if, while, until, for or case command, and compound commands hold lists of their own. the line
+// is tokenized once and every pipeline is a NULL terminated slice of the same token array. returns PARSE_ERROR after
+// printing a syntax error, and PARSE_INCOMPLETE when the line ends in the middle of a command so more input is needed
+int parseList(char *line, struct CommandList *list)
+{
+    struct Parser parser;
+    int incomplete;
+
+    parser.tokens = parseLine(line, &incomplete);
+    parser.pos = 0;
+    parser.wordCount = countArgs(parser.tokens);
+    // the slices are cut by writing NULL over operators, compound text is rebuilt from this untouched copy
+    parser.words = malloc(sizeof(char*) * (parser.wordCount + 1));
+    if(!parser.words)
+    {
+        fprintf(stderr, "yash: allocation error\n");
         exit(EXIT_FAILURE);
     }
+    memcpy(parser.words, parser.tokens, sizeof(char*) * (parser.wordCount + 1));
+
+    int result = incomplete ? PARSE_INCOMPLETE : parseEntries(&parser, list, NULL);
+    if(incomplete)
+    {
+        list->entries = NULL;
+        list->count = 0;
+    }
+    if(result == 1 && parser.pos < parser.wordCount)
+        result = syntaxError(parser.words[parser.pos]);
+    free(parser.words);
+    list->tokens = parser.tokens;
+    if(result != 1)
+    {
+        freeList(list);
+        return result;
+    }
+    return 1;
+}
+
+// parses entries until the end of the tokens or until one of the closers (a NULL terminated list of words such as
+// "fi" or "done") is found in command position. the closer is left in place for the caller. returns PARSE_ERROR or
+// PARSE_INCOMPLETE on failure
+int parseEntries(struct Parser *parser, struct CommandList *list, char **closers)
+{
+    int connector = LIST_SEQ;
+    int capacity = 0;
+    int result;
+    char **tokens = parser->tokens;
+    char **words = parser->words;
 
-    token = strtok(line, LSH_TOK_DELIM);
-    while (token != NULL) {
-        tokens[position] = token;
-        position++;
+    list->tokens = NULL;
+    list->entries = NULL;
+    list->count = 0;
 
-        if (position >= bufsize) {
-            bufsize += LSH_TOK_BUFSIZE;
-            tokens = realloc(tokens, bufsize * sizeof(char*));
-            if (!tokens) {
-                fprintf(stderr, "lsh: allocation error\n");
+    while(1)
+    {
+        while(words[parser->pos] && strcmp(words[parser->pos], "\n") == 0)
+            tokens[parser->pos++] = NULL;
+
+        char *token = words[parser->pos];
+        if(token == NULL)
+        {
+            // the line ended inside a compound command or after && or ||
+            if(closers || connector != LIST_SEQ) return PARSE_INCOMPLETE;
+            return 1;
+        }
+        if(closers && isWordIn(token, closers))
+        {
+            if(connector != LIST_SEQ) return syntaxError(token);
+            return 1;
+        }
+        if(isListOperator(token) || isReservedCloser(token))
+            return syntaxError(token);
+
+        if(list->count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 4;
+            list->entries = realloc(list->entries, sizeof(struct ListEntry) * capacity);
+            if(!list->entries)
+            {
+                fprintf(stderr, "yash: allocation error\n");
                 exit(EXIT_FAILURE);
             }
         }
+        struct ListEntry *entry = &list->entries[list->count++];
+        memset(entry, 0, sizeof(struct ListEntry));
+        entry->connector = connector;
+
+        int start = parser->pos;
+        if(strcmp(token, "!") == 0)
+        {
+            entry->negate = 1;
+            tokens[parser->pos++] = NULL;
+            start++;
+            token = words[parser->pos];
+            if(token == NULL) return PARSE_INCOMPLETE;
+        }
+        if(isFunctionStart(words, parser->pos))
+        {
+            if((result = parseFunction(parser, entry)) != 1) return result;
+        } else if(isCompoundStart(token))
+        {
+            if((result = parseCompound(parser, entry)) != 1) return result;
+        } else if((result = parseCommand(parser, entry)) != 1)
+            return result;
+        if(words[parser->pos] && strcmp(words[parser->pos], "|") == 0)
+        {
+            if(entry->type == ENTRY_FUNCTION) return syntaxError("|");
+            if((result = parsePipe(parser, entry)) != 1) return result;
+            entry->text = joinWords(&words[start], parser->pos - start, 0);
+        }
 
-        token = strtok(NULL, LSH_TOK_DELIM);
+        // the operator after the entry becomes the NULL that ends its slice
+        token = words[parser->pos];
+        connector = LIST_SEQ;
+        if(token && (isListOperator(token) || strcmp(token, "\n") == 0))
+        {
+            if(strcmp(token, "&") == 0)
+                entry->background = 1;
+            else if(strcmp(token, "&&") == 0)
+                connector = LIST_AND;
+            else if(strcmp(token, "||") == 0)
+                connector = LIST_OR;
+            tokens[parser->pos++] = NULL;
+        } else if(token)
+        {
+            tokens[parser->pos] = NULL;
+        }
+        if(entry->type != ENTRY_PIPELINE && !entry->text)
+            entry->text = joinWords(&words[start], parser->pos - start, 0);
     }
-    tokens[position] = NULL;
-    return tokens;
 }
 
-// splits a piped argument into a struct containing two separate arguments
-struct PipedArgs getTwoArgs(char **args)
+// parses the words of a pipeline up to the operator that ends it. a | followed by a compound command ends it as well,
+// parsePipe takes over from there
+int parseCommand(struct Parser *parser, struct ListEntry *entry)
 {
-    char **args1 = malloc(sizeof(char*) * MAX_INPUT_LENGTH);
-    char **args2 = malloc(sizeof(char*) * MAX_INPUT_LENGTH);
-    int numArgs = countArgs(args);
-    int i = 0;
-    int k = 0;
-    while(!strstr(args[i],"|"))
+    char **words = parser->words;
+
+    entry->type = ENTRY_PIPELINE;
+    entry->args = &parser->tokens[parser->pos];
+    while(words[parser->pos] && !isListOperator(words[parser->pos]) && strcmp(words[parser->pos], "\n") != 0 &&
+          strcmp(words[parser->pos], ")") != 0 && strcmp(words[parser->pos], ";;") != 0)
     {
-        args1[k] = args[i];
-        i++;
-        k++;
-    };
-    args1[k] = NULL;
-    i++;
-    int j = 0;
-    while(i < numArgs)
+        if(strcmp(words[parser->pos], "(") == 0)
+            return syntaxError("(");
+        if(strcmp(words[parser->pos], "|") == 0 && words[parser->pos + 1] && isCompoundStart(words[parser->pos + 1]))
+            break;
+        parser->pos++;
+    }
+    return 1;
+}
+
+// parses the rest of a pipeline that has a compound command as a stage, entry holding the stage before the first |.
+// entry becomes an ENTRY_PIPE with one list of one entry per stage in entry->parts. a stage of plain commands runs to
+// the next | that a compound command follows, so it can be a pipeline itself
+int parsePipe(struct Parser *parser, struct ListEntry *entry)
+{
+    char **words = parser->words;
+    struct ListEntry first = *entry;
+    int result;
+
+    // the first stage takes over what was parsed, the entry keeps how it joins the list
+    memset(entry, 0, sizeof(struct ListEntry));
+    entry->type = ENTRY_PIPE;
+    entry->connector = first.connector;
+    entry->negate = first.negate;
+    first.connector = LIST_SEQ;
+    first.negate = 0;
+    addStage(entry)->entries[0] = first;
+
+    while(words[parser->pos] && strcmp(words[parser->pos], "|") == 0)
     {
-        args2[j] = args[i];
-        i++;
-        j++;
-    };
-    args2[j] = NULL;
-    struct PipedArgs pipedArgs = {args1, args2};
-    return pipedArgs;
+        parser->tokens[parser->pos++] = NULL;
+        skipNewlines(parser);
+        char *token = words[parser->pos];
+        if(token == NULL) return PARSE_INCOMPLETE;
+        if(isListOperator(token) || isReservedCloser(token) || strcmp(token, "|") == 0 || strcmp(token, ")") == 0 ||
+           strcmp(token, ";;") == 0)
+            return syntaxError(token);
+        struct ListEntry *stage = addStage(entry)->entries;
+        result = isCompoundStart(token) ? parseCompound(parser, stage) : parseCommand(parser, stage);
+        if(result != 1) return result;
+    }
+    return 1;
 }
 
-// add a process to jobs table
-void addToJobs(struct Job *jobs, char *line, int *activeJobsSize)
+// adds an empty stage to the pipeline in entry: a list of one zeroed entry. returns the list
+struct CommandList *addStage(struct ListEntry *entry)
 {
-    jobs[*activeJobsSize].line = strdup(line);
+    struct CommandList *stage = malloc(sizeof(struct CommandList));
+    struct ListEntry *stageEntry = calloc(1, sizeof(struct ListEntry));
+    struct CommandList **parts = realloc(entry->parts, sizeof(struct CommandList*) * (entry->partCount + 1));
+    if(!stage || !stageEntry || !parts)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    stage->tokens = NULL;
+    stage->entries = stageEntry;
+    stage->count = 1;
+    entry->parts = parts;
+    entry->parts[entry->partCount++] = stage;
+    return stage;
+}
 
-    if(*activeJobsSize == 0)
-        jobs[*activeJobsSize].task_no = 1;
+// parses a compound command starting at the current token, followed by any redirections that apply to all of it.
+// its lists are kept in entry->parts:
+//   { } and ( )    the body
+//   if             condition, then-body pairs for the if and each elif, then the else body if there is one
+//   while, until   the condition and the body
+//   for            the body, with the variable in entry->name and the words in entry->words
+//   case           one body per item, with the patterns of each item in entry->patterns
+int parseCompound(struct Parser *parser, struct ListEntry *entry)
+{
+    static char *braceClosers[] = {"}", NULL};
+    static char *subshellClosers[] = {")", NULL};
+    static char *thenClosers[] = {"then", NULL};
+    static char *ifClosers[] = {"elif", "else", "fi", NULL};
+    static char *fiClosers[] = {"fi", NULL};
+    static char *doClosers[] = {"do", NULL};
+    static char *doneClosers[] = {"done", NULL};
+    char **words = parser->words;
+    char *keyword = words[parser->pos];
+    int start = parser->pos;
+    int result;
+
+    parser->tokens[parser->pos++] = NULL;
+    if(strcmp(keyword, "{") == 0 || strcmp(keyword, "(") == 0)
+    {
+        entry->type = (*keyword == '{') ? ENTRY_BRACE : ENTRY_SUBSHELL;
+        result = parsePart(parser, entry, *keyword == '{' ? braceClosers : subshellClosers, 0);
+        if(result == 1) result = expectWord(parser, *keyword == '{' ? "}" : ")");
+    } else if(strcmp(keyword, "if") == 0)
+    {
+        entry->type = ENTRY_IF;
+        do
+        {
+            result = parsePart(parser, entry, thenClosers, 0);
+            if(result == 1) result = expectWord(parser, "then");
+            if(result == 1) result = parsePart(parser, entry, ifClosers, 0);
+            if(result != 1) return result;
+            keyword = words[parser->pos];
+            parser->tokens[parser->pos++] = NULL;
+        } while(strcmp(keyword, "elif") == 0);
+        if(strcmp(keyword, "else") == 0)
+        {
+            result = parsePart(parser, entry, fiClosers, 0);
+            if(result == 1) result = expectWord(parser, "fi");
+        }
+    } else if(strcmp(keyword, "while") == 0 || strcmp(keyword, "until") == 0)
+    {
+        entry->type = (*keyword == 'w') ? ENTRY_WHILE : ENTRY_UNTIL;
+        result = parsePart(parser, entry, doClosers, 0);
+        if(result == 1) result = expectWord(parser, "do");
+        if(result == 1) result = parsePart(parser, entry, doneClosers, 0);
+        if(result == 1) result = expectWord(parser, "done");
+    } else if(strcmp(keyword, "for") == 0)
+    {
+        entry->type = ENTRY_FOR;
+        result = parseForHead(parser, entry);
+        if(result == 1) result = expectWord(parser, "do");
+        if(result == 1) result = parsePart(parser, entry, doneClosers, 0);
+        if(result == 1) result = expectWord(parser, "done");
+    } else
+    {
+        entry->type = ENTRY_CASE;
+        result = parseCaseItems(parser, entry);
+    }
+    if(result != 1) return result;
+
+    if((result = parseRedirections(parser, entry)) != 1) return result;
+    entry->text = joinWords(&words[start], parser->pos - start, 0);
+    entry->needsFork = (entry->type == ENTRY_SUBSHELL) && changesShellState(entry->parts[0]);
+    return 1;
+}
+
+// parses 'name ( )' followed by the compound command that is the function's body. the body is kept as a list of
+// one entry in entry->parts
+int parseFunction(struct Parser *parser, struct ListEntry *entry)
+{
+    int start = parser->pos;
+    struct CommandList *body = malloc(sizeof(struct CommandList));
+    struct ListEntry *bodyEntry = calloc(1, sizeof(struct ListEntry));
+    entry->parts = malloc(sizeof(struct CommandList*));
+    if(!body || !bodyEntry || !entry->parts)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    body->tokens = NULL;
+    body->entries = bodyEntry;
+    body->count = 1;
+    entry->parts[0] = body;
+    entry->partCount = 1;
+    entry->type = ENTRY_FUNCTION;
+    entry->name = parser->tokens[parser->pos];
+
+    parser->tokens[parser->pos + 1] = NULL;
+    parser->pos += 3;
+    skipNewlines(parser);
+    if(parser->words[parser->pos] == NULL) return PARSE_INCOMPLETE;
+    if(!isCompoundStart(parser->words[parser->pos])) return syntaxError(parser->words[parser->pos]);
+    int result = parseCompound(parser, bodyEntry);
+    if(result != 1) return result;
+    entry->text = joinWords(&parser->words[start], parser->pos - start, 0);
+    return 1;
+}
+
+// parses the list that makes up one part of a compound command and adds it to entry->parts. an empty list is only
+// allowed when allowEmpty is set, as for the body of a case item
+int parsePart(struct Parser *parser, struct ListEntry *entry, char **closers, int allowEmpty)
+{
+    struct CommandList *part = malloc(sizeof(struct CommandList));
+    struct CommandList **parts = realloc(entry->parts, sizeof(struct CommandList*) * (entry->partCount + 1));
+    if(!part || !parts)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    entry->parts = parts;
+    entry->parts[entry->partCount++] = part;
+
+    int result = parseEntries(parser, part, closers);
+    if(result == 1 && part->count == 0 && !allowEmpty)
+        return syntaxError(parser->words[parser->pos]);
+    return result;
+}
+
+// parses 'name [in word...]' followed by ; or a newline. without 'in' the loop runs over the positional parameters
+int parseForHead(struct Parser *parser, struct ListEntry *entry)
+{
+    char **words = parser->words;
+
+    if(words[parser->pos] == NULL) return PARSE_INCOMPLETE;
+    if(!isValidName(words[parser->pos], strlen(words[parser->pos])))
+        return syntaxError(words[parser->pos]);
+    entry->name = parser->tokens[parser->pos++];
+    skipNewlines(parser);
+    if(words[parser->pos] && strcmp(words[parser->pos], "in") == 0)
+    {
+        parser->tokens[parser->pos++] = NULL;
+        entry->words = &parser->tokens[parser->pos];
+        while(words[parser->pos] && strcmp(words[parser->pos], ";") != 0 && strcmp(words[parser->pos], "\n") != 0)
+        {
+            if(isListOperator(words[parser->pos]) || strchr("()<>|", *words[parser->pos]))
+                return syntaxError(words[parser->pos]);
+            parser->pos++;
+        }
+    }
+    if(words[parser->pos] == NULL) return PARSE_INCOMPLETE;
+    if(strcmp(words[parser->pos], ";") == 0 || strcmp(words[parser->pos], "\n") == 0)
+        parser->tokens[parser->pos++] = NULL;
+    else if(strcmp(words[parser->pos], "do") != 0)
+        return syntaxError(words[parser->pos]);
+    skipNewlines(parser);
+    return 1;
+}
+
+// parses 'word in [(]pattern[|pattern]...) list ;; ... esac'
+int parseCaseItems(struct Parser *parser, struct ListEntry *entry)
+{
+    static char *itemClosers[] = {";;", "esac", NULL};
+    char **words = parser->words;
+    int result;
+
+    if(words[parser->pos] == NULL) return PARSE_INCOMPLETE;
+    entry->words = &parser->tokens[parser->pos++];
+    skipNewlines(parser);
+    if((result = expectWord(parser, "in")) != 1) return result;
+
+    while(1)
+    {
+        skipNewlines(parser);
+        if(words[parser->pos] == NULL) return PARSE_INCOMPLETE;
+        if(strcmp(words[parser->pos], "esac") == 0) break;
+        if(strcmp(words[parser->pos], "(") == 0) parser->pos++;
+
+        // the patterns are collected into their own array since the | between them can't end a slice
+        char **patterns = malloc(sizeof(char*) * (parser->wordCount - parser->pos + 1));
+        int patternCount = 0;
+        if(!patterns)
+        {
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        entry->patterns = realloc(entry->patterns, sizeof(char**) * (entry->partCount + 1));
+        entry->patterns[entry->partCount] = patterns;
+        patterns[0] = NULL;
+        while(1)
+        {
+            char *word = words[parser->pos];
+            if(word == NULL) return PARSE_INCOMPLETE;
+            if(strchr(";&|<>()\n", *word)) return syntaxError(word);
+            patterns[patternCount++] = word;
+            patterns[patternCount] = NULL;
+            parser->pos++;
+            if(words[parser->pos] == NULL) return PARSE_INCOMPLETE;
+            if(strcmp(words[parser->pos], "|") != 0) break;
+            parser->pos++;
+        }
+        if((result = expectWord(parser, ")")) != 1) return result;
+
+        if((result = parsePart(parser, entry, itemClosers, 1)) != 1) return result;
+        if(strcmp(words[parser->pos], ";;") == 0)
+            parser->tokens[parser->pos++] = NULL;
+    }
+    parser->tokens[parser->pos++] = NULL;
+    return 1;
+}
+
+// parses the < and > redirections following a compound command
+int parseRedirections(struct Parser *parser, struct ListEntry *entry)
+{
+    char **words = parser->words;
+
+    entry->redirs = &parser->tokens[parser->pos];
+    while(words[parser->pos] && (strcmp(words[parser->pos], "<") == 0 || strcmp(words[parser->pos], ">") == 0))
+    {
+        char *target = words[parser->pos + 1];
+        if(target == NULL) return PARSE_INCOMPLETE;
+        if(strchr(";&|<>()\n", *target)) return syntaxError(target);
+        parser->pos += 2;
+    }
+    // anything else must end the command, or pipe it into the next one
+    char *token = words[parser->pos];
+    if(token && !isListOperator(token) && strcmp(token, "\n") != 0 && strcmp(token, ")") != 0 &&
+       strcmp(token, ";;") != 0 && strcmp(token, "|") != 0 && !isReservedCloser(token))
+        return syntaxError(token);
+    return 1;
+}
+
+// checks that the current token is word and consumes it
+int expectWord(struct Parser *parser, char *word)
+{
+    char *token = parser->words[parser->pos];
+
+    if(token == NULL) return PARSE_INCOMPLETE;
+    if(strcmp(token, word) != 0) return syntaxError(token);
+    parser->tokens[parser->pos++] = NULL;
+    return 1;
+}
+
+// skips newline tokens
+void skipNewlines(struct Parser *parser)
+{
+    while(parser->words[parser->pos] && strcmp(parser->words[parser->pos], "\n") == 0)
+        parser->tokens[parser->pos++] = NULL;
+    return;
+}
+
+// returns 1 if running the list would change the state of the shell running it: a built in that changes directory,
+// exits or changes jobs or settings, a break, continue or return out of the code around it, a variable assignment, an
+// arithmetic expansion, which can assign as well, a for loop or a background job. a subshell without any of these can
+// run without a fork unless it calls a function, which callsFunction checks when it runs
+int changesShellState(struct CommandList *list)
+{
+    for(int i=0; i<list->count; i++)
+    {
+        struct ListEntry *entry = &list->entries[i];
+        if(entry->background || entry->type == ENTRY_FOR || entry->type == ENTRY_FUNCTION) return 1;
+        if(hasArithmetic(entry->redirs) || (entry->type == ENTRY_CASE && hasArithmetic(entry->words))) return 1;
+        if(entry->type == ENTRY_PIPELINE)
+        {
+            if(entry->args[0] && (isStateBuiltIn(entry->args[0]) || isLoopControl(entry->args[0]) ||
+                                  strcmp(entry->args[0], BUILT_IN_RETURN) == 0 || isAssignment(entry->args[0]) ||
+                                  hasArithmetic(entry->args)))
+                return 1;
+            continue;
+        }
+        // a subshell decides for itself, and the stages of a pipe always run in children
+        if(entry->type == ENTRY_SUBSHELL || entry->type == ENTRY_PIPE) continue;
+        for(int p=0; p<entry->partCount; p++)
+        {
+            if(changesShellState(entry->parts[p])) return 1;
+        }
+    }
+    return 0;
+}
+
+// returns 1 for the built ins that change the shell's own state
+int isStateBuiltIn(char *name)
+{
+    return strcmp(name, BUILT_IN_CD) == 0 || strcmp(name, BUILT_IN_EXIT) == 0 ||
+           strcmp(name, BUILT_IN_FG) == 0 || strcmp(name, BUILT_IN_BG) == 0 ||
+           strcmp(name, BUILT_IN_PIPESIZE) == 0 || strcmp(name, BUILT_IN_EXPORT) == 0 ||
+           strcmp(name, BUILT_IN_UNSET) == 0 || strcmp(name, BUILT_IN_WAIT) == 0 ||
+           strcmp(name, BUILT_IN_QUEUE) == 0 || strcmp(name, BUILT_IN_READ) == 0 ||
+           strcmp(name, BUILT_IN_ENABLE) == 0 || findLoadedBuiltin(name) != NULL;
+}
+
+// returns 1 if one of the words, a NULL terminated array or NULL, has an arithmetic expansion
+int hasArithmetic(char **words)
+{
+    for(int i=0; words && words[i]; i++)
+    {
+        if(strstr(words[i], "$((")) return 1;
+    }
+    return 0;
+}
+
+// returns 1 for break and continue
+int isLoopControl(char *name)
+{
+    return strcmp(name, BUILT_IN_BREAK) == 0 || strcmp(name, BUILT_IN_CONTINUE) == 0;
+}
+
+// returns 1 for the tokens that end a list entry
+int isListOperator(char *token)
+{
+    return strcmp(token, ";") == 0 || strcmp(token, "&") == 0 || strcmp(token, "&&") == 0 || strcmp(token, "||") == 0;
+}
+
+// returns 1 if the tokens at pos are 'name ( )', the start of a function definition
+int isFunctionStart(char **words, int pos)
+{
+    return words[pos + 1] && strcmp(words[pos + 1], "(") == 0 && words[pos + 2] && strcmp(words[pos + 2], ")") == 0 &&
+           isValidName(words[pos], strlen(words[pos]));
+}
+
+// returns 1 for the words that start a compound command
+int isCompoundStart(char *token)
+{
+    static char *starts[] = {"{", "(", "if", "while", "until", "for", "case", NULL};
+    return isWordIn(token, starts);
+}
+
+// returns 1 for the reserved words that can only close a compound command
+int isReservedCloser(char *token)
+{
+    static char *closers[] = {"}", ")", "then", "elif", "else", "fi", "do", "done", "esac", ";;", NULL};
+    return isWordIn(token, closers);
+}
+
+// returns 1 if word is in the NULL terminated list
+int isWordIn(char *word, char **list)
+{
+    for(int i=0; list[i]; i++)
+    {
+        if(strcmp(word, list[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// prints a syntax error for the token it was found at and returns PARSE_ERROR
+int syntaxError(char *token)
+{
+    fprintf(stderr, "yash: syntax error near '%s'\n", strcmp(token, "\n") == 0 ? "newline" : token);
+    lastStatus = 2;
+    return PARSE_ERROR;
+}
+
+// frees a command list with the lists of its compound commands, and the token array when this is the outermost list
+void freeList(struct CommandList *list)
+{
+    for(int i=0; i<list->count; i++)
+    {
+        struct ListEntry *entry = &list->entries[i];
+        for(int p=0; p<entry->partCount; p++)
+        {
+            freeList(entry->parts[p]);
+            free(entry->parts[p]);
+            if(entry->patterns) free(entry->patterns[p]);
+        }
+        free(entry->parts);
+        free(entry->patterns);
+        free(entry->text);
+    }
+    free(list->entries);
+    free(list->tokens);
+    list->entries = NULL;
+    list->tokens = NULL;
+    list->count = 0;
+    return;
+}
+
+// joins the words of a command back into one line for the jobs table, with a trailing & for background jobs
+char *joinArgs(char **args, int inBackground)
+{
+    return joinWords(args, countArgs(args), inBackground);
+}
+
+// joins count words with single spaces, writing newlines as ';' and adding a trailing & for background jobs
+char *joinWords(char **words, int count, int inBackground)
+{
+    size_t size = inBackground ? 3 : 1;
+
+    for(int i=0; i<count; i++)
+        size += strlen(words[i]) + 1;
+    char *line = malloc(size);
+    if(!line)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char *end = line;
+    for(int i=0; i<count; i++)
+    {
+        if(i > 0) *end++ = ' ';
+        end = stpcpy(end, strcmp(words[i], "\n") == 0 ? ";" : words[i]);
+    }
+    if(inBackground) end = stpcpy(end, " &");
+    *end = '\0';
+    return line;
+}
+
+
+// compiles a parsed command list into a new program. the list can be freed afterwards
+void compileProgram(struct Program *program, struct CommandList *list)
+{
+    initProgram(program);
+    struct Compiler compiler = {.program = program};
+    compileList(&compiler, list);
+    free(compiler.loops);
+    free(compiler.groups);
+    return;
+}
+
+// runs every command in text, which may span many lines, as one program. returns 0 when the exit built in was run
+int runText(char *text)
+{
+    struct CommandList list;
+    struct Program program;
+    int result = parseList(text, &list);
+
+    if(result == PARSE_INCOMPLETE)
+    {
+        fprintf(stderr, "yash: syntax error: unexpected end of file\n");
+        lastStatus = 2;
+    }
+    if(result != 1) return FINISHED_INPUT;
+    compileProgram(&program, &list);
+    freeList(&list);
+    int returnVal = runProgram(&program, 0, program.codeLength);
+    freeProgram(&program);
+    return returnVal;
+}
+
+// reads a whole file into a NUL terminated string, or returns NULL with errno set
+char *readFile(char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+
+    if(fd == -1) return NULL;
+    if(fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return NULL;
+    }
+    char *text = malloc(st.st_size + 1);
+    if(!text)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t length = 0;
+    ssize_t got;
+    while(length < (size_t) st.st_size && (got = read(fd, text + length, st.st_size - length)) > 0)
+        length += got;
+    text[length] = '\0';
+    close(fd);
+    return text;
+}
+
+// runs ~/.yashrc. the compiled program is loaded from the cache next to it when the cache was made from a file with
+// the same path, size and modification time, otherwise the file is parsed and compiled and the cache rewritten.
+// returns 0 when the rc file ran exit
+int loadRcFile(void)
+{
+    char *home = getenv("HOME");
+    struct stat st;
+    struct Program program;
+    void *map = NULL;
+    size_t mapSize = 0;
+
+    if(!home) return FINISHED_INPUT;
+    char *path = malloc(strlen(home) + strlen(RC_FILE_NAME) + strlen(RC_CACHE_SUFFIX) + 2);
+    char *cachePath = malloc(strlen(home) + strlen(RC_FILE_NAME) + strlen(RC_CACHE_SUFFIX) + 2);
+    if(!path || !cachePath)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(path, "%s/%s", home, RC_FILE_NAME);
+    sprintf(cachePath, "%s%s", path, RC_CACHE_SUFFIX);
+    if(stat(path, &st) == -1)
+    {
+        free(path);
+        free(cachePath);
+        return FINISHED_INPUT;
+    }
+
+    if(loadProgramCache(cachePath, path, &st, &program, &map, &mapSize) == -1)
+    {
+        struct CommandList list;
+        char *text = readFile(path);
+        int result = text ? parseList(text, &list) : PARSE_ERROR;
+        if(!text) perror(path);
+        if(result == PARSE_INCOMPLETE) fprintf(stderr, "yash: %s: syntax error: unexpected end of file\n", path);
+        free(text);
+        if(result != 1)
+        {
+            free(path);
+            free(cachePath);
+            return FINISHED_INPUT;
+        }
+        compileProgram(&program, &list);
+        freeList(&list);
+        saveProgramCache(cachePath, path, &st, &program);
+    }
+
+    int returnVal = runProgram(&program, 0, program.codeLength);
+    freeProgram(&program);
+    if(map) munmap(map, mapSize);
+    free(path);
+    free(cachePath);
+    return returnVal;
+}
+
+// maps the cache at cachePath and points program at the code and strings inside the mapping, nothing is copied.
+// returns -1 when there is no cache, it was made from another version of the file or of yash, or it is damaged: its
+// checksum is wrong or the code could read outside of the mapping
+int loadProgramCache(char *cachePath, char *path, struct stat *st, struct Program *program, void **map, size_t *mapSize)
+{
+    int fd = open(cachePath, O_RDONLY | O_CLOEXEC);
+    struct stat cacheSt;
+    uint32_t checksum;
+
+    if(fd == -1) return -1;
+    if(fstat(fd, &cacheSt) == -1 || (size_t) cacheSt.st_size < sizeof(struct CacheHeader) + sizeof(checksum))
+    {
+        close(fd);
+        return -1;
+    }
+    char *data = mmap(NULL, cacheSt.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return -1;
+
+    // the checksum of everything before it ends the file
+    struct CacheHeader *header = (struct CacheHeader *) data;
+    char *end = data + cacheSt.st_size - sizeof(checksum);
+    char *cursor = data + sizeof(struct CacheHeader) + cacheAlign(header->pathLength);
+    memcpy(&checksum, end, sizeof(checksum));
+    if(memcmp(header->magic, RC_CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != RC_CACHE_VERSION ||
+       header->size != (int64_t) st->st_size || header->mtimeSec != (int64_t) st->st_mtim.tv_sec ||
+       header->mtimeNsec != (int64_t) st->st_mtim.tv_nsec || header->pathLength != strlen(path) ||
+       checksum != hashBytes(FNV_BASIS, data, end - data) ||
+       cursor > end || memcmp(data + sizeof(struct CacheHeader), path, header->pathLength) != 0 ||
+       mapProgramImage(&cursor, end, program) == -1)
+    {
+        munmap(data, cacheSt.st_size);
+        return -1;
+    }
+    if(cursor != end || validateProgram(program) == -1)
+    {
+        freeProgram(program);
+        munmap(data, cacheSt.st_size);
+        return -1;
+    }
+    *map = data;
+    *mapSize = cacheSt.st_size;
+    return 0;
+}
+
+// points program at the image at *cursor and moves the cursor past it. returns -1 if the image runs past end
+int mapProgramImage(char **cursor, char *end, struct Program *program)
+{
+    struct ProgramImage *image = (struct ProgramImage *) *cursor;
+
+    initProgram(program);
+    if(end - *cursor < (long) sizeof(struct ProgramImage)) return -1;
+    size_t codeSize = sizeof(int) * (size_t) image->codeLength;
+    size_t stringsSize = cacheAlign(image->stringsLength);
+    if(image->codeLength < 0 || image->stringsLength < 0 || image->bodyCount < 0 ||
+       (size_t) (end - *cursor) < sizeof(struct ProgramImage) + codeSize + stringsSize ||
+       (size_t) image->bodyCount > (end - *cursor) / sizeof(struct ProgramImage))
+        return -1;
+
+    program->borrowed = 1;
+    program->code = (int *) (*cursor + sizeof(struct ProgramImage));
+    program->codeLength = image->codeLength;
+    program->strings = *cursor + sizeof(struct ProgramImage) + codeSize;
+    program->stringsLength = image->stringsLength;
+    program->slotCount = image->slotCount;
+    *cursor += sizeof(struct ProgramImage) + codeSize + stringsSize;
+    if(image->bodyCount > 0)
+    {
+        program->bodies = calloc(image->bodyCount, sizeof(struct Program));
+        if(!program->bodies)
+        {
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(int i=0; i<image->bodyCount; i++)
+    {
+        program->bodyCount++;
+        if(mapProgramImage(cursor, end, &program->bodies[i]) == -1)
+        {
+            freeProgram(program);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// checks every operand of a mapped program and the bodies of its functions: strings, slots, bodies and jump targets
+// must lie inside the program, and jumps must land on an instruction. returns -1 for a program that doesn't hold
+int validateProgram(struct Program *program)
+{
+    int *code = program->code;
+    int length = program->codeLength;
+    int failed = 0;
+
+    if(program->slotCount < 0 || program->slotCount > length ||
+       (program->stringsLength > 0 && program->strings[program->stringsLength - 1] != '\0'))
+        return -1;
+    char *starts = calloc(length + 1, 1);
+    if(!starts)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    // first find where the instructions start, checking the operands that say how long each one is
+    int pc = 0;
+    while(pc < length && !failed)
+    {
+        starts[pc] = 1;
+        int op = code[pc];
+        int fixed = op == OP_FOR_BEGIN ? 3 : op == OP_ASSIGN || op == OP_PIPE ? 2 : op == OP_PIPELINE ||
+                    op == OP_GROUP_BEGIN || op == OP_CASE_MATCH ? 4 : 0;
+        failed = op < OP_PIPELINE || op > OP_PIPE || length - pc < fixed ||
+                 (fixed == 4 && code[pc + 3] < 0) || (op == OP_ASSIGN && code[pc + 1] < 0) ||
+                 (op == OP_PIPE && code[pc + 1] < 2) || (op == OP_FOR_BEGIN && code[pc + 2] < -1);
+        if(!failed)
+        {
+            failed = instructionLength(code, pc) > length - pc;
+            pc += instructionLength(code, pc);
+        }
+    }
+    starts[length] = 1;
+
+    // then the operands of each instruction
+    for(pc=0; pc<length && !failed; pc += instructionLength(code, pc))
+    {
+        int *op = &code[pc];
+        switch(op[0])
+        {
+            case OP_PIPELINE:
+                failed = !isCacheString(program, op[2]);
+                for(int i=0; i<op[3] && !failed; i++)
+                    failed = op[4 + i] < -OPERATOR_COUNT || (op[4 + i] >= 0 && !isCacheString(program, op[4 + i]));
+                break;
+            case OP_ASSIGN:
+                for(int i=0; i<op[1] && !failed; i++)
+                    failed = !isCacheString(program, op[2 + i]) || !strchr(program->strings + op[2 + i], '=');
+                break;
+            case OP_FUNCTION:
+                failed = !isCacheString(program, op[1]) || op[2] < 0 || op[2] >= program->bodyCount;
+                break;
+            case OP_RETURN:
+                failed = op[1] < 0 || op[1] > 1 || (op[1] == 1 && !isCacheString(program, op[2]));
+                break;
+            case OP_JUMP:
+            case OP_JUMP_IF_FALSE:
+            case OP_JUMP_IF_TRUE:
+                failed = !isCacheTarget(starts, length, op[1]);
+                break;
+            case OP_LOOP_STATUS:
+            case OP_GROUP_END:
+                failed = op[1] < 0 || op[1] >= program->slotCount;
+                break;
+            case OP_GROUP_BEGIN:
+                // pairs of a redirection operator and a file
+                failed = op[1] < 0 || op[1] >= program->slotCount || !isCacheTarget(starts, length, op[2]) ||
+                         op[3] % 2 != 0 || op[3] > MAX_GROUP_REDIRS * 2;
+                for(int i=0; i<op[3] && !failed; i += 2)
+                    failed = (op[4 + i] != -1 - OPERATOR_IN && op[4 + i] != -1 - OPERATOR_OUT) ||
+                             !isCacheString(program, op[5 + i]);
+                break;
+            case OP_SUBSHELL:
+                failed = !isCacheString(program, op[2]) || op[3] < pc + 4 || !isCacheTarget(starts, length, op[3]);
+                break;
+            case OP_PIPE:
+                // each stage ends where the next starts
+                failed = !isCacheString(program, op[2]);
+                for(int i=0; i<op[1] && !failed; i++)
+                    failed = op[3 + i] < (i == 0 ? pc + 3 + op[1] : op[2 + i]) ||
+                             !isCacheTarget(starts, length, op[3 + i]);
+                break;
+            case OP_FOR_BEGIN:
+                failed = op[1] < 0 || op[1] >= program->slotCount;
+                for(int i=0; i<op[2] && !failed; i++)
+                    failed = !isCacheString(program, op[3 + i]);
+                break;
+            case OP_FOR_NEXT:
+                failed = op[1] < 0 || op[1] >= program->slotCount || !isCacheString(program, op[2]) ||
+                         !isCacheTarget(starts, length, op[3]);
+                break;
+            case OP_CASE_WORD:
+                failed = op[1] < 0 || op[1] >= program->slotCount || !isCacheString(program, op[2]);
+                break;
+            case OP_CASE_MATCH:
+                failed = op[1] < 0 || op[1] >= program->slotCount || !isCacheTarget(starts, length, op[2]);
+                for(int i=0; i<op[3] && !failed; i++)
+                    failed = !isCacheString(program, op[4 + i]);
+                break;
+        }
+    }
+    free(starts);
+    for(int i=0; i<program->bodyCount && !failed; i++)
+        failed = validateProgram(&program->bodies[i]) == -1;
+    return failed ? -1 : 0;
+}
+
+// returns 1 if offset is the start of a string of the program
+int isCacheString(struct Program *program, int offset)
+{
+    return offset >= 0 && offset < program->stringsLength;
+}
+
+// returns 1 if target is the start of an instruction, or the end of the code
+int isCacheTarget(char *starts, int length, int target)
+{
+    return target >= 0 && target <= length && starts[target];
+}
+
+// writes the cache for the rc file at path. the cache is written to a temporary file and renamed over the old one,
+// so a shell starting at the same time never maps a half written cache. a cache that couldn't be written completely
+// is dropped, otherwise failures are ignored since the cache is only an optimization
+void saveProgramCache(char *cachePath, char *path, struct stat *st, struct Program *program)
+{
+    struct CacheHeader header;
+    uint32_t checksum = FNV_BASIS;
+    char *tempPath = malloc(strlen(cachePath) + 32);
+    if(!tempPath) return;
+    sprintf(tempPath, "%s.%d", cachePath, (int) getpid());
+
+    FILE *file = fopen(tempPath, "w");
+    if(!file)
+    {
+        free(tempPath);
+        return;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RC_CACHE_MAGIC, sizeof(header.magic));
+    header.version = RC_CACHE_VERSION;
+    header.size = st->st_size;
+    header.mtimeSec = st->st_mtim.tv_sec;
+    header.mtimeNsec = st->st_mtim.tv_nsec;
+    header.pathLength = strlen(path);
+    int failed = writeCache(file, &header, sizeof(header), &checksum) == -1 ||
+                 writeCachePadded(file, path, header.pathLength, &checksum) == -1 ||
+                 writeProgramImage(file, program, &checksum) == -1 ||
+                 fwrite(&checksum, sizeof(checksum), 1, file) != 1;
+    if(fclose(file) != 0 || failed || rename(tempPath, cachePath) == -1)
+        unlink(tempPath);
+    free(tempPath);
+    return;
+}
+
+// writes a program and the bodies of its functions in the layout mapProgramImage reads. returns -1 if a write failed
+int writeProgramImage(FILE *file, struct Program *program, uint32_t *checksum)
+{
+    struct ProgramImage image;
+
+    image.codeLength = program->codeLength;
+    image.stringsLength = program->stringsLength;
+    image.slotCount = program->slotCount;
+    image.bodyCount = program->bodyCount;
+    if(writeCache(file, &image, sizeof(image), checksum) == -1 ||
+       writeCache(file, program->code, sizeof(int) * program->codeLength, checksum) == -1 ||
+       writeCachePadded(file, program->strings, program->stringsLength, checksum) == -1)
+        return -1;
+    for(int i=0; i<program->bodyCount; i++)
+    {
+        if(writeProgramImage(file, &program->bodies[i], checksum) == -1) return -1;
+    }
+    return 0;
+}
+
+// writes length bytes followed by zeros up to the next multiple of CACHE_ALIGNMENT, so the code after them is aligned.
+// returns -1 if a write failed
+int writeCachePadded(FILE *file, char *data, size_t length, uint32_t *checksum)
+{
+    static const char zeros[CACHE_ALIGNMENT];
+
+    if(writeCache(file, data, length, checksum) == -1) return -1;
+    return writeCache(file, zeros, cacheAlign(length) - length, checksum);
+}
+
+// writes length bytes of data to the cache and adds them to its checksum. returns -1 if the write failed
+int writeCache(FILE *file, const void *data, size_t length, uint32_t *checksum)
+{
+    *checksum = hashBytes(*checksum, data, length);
+    return fwrite(data, 1, length, file) == length ? 0 : -1;
+}
+
+// rounds length up to a multiple of CACHE_ALIGNMENT
+size_t cacheAlign(size_t length)
+{
+    return (length + CACHE_ALIGNMENT - 1) & ~(size_t) (CACHE_ALIGNMENT - 1);
+}
+
+// compiles a parsed command list into the program's bytecode. the program holds everything it needs, the list can be
+// freed afterwards
+void compileList(struct Compiler *compiler, struct CommandList *list)
+{
+    for(int i=0; i<list->count; i++)
+        compileEntry(compiler, &list->entries[i]);
+    return;
+}
+
+// compiles one entry of a list. entries joined by && or || start with a jump over them on the previous status
+void compileEntry(struct Compiler *compiler, struct ListEntry *entry)
+{
+    struct Program *program = compiler->program;
+    int skip = -1;
+
+    if(entry->connector == LIST_AND)
+        skip = emitJump(program, OP_JUMP_IF_FALSE);
+    else if(entry->connector == LIST_OR)
+        skip = emitJump(program, OP_JUMP_IF_TRUE);
+
+    if(entry->type == ENTRY_PIPELINE)
+        compilePipeline(compiler, entry);
+    else if(entry->type == ENTRY_FUNCTION)
+        compileFunction(compiler, entry);
+    else if(entry->background || entry->type == ENTRY_SUBSHELL)
+        compileSubshell(compiler, entry);
+    else
+        compileRedirected(compiler, entry);
+
+    if(entry->negate)
+        emit(program, OP_NOT);
+    if(skip >= 0)
+        patchJump(program, skip);
+    return;
+}
+
+// compiles a pipeline: break, continue and return become jumps, a command made only of assignments sets variables and
+// anything else is run through executeLine
+void compilePipeline(struct Compiler *compiler, struct ListEntry *entry)
+{
+    struct Program *program = compiler->program;
+    char **args = entry->args;
+    int argCount = countArgs(args);
+    int assignments = 0;
+
+    if(argCount == 0) return;
+    if(!entry->background && isLoopControl(args[0]) && argCount <= 2)
+    {
+        compileLoopJump(compiler, args[0][0] == 'b', args[1] ? atoi(args[1]) : 1);
+        return;
+    }
+
+    if(!entry->background && strcmp(args[0], BUILT_IN_RETURN) == 0 && argCount <= 2)
+    {
+        emit(program, OP_RETURN);
+        emit(program, argCount - 1);
+        emit(program, argCount == 2 ? addString(program, args[1]) : 0);
+        return;
+    }
+
+    while(assignments < argCount && isAssignment(args[assignments]))
+        assignments++;
+    if(assignments == argCount && !entry->background)
+    {
+        emit(program, OP_ASSIGN);
+        emit(program, argCount);
+        for(int i=0; i<argCount; i++)
+            emit(program, addString(program, args[i]));
+        return;
+    }
+
+    int flags = entry->background ? PIPELINE_BACKGROUND : 0;
+    for(int i=0; i<argCount; i++)
+    {
+        if(strpbrk(args[i], EXPANSION_CHARS)) flags |= PIPELINE_EXPAND;
+    }
+    char *text = joinArgs(args, entry->background);
+    emit(program, OP_PIPELINE);
+    emit(program, flags);
+    emit(program, addString(program, text));
+    emit(program, argCount);
+    for(int i=0; i<argCount; i++)
+        emit(program, addWord(program, args[i]));
+    free(text);
+    return;
+}
+
+// compiles a function definition. the body is compiled once, into a program of its own kept with this one, and
+// running the definition copies it into the function table
+void compileFunction(struct Compiler *compiler, struct ListEntry *entry)
+{
+    struct Program *program = compiler->program;
+    struct Program body;
+
+    initProgram(&body);
+    struct Compiler bodyCompiler = {.program = &body};
+    compileList(&bodyCompiler, entry->parts[0]);
+    free(bodyCompiler.loops);
+    free(bodyCompiler.groups);
+
+    program->bodies = realloc(program->bodies, sizeof(struct Program) * (program->bodyCount + 1));
+    if(!program->bodies)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    program->bodies[program->bodyCount] = body;
+    emit(program, OP_FUNCTION);
+    emit(program, addString(program, entry->name));
+    emit(program, program->bodyCount++);
+    return;
+}
+
+// compiles break or continue into a jump out of, or back to the top of, the count-th enclosing loop. groups opened
+// inside the loop are closed on the way out. outside a loop they do nothing
+void compileLoopJump(struct Compiler *compiler, int isBreak, int count)
+{
+    struct Program *program = compiler->program;
+
+    if(count < 1) count = 1;
+    if(compiler->loopCount - compiler->loopBase < count)
+        count = compiler->loopCount - compiler->loopBase;
+    if(count == 0)
+    {
+        emitStatus(program, 0);
+        return;
+    }
+
+    struct LoopLabel *loop = &compiler->loops[compiler->loopCount - count];
+    for(int g=compiler->groupCount-1; g>=loop->groupDepth; g--)
+    {
+        emit(program, OP_GROUP_END);
+        emit(program, compiler->groups[g]);
+    }
+    emitStatus(program, 0);
+    if(isBreak)
+    {
+        loop->breaks = realloc(loop->breaks, sizeof(int) * (loop->breakCount + 1));
+        loop->breaks[loop->breakCount++] = emitJump(program, OP_JUMP);
+    } else
+    {
+        emit(program, OP_JUMP);
+        emit(program, loop->continueTarget);
+    }
+    return;
+}
+
+// compiles a subshell, or any compound command run in the background. those and a subshell that changes shell state
+// always run in a forked child, which runs the code up to the end of the subshell and exits. any other subshell is
+// only known to be safe to run inline once the functions it might call are known, so runProgram decides
+void compileSubshell(struct Compiler *compiler, struct ListEntry *entry)
+{
+    struct Program *program = compiler->program;
+    char *text = joinWords(&entry->text, 1, entry->background);
+    int savedBase = compiler->loopBase;
+    int savedGroups = compiler->groupCount;
+
+    emit(program, OP_SUBSHELL);
+    emit(program, (entry->background ? PIPELINE_BACKGROUND : 0) | (entry->needsFork ? SUBSHELL_FORK : 0));
+    emit(program, addString(program, text));
+    int end = emit(program, 0);
+    free(text);
+
+    // break and continue can't reach loops outside of the child, and the child never restores the parent's groups
+    compiler->loopBase = compiler->loopCount;
+    compiler->groupCount = 0;
+    compileRedirected(compiler, entry);
+    compiler->loopBase = savedBase;
+    compiler->groupCount = savedGroups;
+    patchJump(program, end);
+    return;
+}
+
+// compiles a pipeline with compound stages: the stage count, the text and where the code of each stage ends, followed
+// by the code of the stages one after the other. each stage runs in a child of its own, so like a subshell's its code
+// can't reach the loops and groups around it
+void compilePipe(struct Compiler *compiler, struct ListEntry *entry)
+{
+    struct Program *program = compiler->program;
+    int savedBase = compiler->loopBase;
+    int savedGroups = compiler->groupCount;
+
+    emit(program, OP_PIPE);
+    emit(program, entry->partCount);
+    emit(program, addString(program, entry->text));
+    int ends = program->codeLength;
+    for(int i=0; i<entry->partCount; i++)
+        emit(program, 0);
+
+    compiler->loopBase = compiler->loopCount;
+    compiler->groupCount = 0;
+    for(int i=0; i<entry->partCount; i++)
+    {
+        compileList(compiler, entry->parts[i]);
+        patchJump(program, ends + i);
+    }
+    compiler->loopBase = savedBase;
+    compiler->groupCount = savedGroups;
+    return;
+}
+
+// compiles a compound command in this shell, with its redirections applied around it when it has any
+void compileRedirected(struct Compiler *compiler, struct ListEntry *entry)
+{
+    struct Program *program = compiler->program;
+    int redirCount = entry->redirs ? countArgs(entry->redirs) : 0;
+    int slot = -1;
+    int failed = -1;
+
+    if(redirCount > 0)
+    {
+        slot = program->slotCount++;
+        emit(program, OP_GROUP_BEGIN);
+        emit(program, slot);
+        failed = emit(program, 0);
+        emit(program, redirCount);
+        for(int i=0; i<redirCount; i++)
+            emit(program, addWord(program, entry->redirs[i]));
+        compiler->groups = realloc(compiler->groups, sizeof(int) * (compiler->groupCount + 1));
+        compiler->groups[compiler->groupCount++] = slot;
+    }
+
+    compileCompound(compiler, entry);
+
+    if(redirCount > 0)
+    {
+        compiler->groupCount--;
+        emit(program, OP_GROUP_END);
+        emit(program, slot);
+        patchJump(program, failed);
+    }
+    return;
+}
+
+// compiles the body of a compound command
+void compileCompound(struct Compiler *compiler, struct ListEntry *entry)
+{
+    struct Program *program = compiler->program;
+    int end;
+
+    switch(entry->type)
+    {
+        case ENTRY_BRACE:
+        case ENTRY_SUBSHELL:
+            compileList(compiler, entry->parts[0]);
+            break;
+        case ENTRY_PIPE:
+            compilePipe(compiler, entry);
+            break;
+        case ENTRY_IF:
+        {
+            int *ends = malloc(sizeof(int) * (entry->partCount / 2 + 1));
+            int endCount = 0;
+            int p;
+            for(p=0; p+1<entry->partCount; p+=2)
+            {
+                compileList(compiler, entry->parts[p]);
+                int next = emitJump(program, OP_JUMP_IF_FALSE);
+                compileList(compiler, entry->parts[p + 1]);
+                ends[endCount++] = emitJump(program, OP_JUMP);
+                patchJump(program, next);
+            }
+            // with no branch taken the status is that of the else body, or 0
+            if(p < entry->partCount)
+                compileList(compiler, entry->parts[p]);
+            else
+                emitStatus(program, 0);
+            for(int i=0; i<endCount; i++)
+                patchJump(program, ends[i]);
+            free(ends);
+            break;
+        }
+        case ENTRY_WHILE:
+        case ENTRY_UNTIL:
+        {
+            // the status of a loop is the status of the last body command run, or 0 if the body never ran
+            int slot = program->slotCount++;
+            emit(program, OP_LOOP_STATUS);
+            emit(program, slot);
+            emit(program, LOOP_STATUS_CLEAR);
+            int top = program->codeLength;
+            pushLoop(compiler, top);
+            compileList(compiler, entry->parts[0]);
+            end = emitJump(program, entry->type == ENTRY_WHILE ? OP_JUMP_IF_FALSE : OP_JUMP_IF_TRUE);
+            compileList(compiler, entry->parts[1]);
+            emit(program, OP_LOOP_STATUS);
+            emit(program, slot);
+            emit(program, LOOP_STATUS_SAVE);
+            emit(program, OP_JUMP);
+            emit(program, top);
+            patchJump(program, end);
+            emit(program, OP_LOOP_STATUS);
+            emit(program, slot);
+            emit(program, LOOP_STATUS_RESTORE);
+            popLoop(compiler);
+            break;
+        }
+        case ENTRY_FOR:
+        {
+            int slot = program->slotCount++;
+            int wordCount = entry->words ? countArgs(entry->words) : -1;
+            emit(program, OP_FOR_BEGIN);
+            emit(program, slot);
+            emit(program, wordCount);
+            for(int i=0; i<wordCount; i++)
+                emit(program, addString(program, entry->words[i]));
+            int top = program->codeLength;
+            emit(program, OP_FOR_NEXT);
+            emit(program, slot);
+            emit(program, addString(program, entry->name));
+            end = emit(program, 0);
+            pushLoop(compiler, top);
+            compileList(compiler, entry->parts[0]);
+            emit(program, OP_JUMP);
+            emit(program, top);
+            patchJump(program, end);
+            popLoop(compiler);
+            break;
+        }
+        case ENTRY_CASE:
+        {
+            int slot = program->slotCount++;
+            int *bodies = malloc(sizeof(int) * (entry->partCount + 1));
+            int *ends = malloc(sizeof(int) * (entry->partCount + 1));
+            emit(program, OP_CASE_WORD);
+            emit(program, slot);
+            emit(program, addString(program, entry->words[0]));
+            for(int p=0; p<entry->partCount; p++)
+            {
+                int patternCount = countArgs(entry->patterns[p]);
+                emit(program, OP_CASE_MATCH);
+                emit(program, slot);
+                bodies[p] = emit(program, 0);
+                emit(program, patternCount);
+                for(int i=0; i<patternCount; i++)
+                    emit(program, addString(program, entry->patterns[p][i]));
+            }
+            emitStatus(program, 0);
+            end = emitJump(program, OP_JUMP);
+            for(int p=0; p<entry->partCount; p++)
+            {
+                patchJump(program, bodies[p]);
+                emitStatus(program, 0);
+                compileList(compiler, entry->parts[p]);
+                ends[p] = emitJump(program, OP_JUMP);
+            }
+            patchJump(program, end);
+            for(int p=0; p<entry->partCount; p++)
+                patchJump(program, ends[p]);
+            free(bodies);
+            free(ends);
+            break;
+        }
+    }
+    return;
+}
+
+// starts a loop that continue jumps back to at top
+void pushLoop(struct Compiler *compiler, int top)
+{
+    if(compiler->loopCount == compiler->loopCapacity)
+    {
+        compiler->loopCapacity = compiler->loopCapacity ? compiler->loopCapacity * 2 : 4;
+        compiler->loops = realloc(compiler->loops, sizeof(struct LoopLabel) * compiler->loopCapacity);
+    }
+    struct LoopLabel *loop = &compiler->loops[compiler->loopCount++];
+    loop->continueTarget = top;
+    loop->breaks = NULL;
+    loop->breakCount = 0;
+    loop->groupDepth = compiler->groupCount;
+    return;
+}
+
+// ends the innermost loop, pointing its breaks at the code that follows it
+void popLoop(struct Compiler *compiler)
+{
+    struct LoopLabel *loop = &compiler->loops[--compiler->loopCount];
+
+    for(int i=0; i<loop->breakCount; i++)
+        patchJump(compiler->program, loop->breaks[i]);
+    free(loop->breaks);
+    return;
+}
+
+// sets up an empty program
+void initProgram(struct Program *program)
+{
+    memset(program, 0, sizeof(struct Program));
+    return;
+}
+
+// frees the code and strings of a program and the bodies of the functions it defines
+void freeProgram(struct Program *program)
+{
+    for(int i=0; i<program->bodyCount; i++)
+        freeProgram(&program->bodies[i]);
+    free(program->bodies);
+    if(!program->borrowed)
+    {
+        free(program->code);
+        free(program->strings);
+    }
+    initProgram(program);
+    return;
+}
+
+// appends one int to the code and returns its index
+int emit(struct Program *program, int value)
+{
+    if(program->codeLength == program->codeCapacity)
+    {
+        program->codeCapacity = program->codeCapacity ? program->codeCapacity * 2 : 64;
+        program->code = realloc(program->code, sizeof(int) * program->codeCapacity);
+        if(!program->code)
+        {
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    program->code[program->codeLength] = value;
+    return program->codeLength++;
+}
+
+// emits a jump whose target is filled in later by patchJump. returns the index of the target
+int emitJump(struct Program *program, int op)
+{
+    emit(program, op);
+    return emit(program, 0);
+}
+
+// points the jump target at index to the end of the code emitted so far
+void patchJump(struct Program *program, int index)
+{
+    program->code[index] = program->codeLength;
+    return;
+}
+
+// emits an instruction that sets the exit status
+void emitStatus(struct Program *program, int status)
+{
+    emit(program, OP_STATUS);
+    emit(program, status);
+    return;
+}
+
+// adds a word of a command to the program's string pool and returns its offset. an unquoted operator isn't added, it
+// is -1 minus its OPERATOR_ number instead so that expandWords can give it back as the operator
+int addWord(struct Program *program, char *word)
+{
+    int op = operatorIndex(word);
+
+    return op >= 0 ? -1 - op : addString(program, word);
+}
+
+// returns the OPERATOR_ number of an operator token, or -1 for any other word
+int operatorIndex(char *word)
+{
+    for(int op=0; op<OPERATOR_COUNT; op++)
+    {
+        if(strcmp(word, operatorWords[op]) == 0) return op;
+    }
+    return -1;
+}
+
+// returns 1 if word is the operator op itself and not text that reads the same
+int isOperator(char *word, int op)
+{
+    return word == operatorWords[op];
+}
+
+// returns 1 if word is one of the operators, which are shared and must not be freed
+int isOperatorWord(char *word)
+{
+    for(int op=0; op<OPERATOR_COUNT; op++)
+    {
+        if(isOperator(word, op)) return 1;
+    }
+    return 0;
+}
+
+// copies text into the program's string pool and returns its offset. code refers to strings by offset so the whole
+// program can be moved or stored without fixing up pointers
+int addString(struct Program *program, char *text)
+{
+    int size = (int) strlen(text) + 1;
+
+    if(program->stringsLength + size > program->stringsCapacity)
+    {
+        while(program->stringsLength + size > program->stringsCapacity)
+            program->stringsCapacity = program->stringsCapacity ? program->stringsCapacity * 2 : 256;
+        program->strings = realloc(program->strings, program->stringsCapacity);
+        if(!program->strings)
+        {
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(program->strings + program->stringsLength, text, size);
+    program->stringsLength += size;
+    return program->stringsLength - size;
+}
+
+
+// runs the bytecode of a program from start up to end. returns 0 when the exit built in was run, FINISHED_INPUT
+// otherwise. words are expanded as each instruction runs, nothing is parsed again
+int runProgram(struct Program *program, int start, int end)
+{
+    struct Frame *frames = calloc(program->slotCount + 1, sizeof(struct Frame));
+    struct Expansion expansion;
+    int *code = program->code;
+    char *strings = program->strings;
+    int returnVal = FINISHED_INPUT;
+    int pc = start;
+    // only this program may exec its last command, not the functions and subshells it runs
+    int tail = execTail;
+
+    execTail = 0;
+    if(!frames)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    initExpansion(&expansion);
+
+    while(pc < end && returnVal)
+    {
+        int *op = &code[pc];
+        switch(op[0])
+        {
+            case OP_PIPELINE:
+            {
+                // op: flags, text, word count, words. an operator word is -1 minus its OPERATOR_ number
+                char **args = expandWords(&expansion, strings, &op[4], op[3], op[1] & PIPELINE_EXPAND);
+                struct Function *function = *args ? findFunction(args[0]) : NULL;
+                // a command whose expansion failed is skipped. a function called in the foreground outside of a
+                // pipeline runs right here without a fork
+                if(expansion.failed)
+                    lastStatus = 1;
+                else if(function && !(op[1] & PIPELINE_BACKGROUND) && pipeQty(args) == 0 &&
+                        !hasSubstitution(args))
+                    returnVal = callFunction(function, args);
+                else if(*args)
+                {
+                    execInPlace = tail && !(op[1] & PIPELINE_BACKGROUND) && isTailPosition(code, pc + 4 + op[3], end);
+                    returnVal = executeLine(args, strings + op[2], op[1] & PIPELINE_BACKGROUND);
+                    execInPlace = 0;
+                }
+                else
+                    lastStatus = 0;
+                pc += 4 + op[3];
+                break;
+            }
+            case OP_ASSIGN:
+                // op: word count, NAME=value words
+                for(int i=0; i<op[1]; i++)
+                {
+                    char *word = strings + op[2 + i];
+                    char *equals = strchr(word, '=');
+                    char *name = strndup(word, equals - word);
+                    char *value = expandString(&expansion, equals + 1, EXPAND_STRING);
+                    if(!expansion.failed) setVar(name, value);
+                    free(name);
+                }
+                lastStatus = expansion.failed;
+                pc += 2 + op[1];
+                break;
+            case OP_FUNCTION:
+                // op: name, body index
+                defineFunction(strings + op[1], &program->bodies[op[2]]);
+                lastStatus = 0;
+                pc += 3;
+                break;
+            case OP_RETURN:
+                // op: word count, status word. ends the function, or the program outside of one
+                if(op[1] > 0)
+                    lastStatus = atoi(expandString(&expansion, strings + op[2], EXPAND_STRING)) & 0xff;
+                pc = end;
+                break;
+            case OP_JUMP:
+                pc = op[1];
+                break;
+            case OP_JUMP_IF_FALSE:
+                pc = lastStatus != 0 ? op[1] : pc + 2;
+                break;
+            case OP_JUMP_IF_TRUE:
+                pc = lastStatus == 0 ? op[1] : pc + 2;
+                break;
+            case OP_NOT:
+                lastStatus = !lastStatus;
+                pc += 1;
+                break;
+            case OP_STATUS:
+                lastStatus = op[1];
+                pc += 2;
+                break;
+            case OP_LOOP_STATUS:
+                // op: slot, what to do with the loop's status
+                if(op[2] == LOOP_STATUS_CLEAR)
+                    frames[op[1]].status = 0;
+                else if(op[2] == LOOP_STATUS_SAVE)
+                    frames[op[1]].status = lastStatus;
+                else
+                    lastStatus = frames[op[1]].status;
+                pc += 3;
+                break;
+            case OP_GROUP_BEGIN:
+            {
+                // op: slot, target when a file can't be opened, redirection word count, redirection words
+                struct Frame *frame = &frames[op[1]];
+                if(!frame->saved) frame->saved = malloc(sizeof(struct SavedFd) * MAX_GROUP_REDIRS);
+                char **redirs = expandWords(&expansion, strings, &op[4], op[3], 1);
+                frame->savedCount = applyRedirections(redirs, frame->saved);
+                if(frame->savedCount == -1)
+                {
+                    lastStatus = 1;
+                    pc = op[2];
+                    break;
+                }
+                frame->open = 1;
+                pc += 4 + op[3];
+                break;
+            }
+            case OP_GROUP_END:
+                if(frames[op[1]].open)
+                    restoreRedirections(frames[op[1]].saved, frames[op[1]].savedCount);
+                frames[op[1]].open = 0;
+                pc += 2;
+                break;
+            case OP_SUBSHELL:
+                // op: flags, text, end of the subshell's code. without a fork the code simply runs on
+                if(!(op[1] & (PIPELINE_BACKGROUND | SUBSHELL_FORK)) && !callsFunction(program, pc + 4, op[3]))
+                {
+                    pc += 4;
+                    break;
+                }
+                runSubshell(program, pc + 4, op[3], strings + op[2], op[1] & PIPELINE_BACKGROUND);
+                pc = op[3];
+                break;
+            case OP_PIPE:
+                // op: stage count, text, where the code of each stage ends. the first stage starts right after
+                runPipe(program, pc + 3 + op[1], &op[3], op[1], strings + op[2]);
+                pc = op[2 + op[1]];
+                break;
+            case OP_FOR_BEGIN:
+            {
+                // op: slot, word count or -1 for the positional parameters, words
+                struct Frame *frame = &frames[op[1]];
+                free(frame->items);
+                if(op[2] < 0)
+                {
+                    frame->items = copyWords(positionalParams, positionalCount);
+                    frame->itemCount = positionalCount;
+                } else
+                {
+                    expandWords(&expansion, strings, &op[3], op[2], 1);
+                    frame->itemCount = expansion.count;
+                    frame->items = copyWords(expansion.argv, expansion.count);
+                }
+                frame->index = 0;
+                lastStatus = 0;
+                pc += 3 + (op[2] < 0 ? 0 : op[2]);
+                break;
+            }
+            case OP_FOR_NEXT:
+            {
+                // op: slot, variable, target once every word has been used
+                struct Frame *frame = &frames[op[1]];
+                if(frame->index >= frame->itemCount)
+                {
+                    pc = op[3];
+                    break;
+                }
+                setVar(strings + op[2], frame->items[frame->index++]);
+                pc += 4;
+                break;
+            }
+            case OP_CASE_WORD:
+            {
+                // op: slot, word
+                char *subject = expandString(&expansion, strings + op[2], EXPAND_STRING);
+                free(frames[op[1]].items);
+                frames[op[1]].items = copyWords(&subject, 1);
+                pc += 3;
+                break;
+            }
+            case OP_CASE_MATCH:
+            {
+                // op: slot, target on a match, pattern count, patterns
+                char *subject = frames[op[1]].items[0];
+                int matched = 0;
+                for(int i=0; i<op[3] && !matched; i++)
+                    matched = fnmatch(expandString(&expansion, strings + op[4 + i], EXPAND_PATTERN), subject, 0) == 0;
+                pc = matched ? op[2] : pc + 4 + op[3];
+                break;
+            }
+            default:
+                fprintf(stderr, "yash: bad instruction %d\n", op[0]);
+                pc = end;
+        }
+    }
+
+    // an exit inside a redirected group still puts the shell's descriptors back
+    for(int i=0; i<program->slotCount; i++)
+    {
+        if(frames[i].open) restoreRedirections(frames[i].saved, frames[i].savedCount);
+        free(frames[i].items);
+        free(frames[i].saved);
+    }
+    free(frames);
+    freeExpansion(&expansion);
+    return returnVal;
+}
+
+// returns 1 when nothing but unconditional jumps runs between pc and end, so the command before pc is the last one
+int isTailPosition(int *code, int pc, int end)
+{
+    for(int jumps=0; pc < end && code[pc] == OP_JUMP && jumps < TAIL_JUMP_LIMIT; jumps++)
+        pc = code[pc + 1];
+    return pc == end;
+}
+
+// returns 1 if a command of the code from start to end is a function, or is named by an expansion and might be one.
+// a function could change anything, and is looked up when the subshell runs since it may have been defined after the
+// subshell was compiled. subshells nested in the code are left to decide for themselves, and the stages of a pipe
+// run in children anyway
+int callsFunction(struct Program *program, int start, int end)
+{
+    int *code = program->code;
+    char *strings = program->strings;
+
+    for(int pc=start; pc<end; pc = code[pc] == OP_SUBSHELL ? code[pc + 3] :
+                                  code[pc] == OP_PIPE ? code[pc + 2 + code[pc + 1]] : pc + instructionLength(code, pc))
+    {
+        if(code[pc] != OP_PIPELINE) continue;
+        int *words = &code[pc + 4];
+        int commandStart = 1;
+        for(int i=0; i<code[pc + 3]; i++)
+        {
+            if(words[i] < 0)
+            {
+                // the word after a redirection is its file, and a pipe starts the next command
+                int op = -1 - words[i];
+                if(op == OPERATOR_IN || op == OPERATOR_OUT) i++;
+                else commandStart = 1;
+                continue;
+            }
+            char *word = strings + words[i];
+            if(!commandStart || isAssignment(word)) continue;
+            if(findFunction(word) || strpbrk(word, EXPANSION_CHARS "`")) return 1;
+            commandStart = 0;
+        }
+    }
+    return 0;
+}
+
+// returns the number of ints the instruction at pc takes, operands included
+int instructionLength(int *code, int pc)
+{
+    switch(code[pc])
+    {
+        case OP_PIPELINE:
+        case OP_GROUP_BEGIN:
+        case OP_CASE_MATCH:
+            return 4 + code[pc + 3];
+        case OP_ASSIGN:
+            return 2 + code[pc + 1];
+        case OP_PIPE:
+            return 3 + code[pc + 1];
+        case OP_FOR_BEGIN:
+            return 3 + (code[pc + 2] < 0 ? 0 : code[pc + 2]);
+        case OP_NOT:
+            return 1;
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_TRUE:
+        case OP_STATUS:
+        case OP_GROUP_END:
+            return 2;
+        case OP_LOOP_STATUS:
+        case OP_FUNCTION:
+        case OP_RETURN:
+        case OP_CASE_WORD:
+            return 3;
+        case OP_SUBSHELL:
+        case OP_FOR_NEXT:
+            return 4;
+    }
+    return 1;
+}
+
+// forks a child that runs the code from start to end and exits with its status. the child is a job of this shell,
+// waited on in the foreground unless inBackground is set
+void runSubshell(struct Program *program, int start, int end, char *text, int inBackground)
+{
+    fflush(stdout);
+    addToJobs(&jobs, text, pactiveJobsSize, &jobsCapacity);
+    int child = fork();
+    if(child == 0)
+    {
+        if(inBackground) setpgid(0, 0);
+        enterSubshell();
+        execTail = tailExecEnabled;
+        runProgram(program, start, end);
+        // _exit so the stdio of the parent's input is not synced back to the shared offset
+        fflush(stdout);
+        _exit(lastStatus);
+    } else if(child < 0)
+    {
+        perror("error forking");
+        removeLastFromJobs(jobs, pactiveJobsSize);
+        lastStatus = 1;
+        return;
+    }
+    startJobsPID(jobs, child, activeJobsSize);
+    if(inBackground)
+    {
+        setpgid(child, child);
+        lastBackgroundPid = child;
+        lastStatus = 0;
+    } else
+    {
+        pid_ch1 = child;
+        waitForJob(jobs, child, pactiveJobsSize);
+    }
+    return;
+}
+
+// forks a child for each of the count stages of a pipe, with a pipe from each stage's stdout to the next one's stdin.
+// the first stage runs the code from start to ends[0], every other one from where the one before it ends. the stages
+// are one foreground job, whose status is the last stage's
+void runPipe(struct Program *program, int start, int *ends, int count, char *text)
+{
+    int input = -1;
+    int first = 0;
+    int failed = 0;
+
+    fflush(stdout);
+    addToJobs(&jobs, text, pactiveJobsSize, &jobsCapacity);
+    for(int i=0; i<count && !failed; i++)
+    {
+        int pfd[2] = {-1, -1};
+        if(i < count - 1)
+        {
+            if(pipe2(pfd, O_CLOEXEC) == -1)
+            {
+                perror("pipe");
+                failed = 1;
+                break;
+            }
+            if(pipeCapacity > 0) setPipeCapacity(pfd[0], pipeCapacity);
+        }
+        int child = fork();
+        if(child == 0)
+        {
+            enterJobGroup(0);
+            if(input >= 0)
+            {
+                dup2(input, STDIN_FILENO);
+                close(input);
+            }
+            if(pfd[1] >= 0)
+            {
+                dup2(pfd[1], STDOUT_FILENO);
+                close(pfd[1]);
+                close(pfd[0]);
+            }
+            enterSubshell();
+            execTail = tailExecEnabled;
+            runProgram(program, i == 0 ? start : ends[i - 1], ends[i]);
+            fflush(stdout);
+            _exit(lastStatus);
+        } else if(child < 0)
+        {
+            perror("error forking");
+            if(pfd[0] >= 0) close(pfd[0]);
+            if(pfd[1] >= 0) close(pfd[1]);
+            failed = 1;
+            break;
+        }
+        enterJobGroup(child);
+        startJobsPID(jobs, child, activeJobsSize);
+        if(i == 0) first = child;
+        if(input >= 0) close(input);
+        if(pfd[1] >= 0) close(pfd[1]);
+        input = pfd[0];
+    }
+    if(input >= 0) close(input);
+    if(!first)
+    {
+        removeLastFromJobs(jobs, pactiveJobsSize);
+        lastStatus = 1;
+        return;
+    }
+    pid_ch1 = first;
+    waitForJob(jobs, first, pactiveJobsSize);
+    if(failed) lastStatus = 1;
+    return;
+}
+
+// copies count words into one allocation holding the pointer array and the text, freed with a single free
+char **copyWords(char **words, int count)
+{
+    size_t size = sizeof(char*) * (count + 1);
+
+    for(int i=0; i<count; i++)
+        size += strlen(words[i]) + 1;
+    char **copy = malloc(size);
+    if(!copy)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char *text = (char *) (copy + count + 1);
+    for(int i=0; i<count; i++)
+    {
+        copy[i] = text;
+        text = stpcpy(text, words[i]) + 1;
+    }
+    copy[count] = NULL;
+    return copy;
+}
+
+
+// sets up an empty expansion buffer. one buffer is reused for every command a program runs
+void initExpansion(struct Expansion *expansion)
+{
+    memset(expansion, 0, sizeof(struct Expansion));
+    return;
+}
+
+// frees an expansion buffer
+void freeExpansion(struct Expansion *expansion)
+{
+    free(expansion->text);
+    free(expansion->starts);
+    free(expansion->argv);
+    initExpansion(expansion);
+    return;
+}
+
+// expands count words from the string pool into fields and returns them as a NULL terminated array that stays valid
+// until the buffer is used again. words without anything to expand are passed through without being copied
+char **expandWords(struct Expansion *expansion, char *strings, int *offsets, int count, int expand)
+{
+    expansion->length = 0;
+    expansion->count = 0;
+    expansion->failed = 0;
+    if(expand)
+    {
+        for(int i=0; i<count; i++)
+        {
+            if(offsets[i] < 0)
+                appendOperator(expansion, -1 - offsets[i]);
+            else
+                expandWord(expansion, strings + offsets[i], EXPAND_FIELDS);
+        }
+        return finishFields(expansion);
+    }
+
+    reserveFields(expansion, count);
+    for(int i=0; i<count; i++)
+        expansion->argv[i] = offsets[i] < 0 ? operatorWords[-1 - offsets[i]] : strings + offsets[i];
+    expansion->argv[count] = NULL;
+    expansion->count = count;
+    return expansion->argv;
+}
+
+// expands a word into exactly one string without field splitting, as for assignments and case words. in
+// EXPAND_PATTERN mode quoted pattern characters are escaped so fnmatch takes them literally
+char *expandString(struct Expansion *expansion, char *word, int mode)
+{
+    expansion->length = 0;
+    expansion->count = 0;
+    expansion->failed = 0;
+    expandWord(expansion, word, mode);
+    return finishFields(expansion)[0];
+}
+
+// expands one word: removes quotes and backslashes, replaces ~ and $parameters and, in EXPAND_FIELDS mode, splits
+// unquoted parameter values on whitespace into separate fields
+void expandWord(struct Expansion *expansion, char *word, int mode)
+{
+    char *p = word;
+
+    expansion->fieldOpen = 0;
+    if(mode != EXPAND_FIELDS) openField(expansion);
+    if(mode == EXPAND_FIELDS && isSubstitution(word))
+    {
+        // the commands of <(cmd) and >(cmd) are expanded by the substituted process when it runs them
+        openField(expansion);
+        appendText(expansion, word, strlen(word), 1, mode);
+        closeField(expansion);
+        return;
+    }
+    if(*p == '~' && (p[1] == '/' || p[1] == '\0') && getenv("HOME"))
+    {
+        appendText(expansion, getenv("HOME"), strlen(getenv("HOME")), 0, mode);
+        p++;
+    }
+    expandText(expansion, p, p + strlen(p), mode);
+    closeField(expansion);
+    return;
+}
+
+// expands the text from p up to end into the open field, for a whole word or a part of one such as the pattern of
+// ${name#pattern}
+void expandText(struct Expansion *expansion, char *p, char *end, int mode)
+{
+    int inDouble = 0;
+
+    while(p < end)
+    {
+        if(*p == '\'' && !inDouble)
+        {
+            char *close = memchr(p + 1, '\'', end - p - 1);
+            if(!close) close = end;
+            openField(expansion);
+            appendText(expansion, p + 1, close - p - 1, 1, mode);
+            p = close < end ? close + 1 : close;
+        } else if(*p == '"')
+        {
+            openField(expansion);
+            inDouble = !inDouble;
+            p++;
+        } else if(*p == '\\' && p + 1 < end)
+        {
+            // inside double quotes a backslash only escapes the characters that are special there
+            if(inDouble && !strchr("$`\"\\", p[1]))
+                appendText(expansion, p, 2, 1, mode);
+            else
+                appendText(expansion, p + 1, 1, 1, mode);
+            p += 2;
+        } else if(*p == '$')
+        {
+            p = expandParameter(expansion, p, inDouble, mode);
+        } else
+        {
+            appendText(expansion, p, 1, inDouble, mode);
+            p++;
+        }
+    }
+    return;
+}
+
+// expands the parameter at p ($name, ${name}, $? $$ $# $! $0-$9 $@ $*) and returns the character after it
+char *expandParameter(struct Expansion *expansion, char *p, int inDouble, int mode)
+{
+    char number[16];
+    char *value = NULL;
+    char *name = p + 1;
+    size_t nameLength = 0;
+    char *after;
+
+    if(name[0] == '(' && name[1] == '(' && (after = expandArithmetic(expansion, p, inDouble, mode)) != NULL)
+        return after;
+    if(*name == '{')
+    {
+        char *close = skipBracketed(name);
+        if(!close)
+        {
+            appendText(expansion, p, strlen(p), inDouble, mode);
+            return p + strlen(p);
+        }
+        name++;
+        nameLength = close - name;
+        after = close + 1;
+        // anything past the name is an operator on its value
+        if(nameLength > 0 && parameterNameLength(name, close) != nameLength)
+        {
+            expandBraced(expansion, name, close, inDouble, mode);
+            return after;
+        }
+    } else if(isalpha((unsigned char) *name) || *name == '_')
+    {
+        while(isalnum((unsigned char) name[nameLength]) || name[nameLength] == '_')
+            nameLength++;
+        after = name + nameLength;
+    } else if(*name && strchr("?$#!@*0123456789", *name))
+    {
+        nameLength = 1;
+        after = name + 1;
+    } else
+    {
+        // a lone $ is literal
+        appendText(expansion, p, 1, inDouble, mode);
+        return p + 1;
+    }
+
+    if(nameLength == 1 && (*name == '@' || *name == '*'))
+    {
+        for(int i=0; i<positionalCount; i++)
+        {
+            // "$@" keeps each parameter a separate field
+            if(i > 0)
+            {
+                if(inDouble && *name == '@' && mode == EXPAND_FIELDS)
+                {
+                    closeField(expansion);
+                    openField(expansion);
+                } else
+                    appendText(expansion, " ", 1, inDouble, mode);
+            }
+            appendText(expansion, positionalParams[i], strlen(positionalParams[i]), inDouble, mode);
+        }
+        return after;
+    }
+
+    value = parameterValue(name, nameLength, number, sizeof(number));
+    if(value)
+        appendText(expansion, value, strlen(value), inDouble, mode == EXPAND_FIELDS && !inDouble ? EXPAND_SPLIT : mode);
+    return after;
+}
+
+// returns the value of the parameter name, which is length bytes long, or NULL when it isn't set. the special
+// parameters other than $@ and $* are written to number
+char *parameterValue(char *name, size_t length, char *number, size_t size)
+{
+    if(length == 1 && !isalpha((unsigned char) *name) && *name != '_')
+    {
+        switch(*name)
+        {
+            case '?':
+                snprintf(number, size, "%d", lastStatus);
+                return number;
+            case '$':
+                snprintf(number, size, "%d", (int) shell_pid);
+                return number;
+            case '#':
+                snprintf(number, size, "%d", positionalCount);
+                return number;
+            case '!':
+                if(lastBackgroundPid > 0) snprintf(number, size, "%d", lastBackgroundPid);
+                else number[0] = '\0';
+                return number;
+            case '0':
+                return shellName;
+            default:
+                if(!isdigit((unsigned char) *name)) return NULL;
+                return (*name - '1' < positionalCount) ? positionalParams[*name - '1'] : "";
+        }
+    }
+    return getVar(name, length);
+}
+
+// returns the length of the parameter name at the start of the text from p to end: a variable name or a single
+// special or digit character, 0 when there is none
+size_t parameterNameLength(char *p, char *end)
+{
+    size_t length = 0;
+
+    if(p < end && (isalpha((unsigned char) *p) || *p == '_'))
+    {
+        while(p + length < end && (isalnum((unsigned char) p[length]) || p[length] == '_'))
+            length++;
+        return length;
+    }
+    return p < end && strchr("?$#!@*0123456789", *p) ? 1 : 0;
+}
+
+// takes a scratch expansion buffer for the pattern, string and offsets of ${...} at the current nesting depth. the
+// buffers are kept from one use to the next so expanding them doesn't allocate once they have grown. returns NULL
+// past BRACED_SCRATCH_DEPTH nested expansions
+struct Expansion *takeScratch(void)
+{
+    if(scratchDepth >= BRACED_SCRATCH_DEPTH) return NULL;
+    struct Expansion *scratch = &bracedScratch[scratchDepth++];
+    scratch->length = 0;
+    scratch->count = 0;
+    scratch->failed = 0;
+    scratch->fieldOpen = 0;
+    return scratch;
+}
+
+// expands the part of a ${...} from p to end as the next field of the scratch buffer and returns its index
+int expandScratchField(struct Expansion *scratch, char *p, char *end, int mode)
+{
+    openField(scratch);
+    expandText(scratch, p, end, mode);
+    closeField(scratch);
+    return scratch->count - 1;
+}
+
+// returns the first unquoted c in the text from p to end, or end
+char *findUnquoted(char *p, char *end, char c)
+{
+    int ignored = 0;
+
+    while(p < end && *p != c)
+        p = skipWordPart(p, &ignored);
+    return p < end ? p : end;
+}
+
+// expands the ${...} operators on a parameter whose text runs from body to close: ${#name}, ${name#pattern},
+// ${name##pattern}, ${name%pattern}, ${name%%pattern}, ${name/pattern/string} with // for every match and /# or /%
+// to anchor it, and ${name:offset[:length]}. only the pieces of the value that are kept are copied, straight into
+// the expansion. ${name:-word} and the other forms of a word for an unset parameter expand to nothing
+void expandBraced(struct Expansion *expansion, char *body, char *close, int inDouble, int mode)
+{
+    int valueMode = mode == EXPAND_FIELDS && !inDouble ? EXPAND_SPLIT : mode;
+    char number[32];
+    int lengthOf = body[0] == '#';
+    char *name = body + lengthOf;
+    size_t nameLength = parameterNameLength(name, close);
+    char *op = name + nameLength;
+
+    if(nameLength == 0 || (lengthOf && op != close) || (*op == ':' && op[1] && strchr("-=?+", op[1]))) return;
+    if(lengthOf)
+    {
+        char *value = parameterValue(name, nameLength, number, sizeof(number));
+        if(nameLength == 1 && (*name == '@' || *name == '*'))
+            snprintf(number, sizeof(number), "%d", positionalCount);
+        else
+            snprintf(number, sizeof(number), "%zu", value ? strlen(value) : (size_t) 0);
+        appendText(expansion, number, strlen(number), inDouble, mode);
+        return;
+    }
+    if(!strchr("#%/:", *op) || (nameLength == 1 && (*name == '@' || *name == '*'))) return;
+
+    struct Expansion local;
+    struct Expansion *scratch = takeScratch();
+    if(!scratch)
+    {
+        initExpansion(&local);
+        scratch = &local;
+    }
+    char kind = *op;
+    int twice = op[1] == kind && kind != ':';
+    int anchor = kind == '/' && (op[1] == '#' || op[1] == '%') ? op[1] : 0;
+    char *word = op + 1 + (twice || anchor);
+    char *split = kind == '/' || kind == ':' ? findUnquoted(word, close, kind) : close;
+    int first = expandScratchField(scratch, word, split, kind == ':' ? EXPAND_STRING : EXPAND_PATTERN);
+    int second = split < close ? expandScratchField(scratch, split + 1, close, EXPAND_STRING) : -1;
+    if(scratch->failed) expansion->failed = 1;
+
+    // the value is read after the words, which can assign to variables in $(( ))
+    char *value = parameterValue(name, nameLength, number, sizeof(number));
+    if(!value) value = "";
+    if(kind == ':')
+        sliceValue(expansion, scratch, first, second, value, inDouble, valueMode);
+    else
+        trimValue(expansion, scratch, first, second, kind, twice, anchor, value, inDouble, valueMode);
+
+    if(scratch == &local)
+        freeExpansion(&local);
+    else
+        scratchDepth--;
+    return;
+}
+
+// appends ${name:offset[:length]} of value. offset and length are arithmetic expressions in fields of the scratch
+// buffer, length -1 when there is none. a negative offset counts from the end and a negative length stops that many
+// characters before it
+void sliceValue(struct Expansion *expansion, struct Expansion *scratch, int offsetField, int lengthField, char *value,
+                int inDouble, int mode)
+{
+    int64_t offset = 0;
+    int64_t length;
+    int64_t valueLength = (int64_t) strlen(value);
+
+    if(evaluateArithmetic(scratch->text + scratch->starts[offsetField], &offset) == -1)
+    {
+        expansion->failed = 1;
+        return;
+    }
+    if(offset < 0) offset += valueLength;
+    if(offset < 0 || offset > valueLength) return;
+    length = valueLength - offset;
+    if(lengthField >= 0)
+    {
+        if(evaluateArithmetic(scratch->text + scratch->starts[lengthField], &length) == -1)
+        {
+            expansion->failed = 1;
+            return;
+        }
+        if(length < 0) length += valueLength - offset;
+        if(length < 0) return;
+        if(length > valueLength - offset) length = valueLength - offset;
+    }
+    appendText(expansion, value + offset, (size_t) length, inDouble, mode);
+    return;
+}
+
+// appends value with what the pattern in field patternField of the scratch buffer matches removed: for kind # a
+// prefix, for % a suffix, the shortest one unless twice, or for / the first match, every match when twice or the
+// match at the start or end for anchor # or %, replaced by field stringField. a pattern without *, ? or [ is
+// searched for as a plain string, anything else goes through fnmatch
+void trimValue(struct Expansion *expansion, struct Expansion *scratch, int patternField, int stringField, char kind,
+               int twice, int anchor, char *value, int inDouble, int mode)
+{
+    size_t valueLength = strlen(value);
+    int literal = unescapeLiteral(scratch->text + scratch->starts[patternField]);
+    // fnmatch only takes whole strings, so prefixes are tried on a copy that can be cut short
+    char *copy = NULL;
+
+    if(!literal && (kind == '#' || (kind == '/' && anchor != '%')))
+    {
+        openField(scratch);
+        appendText(scratch, value, valueLength, 0, EXPAND_STRING);
+        closeField(scratch);
+        copy = scratch->text + scratch->starts[scratch->count - 1];
+    }
+    char *pattern = scratch->text + scratch->starts[patternField];
+    char *string = stringField >= 0 ? scratch->text + scratch->starts[stringField] : "";
+    size_t patternLength = strlen(pattern);
+    size_t start, length;
+
+    // an empty pattern matches nothing, except that anchored it still matches at the start or end
+    if(patternLength == 0 && !anchor)
+    {
+        appendText(expansion, value, valueLength, inDouble, mode);
+        return;
+    }
+    if(kind == '#' || kind == '%')
+    {
+        if(findMatch(value, copy, valueLength, pattern, patternLength, literal, kind == '#' ? '#' : '%', twice,
+                     0, &start, &length))
+        {
+            if(kind == '#')
+                appendText(expansion, value + length, valueLength - length, inDouble, mode);
+            else
+                appendText(expansion, value, start, inDouble, mode);
+        } else
+            appendText(expansion, value, valueLength, inDouble, mode);
+        return;
+    }
+
+    size_t from = 0;
+    while((from < valueLength || valueLength == 0) &&
+          findMatch(value, copy, valueLength, pattern, patternLength, literal, anchor, 1, from, &start, &length))
+    {
+        appendText(expansion, value + from, start - from, inDouble, mode);
+        appendText(expansion, string, strlen(string), inDouble, mode);
+        from = start + length;
+        if(!twice || anchor || valueLength == 0) break;
+        // an empty match still moves on a character
+        if(length == 0)
+        {
+            if(from < valueLength) appendText(expansion, value + from, 1, inDouble, mode);
+            from++;
+        }
+    }
+    if(from < valueLength) appendText(expansion, value + from, valueLength - from, inDouble, mode);
+    return;
+}
+
+// finds where the pattern matches value, starting the search at from. anchor # only tries the start and anchor % only
+// matches running to the end. longest picks the longest match at a place rather than the shortest. copy is a copy
+// of value fnmatch is run on when a match has to end before the end of value. sets start and length and returns 1
+// when there is a match
+int findMatch(char *value, char *copy, size_t valueLength, char *pattern, size_t patternLength, int literal,
+              int anchor, int longest, size_t from, size_t *start, size_t *length)
+{
+    if(literal)
+    {
+        char *found;
+        if(anchor == '#')
+            found = from == 0 && valueLength >= patternLength &&
+                    memcmp(value, pattern, patternLength) == 0 ? value : NULL;
+        else if(anchor == '%')
+            found = valueLength - from >= patternLength &&
+                    memcmp(value + valueLength - patternLength, pattern, patternLength) == 0 ?
+                    value + valueLength - patternLength : NULL;
+        else
+            found = findLiteral(value + from, valueLength - from, pattern, patternLength);
+        if(!found) return 0;
+        *start = (size_t) (found - value);
+        *length = patternLength;
+        return 1;
+    }
+
+    for(size_t s = from; s <= valueLength; s++)
+    {
+        if(anchor == '%')
+        {
+            // the longest suffix starts first
+            size_t at = longest ? s : valueLength - (s - from);
+            if(fnmatch(pattern, value + at, 0) == 0)
+            {
+                *start = at;
+                *length = valueLength - at;
+                return 1;
+            }
+            continue;
+        }
+        for(size_t n = 0; n <= valueLength - s; n++)
+        {
+            size_t end = longest ? valueLength - n : s + n;
+            char saved = copy[end];
+            copy[end] = '\0';
+            int matched = fnmatch(pattern, copy + s, 0) == 0;
+            copy[end] = saved;
+            if(matched)
+            {
+                *start = s;
+                *length = end - s;
+                return 1;
+            }
+        }
+        if(anchor == '#') break;
+    }
+    return 0;
+}
+
+// returns 1 if pattern has no unquoted *, ? or [ and so only matches itself, after taking out its backslashes
+int unescapeLiteral(char *pattern)
+{
+    char *out = pattern;
+
+    for(char *p = pattern; *p; p++)
+    {
+        if(*p == '\\' && p[1])
+            p++;
+        else if(*p == '*' || *p == '?' || *p == '[')
+            return 0;
+    }
+    for(char *p = pattern; *p; p++)
+    {
+        if(*p == '\\' && p[1]) p++;
+        *out++ = *p;
+    }
+    *out = '\0';
+    return 1;
+}
+
+// returns the widest vector instructions this processor runs, SIMD_AVX2, SIMD_SSE2 or SIMD_SCALAR. looked up once.
+// YASH_SIMD=scalar or YASH_SIMD=sse2 in the environment caps it, so the paths can be compared on one machine
+int detectSimd(void)
+{
+    if(simdLevel != SIMD_UNKNOWN) return simdLevel;
+    simdLevel = SIMD_SCALAR;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        simdLevel = SIMD_AVX2;
+    else if(__builtin_cpu_supports("sse2"))
+        simdLevel = SIMD_SSE2;
+#endif
+    char *cap = getenv("YASH_SIMD");
+    if(cap && strcmp(cap, "scalar") == 0)
+        simdLevel = SIMD_SCALAR;
+    else if(cap && strcmp(cap, "sse2") == 0 && simdLevel > SIMD_SSE2)
+        simdLevel = SIMD_SSE2;
+    return simdLevel;
+}
+
+// returns the first place needle occurs in the length bytes at haystack, or NULL. the vector searches compare the
+// first and last byte of needle at every position of a block at once and only check the places where both match
+char *findLiteral(char *haystack, size_t length, char *needle, size_t needleLength)
+{
+    if(needleLength > length) return NULL;
+    if(needleLength == 1) return memchr(haystack, needle[0], length);
+#if defined(__x86_64__) || defined(__i386__)
+    if(detectSimd() == SIMD_AVX2) return findLiteralAvx2(haystack, length, needle, needleLength);
+    if(simdLevel == SIMD_SSE2) return findLiteralSse2(haystack, length, needle, needleLength);
+#endif
+    return memmem(haystack, length, needle, needleLength);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+char *findLiteralSse2(char *haystack, size_t length, char *needle, size_t needleLength)
+{
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+    size_t i = 0;
+
+    for(; i + 16 + needleLength - 1 <= length; i += 16)
+    {
+        __m128i blockFirst = _mm_loadu_si128((__m128i *) (haystack + i));
+        __m128i blockLast = _mm_loadu_si128((__m128i *) (haystack + i + needleLength - 1));
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst),
+                                                                           _mm_cmpeq_epi8(last, blockLast)));
+        for(; mask; mask &= mask - 1)
+        {
+            size_t at = i + (size_t) __builtin_ctz(mask);
+            if(memcmp(haystack + at + 1, needle + 1, needleLength - 2) == 0) return haystack + at;
+        }
+    }
+    return memmem(haystack + i, length - i, needle, needleLength);
+}
+
+__attribute__((target("avx2")))
+char *findLiteralAvx2(char *haystack, size_t length, char *needle, size_t needleLength)
+{
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+    size_t i = 0;
+
+    for(; i + 32 + needleLength - 1 <= length; i += 32)
+    {
+        __m256i blockFirst = _mm256_loadu_si256((__m256i *) (haystack + i));
+        __m256i blockLast = _mm256_loadu_si256((__m256i *) (haystack + i + needleLength - 1));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst),
+                                                                                 _mm256_cmpeq_epi8(last, blockLast)));
+        for(; mask; mask &= mask - 1)
+        {
+            size_t at = i + (size_t) __builtin_ctz(mask);
+            if(memcmp(haystack + at + 1, needle + 1, needleLength - 2) == 0) return haystack + at;
+        }
+    }
+    return findLiteralSse2(haystack + i, length - i, needle, needleLength);
+}
+#endif
+
+// appends text to the current field. quoted text is taken literally: never split, and escaped in EXPAND_PATTERN
+// mode. in EXPAND_SPLIT mode whitespace ends the field instead of being copied
+void appendText(struct Expansion *expansion, char *text, size_t length, int quoted, int mode)
+{
+    reserveText(expansion, length * 2 + 1);
+    for(size_t i=0; i<length; i++)
+    {
+        char c = text[i];
+        if(mode == EXPAND_SPLIT && !quoted && (c == ' ' || c == '\t' || c == '\n'))
+        {
+            closeField(expansion);
+            continue;
+        }
+        openField(expansion);
+        if(mode == EXPAND_PATTERN && quoted && strchr("*?[]\\", c))
+            expansion->text[expansion->length++] = '\\';
+        expansion->text[expansion->length++] = c;
+    }
+    return;
+}
+
+// starts a new field unless one is already open
+void openField(struct Expansion *expansion)
+{
+    if(expansion->fieldOpen) return;
+    reserveFields(expansion, expansion->count + 1);
+    expansion->starts[expansion->count] = expansion->length;
+    expansion->fieldOpen = 1;
+    return;
+}
+
+// ends the open field, if there is one
+void closeField(struct Expansion *expansion)
+{
+    if(!expansion->fieldOpen) return;
+    reserveText(expansion, 1);
+    expansion->text[expansion->length++] = '\0';
+    expansion->count++;
+    expansion->fieldOpen = 0;
+    return;
+}
+
+// adds an operator word as a field of its own. it has no text, its start tells finishFields which operator it is
+void appendOperator(struct Expansion *expansion, int op)
+{
+    reserveFields(expansion, expansion->count + 1);
+    expansion->starts[expansion->count++] = OPERATOR_FIELD(op);
+    return;
+}
+
+// points the argv array at the finished fields. fields are kept as offsets while expanding since the text can move
+char **finishFields(struct Expansion *expansion)
+{
+    reserveFields(expansion, expansion->count);
+    for(int i=0; i<expansion->count; i++)
+    {
+        size_t start = expansion->starts[i];
+        expansion->argv[i] = start > OPERATOR_FIELD(OPERATOR_COUNT) ? operatorWords[OPERATOR_FIELD(0) - start] :
+                             expansion->text + start;
+    }
+    expansion->argv[expansion->count] = NULL;
+    return expansion->argv;
+}
+
+// makes room for length more bytes of text
+void reserveText(struct Expansion *expansion, size_t length)
+{
+    if(expansion->length + length <= expansion->capacity) return;
+    while(expansion->length + length > expansion->capacity)
+        expansion->capacity = expansion->capacity ? expansion->capacity * 2 : 256;
+    expansion->text = realloc(expansion->text, expansion->capacity);
+    if(!expansion->text)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    return;
+}
+
+// makes room for count fields plus the NULL that ends argv
+void reserveFields(struct Expansion *expansion, int count)
+{
+    if(count < expansion->fieldCapacity) return;
+    while(count >= expansion->fieldCapacity)
+        expansion->fieldCapacity = expansion->fieldCapacity ? expansion->fieldCapacity * 2 : 16;
+    expansion->starts = realloc(expansion->starts, sizeof(size_t) * expansion->fieldCapacity);
+    expansion->argv = realloc(expansion->argv, sizeof(char*) * expansion->fieldCapacity);
+    if(!expansion->starts || !expansion->argv)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    return;
+}
+
+// expands the $(( )) at p and returns the character after it, or NULL when p doesn't start a complete one. the
+// expression has its $parameters expanded first, bare variable names are read by the evaluator itself
+char *expandArithmetic(struct Expansion *expansion, char *p, int inDouble, int mode)
+{
+    char *close = skipBracketed(p + 1);
+    if(!close || skipBracketed(p + 2) != close - 1) return NULL;
+
+    char *text = strndup(p + 3, close - 1 - (p + 3));
+    if(strchr(text, '$'))
+    {
+        struct Expansion inner;
+        initExpansion(&inner);
+        char *expanded = strdup(expandString(&inner, text, EXPAND_STRING));
+        if(inner.failed) expansion->failed = 1;
+        freeExpansion(&inner);
+        free(text);
+        text = expanded;
+    }
+
+    int64_t value;
+    char number[32];
+    if(evaluateArithmetic(text, &value) == -1)
+    {
+        expansion->failed = 1;
+        value = 0;
+    }
+    free(text);
+    snprintf(number, sizeof(number), "%lld", (long long) value);
+    appendText(expansion, number, strlen(number), inDouble, mode);
+    return close + 1;
+}
+
+// evaluates an arithmetic expression on 64 bit integers. parsed expressions are kept in a cache keyed by their text,
+// so an expression evaluated again, as in a loop, is not parsed again. returns -1 after printing an error
+int evaluateArithmetic(char *text, int64_t *value)
+{
+    unsigned int bucket = hashName(text, strlen(text)) % ARITH_CACHE_SIZE;
+    struct ArithExpr *expr;
+
+    for(expr = arithCache[bucket]; expr; expr = expr->next)
+    {
+        if(strcmp(expr->text, text) == 0) break;
+    }
+    if(!expr)
+    {
+        expr = parseArithmetic(text);
+        if(!expr) return -1;
+        // the cache is emptied when it fills up rather than tracking which entries are still in use
+        if(arithCacheCount >= ARITH_CACHE_LIMIT) clearArithCache();
+        expr->next = arithCache[bucket];
+        arithCache[bucket] = expr;
+        arithCacheCount++;
+    }
+
+    int error = 0;
+    *value = arithValue(expr, expr->root, &error);
+    return error ? -1 : 0;
+}
+
+// parses an arithmetic expression into a tree of nodes, or returns NULL after printing a syntax error
+struct ArithExpr *parseArithmetic(char *text)
+{
+    struct ArithParser parser;
+    struct ArithExpr *expr = calloc(1, sizeof(struct ArithExpr));
+    if(!expr)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    expr->text = strdup(text);
+    parser.expr = expr;
+    parser.p = expr->text;
+    parser.error = 0;
+    nextArithToken(&parser);
+
+    expr->root = parseArithComma(&parser);
+    if(!parser.error && parser.token != ARITH_END)
+        parser.error = 1;
+    if(parser.error)
+    {
+        fprintf(stderr, "yash: arithmetic syntax error in '%s'\n", text);
+        freeArithExpr(expr);
+        return NULL;
+    }
+    return expr;
+}
+
+// reads the next token into parser->token: ARITH_END, ARITH_LITERAL (value in parser->number), ARITH_NAME (start and
+// length in parser->name and parser->nameLength) or an operator packed by ARITH_OP
+void nextArithToken(struct ArithParser *parser)
+{
+    static char *operators[] = {"<<=", ">>=", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "++", "--", "+=", "-=",
+                                "*=", "/=", "%=", "&=", "^=", "|=", NULL};
+    char *p = parser->p + strspn(parser->p, " \t\n");
+
+    if(*p == '\0')
+    {
+        parser->token = ARITH_END;
+    } else if(isdigit((unsigned char) *p))
+    {
+        char *end;
+        errno = 0;
+        parser->number = (int64_t) strtoull(p, &end, 0);
+        if(errno || isalnum((unsigned char) *end) || *end == '_') parser->error = 1;
+        parser->token = ARITH_LITERAL;
+        p = end;
+    } else if(isalpha((unsigned char) *p) || *p == '_')
+    {
+        parser->name = p;
+        while(isalnum((unsigned char) *p) || *p == '_')
+            p++;
+        parser->nameLength = p - parser->name;
+        parser->token = ARITH_NAME;
+    } else
+    {
+        parser->token = *p;
+        for(int i=0; operators[i]; i++)
+        {
+            size_t length = strlen(operators[i]);
+            if(strncmp(p, operators[i], length) == 0)
+            {
+                parser->token = ARITH_OP(operators[i][0], operators[i][1], length == 3 ? operators[i][2] : 0);
+                p += length - 1;
+                break;
+            }
+        }
+        if(!strchr("+-*/%<>=!~&|^?:,()", *p)) parser->error = 1;
+        p++;
+    }
+    parser->p = p;
+    return;
+}
+
+// expr , expr
+int parseArithComma(struct ArithParser *parser)
+{
+    int left = parseArithAssign(parser);
+
+    while(!parser->error && parser->token == ',')
+    {
+        nextArithToken(parser);
+        left = addArithNode(parser, ARITH_BINARY, ',', left, parseArithAssign(parser), -1);
+    }
+    return left;
+}
+
+// name = expr and the compound assignments, which group to the right
+int parseArithAssign(struct ArithParser *parser)
+{
+    int left = parseArithTernary(parser);
+    int op = parser->token;
+
+    if(parser->error || (op != '=' && !isArithAssignOp(op))) return left;
+    if(parser->expr->nodes[left].type != ARITH_VARIABLE)
+    {
+        parser->error = 1;
+        return left;
+    }
+    nextArithToken(parser);
+    // a compound assignment is stored with the binary operator it applies, a plain one with 0
+    int binary = op == '=' ? 0 : arithAssignToBinary(op);
+    return addArithNode(parser, ARITH_ASSIGN, binary, left, parseArithAssign(parser), -1);
+}
+
+// condition ? expr : expr
+int parseArithTernary(struct ArithParser *parser)
+{
+    int condition = parseArithBinary(parser, 1);
+
+    if(parser->error || parser->token != '?') return condition;
+    nextArithToken(parser);
+    int whenTrue = parseArithComma(parser);
+    if(parser->token != ':')
+    {
+        parser->error = 1;
+        return condition;
+    }
+    nextArithToken(parser);
+    int whenFalse = parseArithTernary(parser);
+    return addArithNode(parser, ARITH_TERNARY, '?', condition, whenTrue, whenFalse);
+}
+
+// binary operators by precedence climbing: operands bind to the operator on their left unless the one on their
+// right has a higher precedence
+int parseArithBinary(struct ArithParser *parser, int minPrecedence)
+{
+    int left = parseArithUnary(parser);
+
+    while(!parser->error)
+    {
+        int op = parser->token;
+        int precedence = arithPrecedence(op);
+        if(precedence < minPrecedence) break;
+        nextArithToken(parser);
+        int right = parseArithBinary(parser, precedence + 1);
+        left = addArithNode(parser, ARITH_BINARY, op, left, right, -1);
+    }
+    return left;
+}
+
+// prefix operators, then postfix ++ and -- on a variable
+int parseArithUnary(struct ArithParser *parser)
+{
+    int op = parser->token;
+
+    if(op == '+' || op == '-' || op == '!' || op == '~')
+    {
+        nextArithToken(parser);
+        return addArithNode(parser, ARITH_UNARY, op, parseArithUnary(parser), -1, -1);
+    }
+    if(op == ARITH_OP('+', '+', 0) || op == ARITH_OP('-', '-', 0))
+    {
+        nextArithToken(parser);
+        int operand = parseArithUnary(parser);
+        if(!parser->error && parser->expr->nodes[operand].type != ARITH_VARIABLE) parser->error = 1;
+        return addArithNode(parser, ARITH_PREFIX, op, operand, -1, -1);
+    }
+
+    int operand = parseArithPrimary(parser);
+    op = parser->token;
+    if(!parser->error && (op == ARITH_OP('+', '+', 0) || op == ARITH_OP('-', '-', 0)) &&
+       parser->expr->nodes[operand].type == ARITH_VARIABLE)
+    {
+        nextArithToken(parser);
+        return addArithNode(parser, ARITH_POSTFIX, op, operand, -1, -1);
+    }
+    return operand;
+}
+
+// a number, a variable name or a parenthesized expression
+int parseArithPrimary(struct ArithParser *parser)
+{
+    int node;
+
+    if(parser->error) return 0;
+    switch(parser->token)
+    {
+        case ARITH_LITERAL:
+            node = addArithNode(parser, ARITH_NUMBER, 0, -1, -1, -1);
+            parser->expr->nodes[node].value = parser->number;
+            break;
+        case ARITH_NAME:
+            node = addArithNode(parser, ARITH_VARIABLE, 0, -1, -1, -1);
+            parser->expr->nodes[node].name = strndup(parser->name, parser->nameLength);
+            break;
+        case '(':
+            nextArithToken(parser);
+            node = parseArithComma(parser);
+            if(parser->token != ')') parser->error = 1;
+            break;
+        default:
+            parser->error = 1;
+            return 0;
+    }
+    nextArithToken(parser);
+    return node;
+}
+
+// appends a node to the expression being parsed and returns its index
+int addArithNode(struct ArithParser *parser, int type, int op, int left, int right, int third)
+{
+    struct ArithExpr *expr = parser->expr;
+
+    if(expr->nodeCount == expr->nodeCapacity)
+    {
+        expr->nodeCapacity = expr->nodeCapacity ? expr->nodeCapacity * 2 : 8;
+        expr->nodes = realloc(expr->nodes, sizeof(struct ArithNode) * expr->nodeCapacity);
+        if(!expr->nodes)
+        {
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    struct ArithNode *node = &expr->nodes[expr->nodeCount];
+    memset(node, 0, sizeof(struct ArithNode));
+    node->type = type;
+    node->op = op;
+    node->left = left;
+    node->right = right;
+    node->third = third;
+    return expr->nodeCount++;
+}
+
+// returns the precedence of a binary operator, higher binds tighter, or 0 for anything else
+int arithPrecedence(int op)
+{
+    switch(op)
+    {
+        case ARITH_OP('|', '|', 0): return 1;
+        case ARITH_OP('&', '&', 0): return 2;
+        case '|': return 3;
+        case '^': return 4;
+        case '&': return 5;
+        case ARITH_OP('=', '=', 0):
+        case ARITH_OP('!', '=', 0): return 6;
+        case '<':
+        case '>':
+        case ARITH_OP('<', '=', 0):
+        case ARITH_OP('>', '=', 0): return 7;
+        case ARITH_OP('<', '<', 0):
+        case ARITH_OP('>', '>', 0): return 8;
+        case '+':
+        case '-': return 9;
+        case '*':
+        case '/':
+        case '%': return 10;
+        default: return 0;
+    }
+}
+
+// returns 1 for the compound assignment operators such as += and <<=
+int isArithAssignOp(int op)
+{
+    return arithAssignToBinary(op) != 0;
+}
+
+// returns the binary operator a compound assignment applies, or 0 if op isn't one
+int arithAssignToBinary(int op)
+{
+    switch(op)
+    {
+        case ARITH_OP('+', '=', 0): return '+';
+        case ARITH_OP('-', '=', 0): return '-';
+        case ARITH_OP('*', '=', 0): return '*';
+        case ARITH_OP('/', '=', 0): return '/';
+        case ARITH_OP('%', '=', 0): return '%';
+        case ARITH_OP('&', '=', 0): return '&';
+        case ARITH_OP('^', '=', 0): return '^';
+        case ARITH_OP('|', '=', 0): return '|';
+        case ARITH_OP('<', '<', '='): return ARITH_OP('<', '<', 0);
+        case ARITH_OP('>', '>', '='): return ARITH_OP('>', '>', 0);
+        default: return 0;
+    }
+}
+
+// evaluates the node at index. && || and ?: only evaluate the operands they need. error is set on division by zero
+// and on a variable that isn't a number
+int64_t arithValue(struct ArithExpr *expr, int index, int *error)
+{
+    struct ArithNode *node = &expr->nodes[index];
+    int64_t left, right;
+
+    switch(node->type)
+    {
+        case ARITH_NUMBER:
+            return node->value;
+        case ARITH_VARIABLE:
+            return arithVariable(node->name, error);
+        case ARITH_UNARY:
+            left = arithValue(expr, node->left, error);
+            if(node->op == '-') return (int64_t) (0 - (uint64_t) left);
+            if(node->op == '!') return !left;
+            if(node->op == '~') return ~left;
+            return left;
+        case ARITH_PREFIX:
+        case ARITH_POSTFIX:
+        {
+            char *name = expr->nodes[node->left].name;
+            left = arithVariable(name, error);
+            right = (int64_t) ((uint64_t) left + (node->op == ARITH_OP('+', '+', 0) ? 1 : (uint64_t) -1));
+            if(!*error) setArithVariable(name, right);
+            return node->type == ARITH_PREFIX ? right : left;
+        }
+        case ARITH_ASSIGN:
+        {
+            char *name = expr->nodes[node->left].name;
+            right = arithValue(expr, node->right, error);
+            if(node->op != 0)
+                right = arithApply(node->op, arithVariable(name, error), right, error);
+            if(!*error) setArithVariable(name, right);
+            return right;
+        }
+        case ARITH_TERNARY:
+            if(arithValue(expr, node->left, error))
+                return arithValue(expr, node->right, error);
+            return arithValue(expr, node->third, error);
+        default:
+            left = arithValue(expr, node->left, error);
+            if(node->op == ARITH_OP('&', '&', 0))
+                return left && arithValue(expr, node->right, error);
+            if(node->op == ARITH_OP('|', '|', 0))
+                return left || arithValue(expr, node->right, error);
+            right = arithValue(expr, node->right, error);
+            return arithApply(node->op, left, right, error);
+    }
+}
+
+// applies a binary operator. + - * and << wrap around instead of overflowing
+int64_t arithApply(int op, int64_t left, int64_t right, int *error)
+{
+    switch(op)
+    {
+        case '+': return (int64_t) ((uint64_t) left + (uint64_t) right);
+        case '-': return (int64_t) ((uint64_t) left - (uint64_t) right);
+        case '*': return (int64_t) ((uint64_t) left * (uint64_t) right);
+        case '/':
+        case '%':
+            if(right == 0)
+            {
+                fprintf(stderr, "yash: arithmetic: division by zero\n");
+                *error = 1;
+                return 0;
+            }
+            // the one quotient that doesn't fit in 64 bits
+            if(left == INT64_MIN && right == -1) return op == '/' ? INT64_MIN : 0;
+            return op == '/' ? left / right : left % right;
+        case '&': return left & right;
+        case '|': return left | right;
+        case '^': return left ^ right;
+        case '<': return left < right;
+        case '>': return left > right;
+        case ',': return right;
+        case ARITH_OP('<', '=', 0): return left <= right;
+        case ARITH_OP('>', '=', 0): return left >= right;
+        case ARITH_OP('=', '=', 0): return left == right;
+        case ARITH_OP('!', '=', 0): return left != right;
+        case ARITH_OP('<', '<', 0): return (int64_t) ((uint64_t) left << (right & 63));
+        case ARITH_OP('>', '>', 0): return left >> (right & 63);
+        default: return 0;
+    }
+}
+
+// returns the value of a variable as a number. an unset or empty variable is 0, any other value has to be a number
+// with nothing but blanks around it, or error is set
+int64_t arithVariable(char *name, int *error)
+{
+    char *value = getVar(name, strlen(name));
+    char *end;
+
+    if(!value || value[0] == '\0') return 0;
+    int64_t number = (int64_t) strtoull(value, &end, 0);
+    while(*end == ' ' || *end == '\t')
+        end++;
+    if(end == value || *end != '\0')
+    {
+        fprintf(stderr, "yash: arithmetic: %s: '%s' is not a number\n", name, value);
+        *error = 1;
+        return 0;
+    }
+    return number;
+}
+
+// stores a number in a variable
+void setArithVariable(char *name, int64_t value)
+{
+    char number[32];
+
+    snprintf(number, sizeof(number), "%lld", (long long) value);
+    setVar(name, number);
+    return;
+}
+
+// frees a parsed expression
+void freeArithExpr(struct ArithExpr *expr)
+{
+    for(int i=0; i<expr->nodeCount; i++)
+        free(expr->nodes[i].name);
+    free(expr->nodes);
+    free(expr->text);
+    free(expr);
+    return;
+}
+
+// empties the cache of parsed expressions
+void clearArithCache(void)
+{
+    for(int i=0; i<ARITH_CACHE_SIZE; i++)
+    {
+        while(arithCache[i])
+        {
+            struct ArithExpr *next = arithCache[i]->next;
+            freeArithExpr(arithCache[i]);
+            arithCache[i] = next;
+        }
+    }
+    arithCacheCount = 0;
+    return;
+}
+
+// returns 1 if word has the form NAME=value
+int isAssignment(char *word)
+{
+    char *equals = strchr(word, '=');
+    return equals != NULL && isValidName(word, equals - word);
+}
+
+// returns 1 if the first length characters of name make a valid variable name
+int isValidName(char *name, size_t length)
+{
+    if(length == 0 || (!isalpha((unsigned char) name[0]) && name[0] != '_')) return 0;
+    for(size_t i=1; i<length; i++)
+    {
+        if(!isalnum((unsigned char) name[i]) && name[i] != '_') return 0;
+    }
+    return 1;
+}
+
+// hashes the first length characters of name (FNV-1a)
+unsigned int hashName(char *name, size_t length)
+{
+    return hashBytes(FNV_BASIS, name, length);
+}
+
+// carries an FNV-1a hash on over length more bytes of data
+unsigned int hashBytes(unsigned int hash, const void *data, size_t length)
+{
+    const unsigned char *bytes = data;
+
+    for(size_t i=0; i<length; i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+// looks up a shell variable by the first length characters of name
+struct Var *findVar(char *name, size_t length)
+{
+    struct Var *var = varTable[hashName(name, length) % VAR_TABLE_SIZE];
+
+    for(; var; var = var->next)
+    {
+        if(strncmp(var->name, name, length) == 0 && var->name[length] == '\0') return var;
+    }
+    return NULL;
+}
+
+// returns the value of a shell variable, or NULL if it is not set
+char *getVar(char *name, size_t length)
+{
+    struct Var *var = findVar(name, length);
+    return var ? var->value : NULL;
+}
+
+// sets a shell variable, creating it if needed. exported variables are kept in the environment as well
+void setVar(char *name, char *value)
+{
+    size_t length = strlen(name);
+    struct Var *var = findVar(name, length);
+
+    if(!var)
+    {
+        unsigned int bucket = hashName(name, length) % VAR_TABLE_SIZE;
+        var = calloc(1, sizeof(struct Var));
+        if(!var)
+        {
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        var->name = strdup(name);
+        var->next = varTable[bucket];
+        varTable[bucket] = var;
+    }
+    if(var->value != value)
+    {
+        free(var->value);
+        var->value = strdup(value);
+    }
+    if(var->exported) setenv(name, value, 1);
+    return;
+}
+
+// removes a shell variable
+void unsetVar(char *name)
+{
+    unsigned int bucket = hashName(name, strlen(name)) % VAR_TABLE_SIZE;
+
+    for(struct Var **link = &varTable[bucket]; *link; link = &(*link)->next)
+    {
+        if(strcmp((*link)->name, name) == 0)
+        {
+            struct Var *var = *link;
+            *link = var->next;
+            if(var->exported) unsetenv(name);
+            free(var->name);
+            free(var->value);
+            free(var);
+            return;
+        }
+    }
+    return;
+}
+
+// loads the environment into the variable table, every variable from it is exported
+void importEnvironment(void)
+{
+    extern char **environ;
+
+    for(char **env = environ; *env; env++)
+    {
+        char *equals = strchr(*env, '=');
+        if(!equals || !isValidName(*env, equals - *env)) continue;
+        char *name = strndup(*env, equals - *env);
+        setVar(name, equals + 1);
+        findVar(name, strlen(name))->exported = 1;
+        free(name);
+    }
+    return;
+}
+
+// built in export command. marks each variable as exported, assigning it first when given as NAME=value
+int yash_export(char **args)
+{
+    for(int i=1; args[i]; i++)
+    {
+        char *equals = strchr(args[i], '=');
+        size_t length = equals ? (size_t) (equals - args[i]) : strlen(args[i]);
+        if(!isValidName(args[i], length))
+        {
+            fprintf(stderr, "export: invalid name %s\n", args[i]);
+            lastStatus = 1;
+            continue;
+        }
+        char *name = strndup(args[i], length);
+        if(equals)
+            setVar(name, equals + 1);
+        else if(!findVar(name, length))
+            setVar(name, "");
+        struct Var *var = findVar(name, length);
+        var->exported = 1;
+        setenv(name, var->value, 1);
+        free(name);
+    }
+    return FINISHED_INPUT;
+}
+
+// built in unset command. removes each named variable, or each named function with -f
+int yash_unset(char **args)
+{
+    int functions = args[1] && strcmp(args[1], "-f") == 0;
+
+    for(int i=1 + functions; args[i]; i++)
+    {
+        if(functions) unsetFunction(args[i]);
+        else unsetVar(args[i]);
+    }
+    return FINISHED_INPUT;
+}
+
+// looks up a shell function by name
+struct Function *findFunction(char *name)
+{
+    if(functionCount == 0) return NULL;
+    struct Function *function = functionTable[hashName(name, strlen(name)) % FUNCTION_TABLE_SIZE];
+
+    for(; function; function = function->next)
+    {
+        if(strcmp(function->name, name) == 0) return function;
+    }
+    return NULL;
+}
+
+// defines a function, or replaces its body. the body was compiled with the program defining it and is copied so it
+// outlives that program
+void defineFunction(char *name, struct Program *body)
+{
+    struct Function *function = findFunction(name);
+
+    if(!function)
+    {
+        unsigned int bucket = hashName(name, strlen(name)) % FUNCTION_TABLE_SIZE;
+        function = calloc(1, sizeof(struct Function));
+        if(!function)
+        {
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        function->name = strdup(name);
+        function->next = functionTable[bucket];
+        functionTable[bucket] = function;
+        functionCount++;
+    } else
+    {
+        releaseProgram(function->body);
+    }
+    function->body = copyProgram(body);
+    return;
+}
+
+// removes a shell function. a call to it that is still running keeps its body until it returns
+void unsetFunction(char *name)
+{
+    unsigned int bucket = hashName(name, strlen(name)) % FUNCTION_TABLE_SIZE;
+
+    for(struct Function **link = &functionTable[bucket]; *link; link = &(*link)->next)
+    {
+        if(strcmp((*link)->name, name) == 0)
+        {
+            struct Function *function = *link;
+            *link = function->next;
+            releaseProgram(function->body);
+            free(function->name);
+            free(function);
+            functionCount--;
+            return;
+        }
+    }
+    return;
+}
+
+// moves the redirections among args, up to MAX_GROUP_REDIRS of them, into redirs as operator and file pairs. both lists
+// end with NULL. returns the number of arguments left
+int takeRedirections(char **args, char **redirs)
+{
+    int redirCount = 0;
+    int argCount = 0;
+
+    for(int i=0; args[i]; i++)
+    {
+        if((isOperator(args[i], OPERATOR_IN) || isOperator(args[i], OPERATOR_OUT)) && args[i + 1] &&
+           redirCount < MAX_GROUP_REDIRS * 2)
+        {
+            redirs[redirCount++] = args[i];
+            redirs[redirCount++] = args[++i];
+        } else
+            args[argCount++] = args[i];
+    }
+    args[argCount] = NULL;
+    redirs[redirCount] = NULL;
+    return argCount;
+}
+
+// runs a function in this shell. the arguments after the name become the positional parameters by pointing at args,
+// nothing is copied. redirections among args apply to the whole body. returns 0 when the body ran exit
+int callFunction(struct Function *function, char **args)
+{
+    char **savedParams = positionalParams;
+    int savedCount = positionalCount;
+    struct Program *body = function->body;
+    struct SavedFd saved[MAX_GROUP_REDIRS];
+    char *redirs[MAX_GROUP_REDIRS * 2 + 1];
+    int argCount = takeRedirections(args, redirs);
+    int savedFds = applyRedirections(redirs, saved);
+    if(savedFds == -1)
+    {
+        lastStatus = 1;
+        return FINISHED_INPUT;
+    }
+
+    positionalParams = args + 1;
+    positionalCount = argCount - 1;
+    body->references++;
+    lastStatus = 0;
+    int returnVal = runProgram(body, 0, body->codeLength);
+    releaseProgram(body);
+    positionalParams = savedParams;
+    positionalCount = savedCount;
+    restoreRedirections(saved, savedFds);
+    return returnVal;
+}
+
+// replaces a forked child with the command in args. a function is run in the child instead, which then exits.
+// returns -1 like execvp when the command can't be run
+int execCommand(char **args)
+{
+    // a stage of redirections alone has no command to run once they are applied
+    if(!args[0])
+    {
+        fflush(stdout);
+        _exit(EXIT_SUCCESS);
+    }
+    struct Function *function = findFunction(args[0]);
+
+    if(function)
+    {
+        enterSubshell();
+        callFunction(function, args);
+        fflush(stdout);
+        _exit(lastStatus);
+    }
+    // a built in that is one stage of a pipeline runs in that stage's process, like a function
+    if(isBuiltIn(args[0]))
+    {
+        enterSubshell();
+        runBuiltIn(args);
+        fflush(stdout);
+        _exit(lastStatus);
+    }
+    return execvp(args[0], args);
+}
+
+// makes a heap copy of a program, with the bodies of the functions it defines
+struct Program *copyProgram(struct Program *program)
+{
+    struct Program *copy = malloc(sizeof(struct Program));
+    if(!copy)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    *copy = *program;
+    copy->borrowed = 0;
+    copy->code = malloc(sizeof(int) * (program->codeLength + 1));
+    copy->strings = malloc(program->stringsLength + 1);
+    copy->bodies = malloc(sizeof(struct Program) * (program->bodyCount + 1));
+    if(!copy->code || !copy->strings || !copy->bodies)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy->code, program->code, sizeof(int) * program->codeLength);
+    memcpy(copy->strings, program->strings, program->stringsLength);
+    copy->codeCapacity = program->codeLength + 1;
+    copy->stringsCapacity = program->stringsLength + 1;
+    for(int i=0; i<program->bodyCount; i++)
+    {
+        struct Program *body = copyProgram(&program->bodies[i]);
+        copy->bodies[i] = *body;
+        free(body);
+    }
+    copy->references = 1;
+    return copy;
+}
+
+// drops a reference to a heap program made by copyProgram and frees it once nothing uses it
+void releaseProgram(struct Program *program)
+{
+    if(--program->references > 0) return;
+    freeProgram(program);
+    free(program);
+    return;
+}
+
+// splits a piped argument into a struct containing two separate arguments
+struct PipedArgs getTwoArgs(char **args)
+{
+    int numArgs = countArgs(args);
+    char **args1 = malloc(sizeof(char*) * (numArgs + 1));
+    char **args2 = malloc(sizeof(char*) * (numArgs + 1));
+    int i = 0;
+    int k = 0;
+    while(!isOperator(args[i], OPERATOR_PIPE))
+    {
+        args1[k] = args[i];
+        i++;
+        k++;
+    };
+    args1[k] = NULL;
+    i++;
+    int j = 0;
+    while(i < numArgs)
+    {
+        args2[j] = args[i];
+        i++;
+        j++;
+    };
+    args2[j] = NULL;
+    struct PipedArgs pipedArgs = {args1, args2};
+    return pipedArgs;
+}
+
+// add a process to jobs table. the table doubles in size when it is full
+void addToJobs(struct Job **pJobs, char *line, int *activeJobsSize, int *jobsCapacity)
+{
+    if(*activeJobsSize >= *jobsCapacity)
+    {
+        struct Job *grown = realloc(*pJobs, sizeof(struct Job) * (*jobsCapacity) * 2);
+        if(!grown)
+        {
+            fprintf(stderr, "jobs table allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        *pJobs = grown;
+        *jobsCapacity *= 2;
+    }
+    struct Job *jobs = *pJobs;
+    jobs[*activeJobsSize].line = strdup(line);
+
+    if(*activeJobsSize == 0)
+        jobs[*activeJobsSize].task_no = 1;
+    else
+        jobs[*activeJobsSize].task_no = jobs[*activeJobsSize-1].task_no + 1;
+
+    jobs[*activeJobsSize].runningStatus = STOPPED;
+    jobs[*activeJobsSize].pid_no = 0;
+    jobs[*activeJobsSize].pgid = 0;
+    jobs[*activeJobsSize].startedNs = 0;
+    jobs[*activeJobsSize].procs = NULL;
+    jobs[*activeJobsSize].procCount = 0;
+    jobs[*activeJobsSize].timeoutMs = 0;
+    jobs[*activeJobsSize].killAfterMs = 0;
+    jobs[*activeJobsSize].timedOut = 0;
+    jobs[*activeJobsSize].timeoutSignal = SIGTERM;
+    jobs[*activeJobsSize].preserveStatus = 0;
+    jobs[*activeJobsSize].timer = NULL;
+    jobs[*activeJobsSize].hidden = 0;
+    jobs[*activeJobsSize].pgid = 0;
+    jobs[*activeJobsSize].startedNs = 0;
+    jobs[*activeJobsSize].queued = 0;
+
+    (*activeJobsSize)++;
+    publishJobs();
+    return;
+}
+
+// built in jobs command. prints out each job's pid number, jobs number, and status
+int yash_jobs(struct Job *jobs, int activeJobsSize)
+{
+    // the job of the pipeline jobs is writing into isn't listed
+    int last = activeJobsSize - 1;
+    while(last >= 0 && jobs[last].hidden)
+        last--;
+
+    for(int i=0; i<activeJobsSize; i++)
+    {
+        char *runningStr;
+
+        if(jobs[i].hidden) continue;
+        if(jobs[i].timedOut)
+            runningStr = "Timed out";
+        else if(jobFinished(&jobs[i]))
+            runningStr = "Done";
+        else if(jobs[i].runningStatus)
+            runningStr = "Running";
+        else
+            runningStr = "Stopped";
+
+        if(i == last)
+            printf("[%d] + %s  %d  %s\n", jobs[i].task_no, runningStr ,jobs[i].pid_no ,jobs[i].line);
+        else
+            printf("[%d] - %s  %d  %s\n", jobs[i].task_no, runningStr, jobs[i].pid_no ,jobs[i].line);
+    }
+    for(int q=0; q<queuedCount; q++)
+        printf("[Q%d]   Queued  p%d  %s\n", q + 1, queuedJobs[q].priority, queuedJobs[q].line);
+    if(last < 0 && queuedCount == 0) printf("No active jobs\n");
+    return FINISHED_INPUT;
+}
+
+// built in fg command. puts the most recent command from the jobs table into the foreground
+void yash_fg(struct Job *jobs, int activeJobSize, int *pActiveJobSize)
+{
+    if(activeJobSize == 0)
+    {
+        printf("yash: No active jobs");
+        return;
+    }
+
+    pid_ch1 = jobs[activeJobSize - 1].pid_no;
+    setJobStatus(jobs, pid_ch1, activeJobSize, RUNNING);
+    for(int i=0; i<activeJobSize; i++)
+    {
+        char *runningStr;
+        if(jobs[i].runningStatus)
+            runningStr = "Running";
+        else
+            runningStr = "Stopped";
+        if(i == activeJobSize-1)
+        {
+            if(jobs[i].pid_no == pid_ch1)
+                printf("[%d] + %s    %s\n", jobs[i].task_no, runningStr , jobs[i].line);
+
+        } else
+        {
+            if(jobs[i].pid_no == pid_ch1)
+                printf("[%d] - %s    %s\n", jobs[i].task_no, runningStr, jobs[i].line);
+        }
+    }
+    struct Job *job = &jobs[activeJobSize - 1];
+    int ownGroup = job->pgid > 0 && job->pgid != getpgrp();
+    if(ownGroup) setTerminalGroup(job->pgid);
+    if(job->procCount > 1)
+        kill(-pid_ch1, SIGCONT);
+    for(int p=0; p<job->procCount; p++)
+    {
+        if(!job->procs[p].done) kill(job->procs[p].pid, SIGCONT);
+    }
+    fflush(stdout);
+    // wait for the job that was continued only, other jobs keep running undisturbed
+    waitForJob(jobs, pid_ch1, pActiveJobSize);
+    if(ownGroup) setTerminalGroup(getpgrp());
+    return;
+}
+
+// build in bg command. puts the most recent stopped job in the background
+void yash_bg(struct Job *jobs, int activeJobSize)
+{
+    int pid=0;
+    int made_it_to_end = 1;
+
+    if(activeJobSize == 0)
+    {
+        printf("yash: No active jobs");
+        return;
+    }
+    for(int i=activeJobSize-1; i>=0; i--)
+    {
+        if((jobs[i].procCount == 1) && (jobs[i].runningStatus == STOPPED)) {
+            pid = jobs[i].pid_no;
+            made_it_to_end = 0;
+            break;
+        }
+    }
+    if(made_it_to_end == 1){
+        printf("No jobs available to put in background.\n");
+        return;
+    }
+    setJobStatus(jobs, pid, activeJobSize, RUNNING);
+    for(int i=0; i<activeJobSize; i++)
+    {
+        char *runningStr;
+
+        if(jobs[i].runningStatus)
+            runningStr = "Running";
+        else
+            runningStr = "Stopped";
+
+        if(i == activeJobSize-1)
+        {
+            if(jobs[i].pid_no == pid)
+                printf("[%d] + %s    %s\n", jobs[i].task_no, runningStr , jobs[i].line);
+
+        } else
+        {
+            if(jobs[i].pid_no == pid)
+                printf("[%d] - %s    %s\n", jobs[i].task_no, runningStr, jobs[i].line);
+        }
+    }
+    kill(pid, SIGCONT);
+    return;
+}
+
+// built in wait command. waits for the jobs given as %n or a pid, or for every running job without any, and sets
+// the status of the last one. -n returns as soon as one of them has finished with its status, -p NAME stores the
+// pid number of the job that finished last and --timeout SECONDS gives up with status 124. the shell sleeps in
+// epoll on the pidfds of the processes, woken by SIGCHLD for those without one, so nothing is polled
+int yash_wait(char **args)
+{
+    int any = 0;
+    char *pidName = NULL;
+    double timeout = -1;
+    int i = 1;
+
+    for(; args[i] && args[i][0] == '-' && args[i][1]; i++)
+    {
+        char *end = NULL;
+        if(strcmp(args[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        if(strcmp(args[i], "-n") == 0)
+            any = 1;
+        else if(strcmp(args[i], "-p") == 0 && args[i + 1] && isValidName(args[i + 1], strlen(args[i + 1])))
+            pidName = args[++i];
+        else if(strcmp(args[i], "--timeout") == 0 && args[i + 1] &&
+                (timeout = strtod(args[i + 1], &end)) >= 0 && end != args[i + 1] && *end == '\0')
+            i++;
+        else
+        {
+            fprintf(stderr, "yash: wait: usage: wait [-n] [-p NAME] [--timeout SECONDS] [%%JOB | PID ...]\n");
+            lastStatus = 2;
+            return FINISHED_INPUT;
+        }
+    }
+
+    int operands = args[i] != NULL;
+    int count = 0;
+    int capacity = countArgs(args + i) + activeJobsSize + queuedCount + 1;
+    int *pids = malloc(sizeof(int) * capacity);
+    if(!pids)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    for(; args[i]; i++)
+    {
+        int pid = findJobOperand(args[i]);
+        if(pid < 0)
+        {
+            fprintf(stderr, "yash: wait: %s: no such job\n", args[i]);
+            free(pids);
+            lastStatus = 127;
+            return FINISHED_INPUT;
+        }
+        pids[count++] = pid;
+    }
+    if(count == 0)
+    {
+        // stopped jobs would never finish, so only running ones are waited for
+        for(int j=0; j<activeJobsSize; j++)
+        {
+            if(jobs[j].runningStatus == RUNNING && jobs[j].procCount > 0) pids[count++] = jobs[j].pid_no;
+        }
+        if(any && count == 0 && queuedCount == 0)
+        {
+            free(pids);
+            lastStatus = 127;
+            return FINISHED_INPUT;
+        }
+    }
+
+    struct timespec now, deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if(timeout >= 0)
+    {
+        deadline.tv_sec += (time_t) timeout;
+        deadline.tv_nsec += (long) ((timeout - (time_t) timeout) * 1e9);
+        if(deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    // SIGCHLD stays blocked except while sleeping in epoll_pwait, so a process without a pidfd can't exit between
+    // being checked and the sleep without waking it
+    sigset_t blocked, saved, unblocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &blocked, &saved);
+    unblocked = saved;
+    sigdelset(&unblocked, SIGCHLD);
+
+    int status = 0;
+    int finishedPid = 0;
+    int pending;
+    // ctrl+c stops the wait, not the background jobs
+    pid_ch1 = -1;
+    int interruptsSeen = interrupts;
+    for(;;)
+    {
+        collectUntracked();
+        // without operands the queue is waited for too, so jobs it starts meanwhile join the ones waited for
+        if(!operands && (admitQueued() || queuedCount > 0 || runningQueuedJobs() > 0))
+        {
+            for(int j=0; j<activeJobsSize; j++)
+            {
+                int known = 0;
+                if(!jobs[j].queued || jobs[j].procCount == 0) continue;
+                for(int t=0; t<count && !known; t++)
+                    known = pids[t] == jobs[j].pid_no;
+                if(known) continue;
+                if(count == capacity)
+                {
+                    capacity *= 2;
+                    pids = realloc(pids, sizeof(int) * capacity);
+                    if(!pids)
+                    {
+                        fprintf(stderr, "yash: allocation error\n");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                pids[count++] = jobs[j].pid_no;
+            }
+        }
+        pending = 0;
+        for(int t=0; t<count; t++)
+        {
+            int jobStatus;
+            if(pids[t] == 0) continue;
+            if(takeJobStatus(pids[t], &jobStatus))
+            {
+                finishedPid = pids[t];
+                pids[t] = 0;
+                // without operands the status stays 0, as every job was waited for
+                if(any || (operands && t == count - 1)) status = jobStatus;
+                if(any) break;
+            } else
+                pending++;
+        }
+        if((pending == 0 && (operands || queuedCount == 0)) || (any && finishedPid)) break;
+
+        int waitMs = -1;
+        if(timeout >= 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long long left = (deadline.tv_sec - now.tv_sec) * 1000LL + (deadline.tv_nsec - now.tv_nsec) / 1000000;
+            if(left <= 0)
+            {
+                status = TIMED_OUT_STATUS;
+                break;
+            }
+            waitMs = left > INT_MAX ? INT_MAX : (int) left;
+        }
+
+        struct epoll_event events[MAX_REAP_EVENTS];
+        int signalsSeen = childSignals;
+        int ready = epoll_pwait(jobsEpollFd, events, MAX_REAP_EVENTS, waitMs, &unblocked);
+        // ctrl+c is counted, since it can wake the sleep together with a SIGCHLD. any other signal stops it too
+        if(interrupts != interruptsSeen || (ready == -1 && errno == EINTR && signalsSeen == childSignals))
+        {
+            status = 130;
+            break;
+        }
+        for(int e=0; e<ready; e++)
+        {
+            if(events[e].data.u64 == TIMER_EPOLL_KEY)
+                runTimers();
+            else
+                collectProcess(jobs, (int) events[e].data.u64, activeJobsSize);
+        }
+    }
+    sigprocmask(SIG_SETMASK, &saved, NULL);
+    // jobs of other operands that finished meanwhile are reported at the next prompt
+    childExited = 1;
+
+    if(pidName && finishedPid)
+    {
+        char number[16];
+        snprintf(number, sizeof(number), "%d", finishedPid);
+        setVar(pidName, number);
+    }
+    free(pids);
+    lastStatus = status;
+    return FINISHED_INPUT;
+}
+
+// returns the pid number of the job named by a wait operand, %n for job n or the pid of one of its processes, looking
+// at finished jobs that were already reported too. returns -1 when there is no such job
+int findJobOperand(char *operand)
+{
+    char *end;
+    long number = strtol(operand + (operand[0] == '%'), &end, 10);
+
+    if(end == operand + (operand[0] == '%') || *end != '\0' || number <= 0) return -1;
+    for(int i=0; i<activeJobsSize; i++)
+    {
+        if(operand[0] == '%' && jobs[i].task_no == number) return jobs[i].pid_no;
+        for(int p=0; operand[0] != '%' && p<jobs[i].procCount; p++)
+        {
+            if(jobs[i].procs[p].pid == number) return jobs[i].pid_no;
+        }
+    }
+    for(int f=finishedJobCount-1; f>=0; f--)
+    {
+        if((operand[0] == '%' ? finishedJobs[f].task_no : finishedJobs[f].pid_no) == number)
+            return finishedJobs[f].pid_no;
+    }
+    return -1;
+}
+
+// takes the status of the job started as pid if it has finished: a job still in the table is removed without being
+// reported, a remembered one is forgotten. returns 1 with status set, or 0 while the job is running
+int takeJobStatus(int pid, int *status)
+{
+    int i = findJob(jobs, pid, activeJobsSize);
+
+    if(i >= 0)
+    {
+        if(!jobFinished(&jobs[i])) return 0;
+        *status = jobExitCode(&jobs[i]);
+        removeFromJobs(jobs, pid, pactiveJobsSize);
+        return 1;
+    }
+    for(int f=finishedJobCount-1; f>=0; f--)
+    {
+        if(finishedJobs[f].pid_no != pid) continue;
+        *status = finishedJobs[f].status;
+        memmove(finishedJobs + f, finishedJobs + f + 1, sizeof(struct FinishedJob) * (finishedJobCount - f - 1));
+        finishedJobCount--;
+        return 1;
+    }
+    // a job that is gone without a trace has nothing left to wait for
+    *status = 127;
+    return 1;
+}
+
+// reaps processes that have exited without their jobs being reported: the ones whose pidfds are ready and, one at a
+// time, the ones without a pidfd
+void collectUntracked(void)
+{
+    struct epoll_event events[MAX_REAP_EVENTS];
+    int ready;
+
+    do
+    {
+        ready = epoll_wait(jobsEpollFd, events, MAX_REAP_EVENTS, 0);
+        for(int e=0; e<ready; e++)
+        {
+            if(events[e].data.u64 == TIMER_EPOLL_KEY)
+                runTimers();
+            else
+                collectProcess(jobs, (int) events[e].data.u64, activeJobsSize);
+        }
+    } while(ready == MAX_REAP_EVENTS);
+    for(int i=0; i<activeJobsSize; i++)
+    {
+        for(int p=0; p<jobs[i].procCount; p++)
+        {
+            struct Process *proc = &jobs[i].procs[p];
+            if(!proc->done && proc->pidfd < 0) collectProcess(jobs, proc->pid, activeJobsSize);
+        }
+    }
+    return;
+}
+
+// built in read command. 'read [-r] [name ...] [< file]' reads a line from stdin, splits it on the characters of IFS
+// and sets each name to a field, the last one to the rest of the line. without names the line goes in REPLY. unless
+// -r is given a backslash quotes the next character and one at the end of the line continues it on the next.
+// the status is 1 at end of file
+int yash_read(char **args)
+{
+    int raw = 0;
+    int fd = STDIN_FILENO;
+    int i = 1;
+
+    for(; args[i] && args[i][0] == '-' && args[i][1]; i++)
+    {
+        if(strcmp(args[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        if(strcmp(args[i], "-r") != 0)
+        {
+            fprintf(stderr, "yash: read: usage: read [-r] [NAME ...]\n");
+            lastStatus = 2;
+            return FINISHED_INPUT;
+        }
+        raw = 1;
+    }
+    char **names = args + i;
+    int redirIn = containsInRedir(names);
+    if(redirIn >= 0)
+    {
+        if(!names[redirIn + 1] || (fd = open(names[redirIn + 1], O_RDONLY | O_CLOEXEC)) == -1)
+        {
+            fprintf(stderr, "Cannot open file %s\n", names[redirIn + 1] ? names[redirIn + 1] : "");
+            lastStatus = 1;
+            return FINISHED_INPUT;
+        }
+        names[redirIn] = NULL;
+    }
+    for(int n=0; names[n]; n++)
+    {
+        if(!isValidName(names[n], strlen(names[n])))
+        {
+            fprintf(stderr, "yash: read: %s: not a valid name\n", names[n]);
+            if(fd != STDIN_FILENO) close(fd);
+            lastStatus = 2;
+            return FINISHED_INPUT;
+        }
+    }
+
+    struct LineBuffer line = {NULL, 0, 0};
+    int found;
+    appendLine(&line, "", 0);
+    for(;;)
+    {
+        found = readRecord(fd, &line);
+        if(found <= 0) break;
+        line.text[--line.length] = '\0';
+        // a line ending in an unquoted backslash goes on in the next one
+        size_t backslashes = 0;
+        while(!raw && backslashes < line.length && line.text[line.length - 1 - backslashes] == '\\')
+            backslashes++;
+        if(backslashes % 2 == 0) break;
+        line.text[--line.length] = '\0';
+    }
+    if(fd != STDIN_FILENO) close(fd);
+
+    struct Var *ifsVar = findVar("IFS", 3);
+    char *ifs = ifsVar ? ifsVar->value : DEFAULT_IFS;
+    char *text = line.text;
+    if(!names[0])
+    {
+        char *value = nextReadField(&text, "", raw, 1);
+        setVar("REPLY", value);
+        free(value);
+    }
+    for(int n=0; names[n]; n++)
+    {
+        char *value = nextReadField(&text, ifs, raw, names[n + 1] == NULL);
+        setVar(names[n], value);
+        free(value);
+    }
+    free(line.text);
+    if(found == -1 && errno == EINTR)
+        lastStatus = 130;
+    else
+        lastStatus = found == 1 ? 0 : 1;
+    return FINISHED_INPUT;
+}
+
+// appends the bytes of fd up to and including the next newline to line without consuming anything past it, so
+// whatever reads fd next starts on the following line. a regular file is read a chunk at a time and its offset set
+// back to the end of the line, a pipe or socket is looked at before the line is taken out of it, and only other
+// kinds of input are read a byte at a time. returns 1 when a newline was read, 0 at end of file and -1 on an error
+int readRecord(int fd, struct LineBuffer *line)
+{
+    struct stat st;
+
+    if(fstat(fd, &st) == -1) return -1;
+    if(S_ISREG(st.st_mode)) return readFileRecord(fd, &st, line);
+    if(S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode)) return readPeekedRecord(fd, S_ISSOCK(st.st_mode), line);
+    return readByteRecord(fd, line);
+}
+
+// reads a line of a regular file from the chunk kept in readWindow, reading the next chunk with pread when the
+// offset of fd has moved past it. the chunk is dropped when the file changed since it was read
+int readFileRecord(int fd, struct stat *st, struct LineBuffer *line)
+{
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+
+    if(offset == -1) return readByteRecord(fd, line);
+    if(readWindow.dev != st->st_dev || readWindow.ino != st->st_ino || readWindow.size != st->st_size ||
+       readWindow.mtime.tv_sec != st->st_mtim.tv_sec || readWindow.mtime.tv_nsec != st->st_mtim.tv_nsec)
+    {
+        readWindow.length = 0;
+        readWindow.dev = st->st_dev;
+        readWindow.ino = st->st_ino;
+        readWindow.size = st->st_size;
+        readWindow.mtime = st->st_mtim;
+    }
+    if(!readWindow.data && !(readWindow.data = malloc(READ_CHUNK)))
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    for(;;)
+    {
+        if(offset < readWindow.offset || offset >= readWindow.offset + (off_t) readWindow.length)
+        {
+            ssize_t got = pread(fd, readWindow.data, READ_CHUNK, offset);
+            if(got <= 0)
+            {
+                readWindow.length = 0;
+                lseek(fd, offset, SEEK_SET);
+                return got == 0 ? 0 : -1;
+            }
+            readWindow.offset = offset;
+            readWindow.length = (size_t) got;
+        }
+        char *start = readWindow.data + (offset - readWindow.offset);
+        size_t available = readWindow.length - (size_t) (offset - readWindow.offset);
+        char *newline = memchr(start, '\n', available);
+        size_t taken = newline ? (size_t) (newline - start) + 1 : available;
+        appendLine(line, start, taken);
+        offset += (off_t) taken;
+        if(newline)
+        {
+            lseek(fd, offset, SEEK_SET);
+            return 1;
+        }
+    }
+}
+
+// reads a line of a pipe or socket by looking at what is waiting in it first and then taking out exactly the bytes
+// up to the newline. a line longer than what was looked at is taken out in pieces
+int readPeekedRecord(int fd, int isSocket, struct LineBuffer *line)
+{
+    char buffer[READ_CHUNK];
+    size_t want = READ_PEEK_INITIAL;
+
+    for(;;)
+    {
+        ssize_t seen = peekInput(fd, isSocket, buffer, want);
+        if(seen == -2) return readByteRecord(fd, line);
+        if(seen <= 0) return (int) seen;
+        char *newline = memchr(buffer, '\n', (size_t) seen);
+        // with no newline in sight look further, unless that was all there is for now
+        if(!newline && (size_t) seen == want && want < READ_CHUNK)
+        {
+            want *= 2;
+            continue;
+        }
+        size_t taken = newline ? (size_t) (newline - buffer) + 1 : (size_t) seen;
+        for(size_t done = 0; done < taken; )
+        {
+            ssize_t got = read(fd, buffer + done, taken - done);
+            if(got == -1 && errno == EINTR) continue;
+            if(got <= 0) return (int) got;
+            done += (size_t) got;
+        }
+        appendLine(line, buffer, taken);
+        if(newline) return 1;
+        want = READ_PEEK_INITIAL;
+    }
+}
+
+// copies up to length bytes waiting in fd into buffer without consuming them, waiting for some to arrive. a socket is
+// peeked at with MSG_PEEK and a pipe is teed into readScratch and read back from there. returns 0 at end of file,
+// -1 on an error and -2 when fd can't be looked at this way
+ssize_t peekInput(int fd, int isSocket, char *buffer, size_t length)
+{
+    if(isSocket)
+    {
+        ssize_t seen = recv(fd, buffer, length, MSG_PEEK);
+        return seen == -1 && errno == ENOTSOCK ? -2 : seen;
+    }
+    if(readScratch[0] < 0)
+    {
+        if(pipe2(readScratch, O_CLOEXEC) == -1) return -2;
+        if(fcntl(readScratch[1], F_GETPIPE_SZ) < READ_CHUNK) fcntl(readScratch[1], F_SETPIPE_SZ, READ_CHUNK);
+    }
+    ssize_t teed = tee(fd, readScratch[1], length, 0);
+    if(teed == -1) return errno == EINVAL ? -2 : -1;
+    for(ssize_t done = 0; done < teed; )
+    {
+        ssize_t got = read(readScratch[0], buffer + done, (size_t) (teed - done));
+        if(got <= 0) return -1;
+        done += got;
+    }
+    return teed;
+}
+
+// reads a line one byte at a time, for input that can't be looked ahead in such as a terminal
+int readByteRecord(int fd, struct LineBuffer *line)
+{
+    char c;
+
+    for(;;)
+    {
+        ssize_t got = read(fd, &c, 1);
+        if(got == -1 && errno == EINTR) return -1;
+        if(got <= 0) return (int) got;
+        appendLine(line, &c, 1);
+        if(c == '\n') return 1;
+    }
+}
+
+// takes the next field for read out of *text. fields are separated by a character of ifs, any run of the whitespace
+// in ifs counting as one separator, and the rest field runs to the end with the whitespace around it dropped.
+// unless raw a backslash quotes the next character. returns the field as a new string
+char *nextReadField(char **text, char *ifs, int raw, int rest)
+{
+    struct LineBuffer field = {NULL, 0, 0};
+    char *p = *text;
+    size_t kept = 0; //length of the field up to its last quoted or non-whitespace character
+
+    appendLine(&field, "", 0);
+    while(*p && strchr(ifs, *p) && isspace((unsigned char) *p))
+        p++;
+    while(*p)
+    {
+        if(!raw && *p == '\\' && p[1])
+        {
+            appendLine(&field, p + 1, 1);
+            kept = field.length;
+            p += 2;
+            continue;
+        }
+        if(strchr(ifs, *p) && !rest) break;
+        appendLine(&field, p, 1);
+        if(!strchr(ifs, *p) || !isspace((unsigned char) *p)) kept = field.length;
+        p++;
+    }
+    if(*p)
+    {
+        // the separator, with the whitespace around it
+        while(*p && strchr(ifs, *p) && isspace((unsigned char) *p))
+            p++;
+        if(*p && strchr(ifs, *p)) p++;
+        while(*p && strchr(ifs, *p) && isspace((unsigned char) *p))
+            p++;
+    }
+    if(rest) field.text[field.length = kept] = '\0';
+    *text = p;
+    return field.text;
+}
+
+// built in queue command. 'queue [-p PRIORITY] command [arg...]' starts command in the background once fewer queued
+// jobs than the limit are running and the machine isn't loaded past the limits, higher priorities first.
+// -j JOBS, -l LOAD and -P PERCENT set the limits, 0 turning off the load and pressure ones. without a command the
+// limits are printed
+int yash_queue(char **args)
+{
+    int priority = 0;
+    int limit = queueLimit;
+    double maxLoad = queueMaxLoad;
+    double maxPressure = queueMaxPressure;
+    int i = 1;
+
+    for(; args[i] && args[i][0] == '-' && args[i][1]; i++)
+    {
+        char *end = NULL;
+        if(strcmp(args[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        char *value = args[i + 1];
+        double number = value ? strtod(value, &end) : 0;
+        char option = strlen(args[i]) == 2 ? args[i][1] : '\0';
+        if(!value || !strchr("pjlP", option) || end == value || *end != '\0' || (option != 'p' && number < 0))
+        {
+            fprintf(stderr, "yash: queue: usage: queue [-j JOBS] [-l LOAD] [-P PERCENT] [-p PRIORITY] "
+                            "[COMMAND [ARG ...]]\n");
+            lastStatus = 2;
+            return FINISHED_INPUT;
+        }
+        if(option == 'p')
+            priority = (int) number;
+        else if(option == 'j')
+            limit = (int) number;
+        else if(option == 'l')
+            maxLoad = number;
+        else
+            maxPressure = number;
+        i++;
+    }
+    int changed = limit != queueLimit || maxLoad != queueMaxLoad || maxPressure != queueMaxPressure;
+    queueLimit = limit;
+    queueMaxLoad = maxLoad;
+    queueMaxPressure = maxPressure;
+
+    if(args[i])
+    {
+        enqueueJob(args + i, priority);
+    } else if(!changed)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        printf("jobs %d  load %.2f  pressure %.1f%%  queued %d\n", queueLimit > 0 ? queueLimit : (int) processors,
+               queueMaxLoad < 0 ? (double) processors : queueMaxLoad, queueMaxPressure, queuedCount);
+    }
+    // a new job or looser limits may let something start now
+    admitQueued();
+    lastStatus = 0;
+    return FINISHED_INPUT;
+}
+
+// adds a copy of the command args to the queue, after every job of the same or a higher priority
+void enqueueJob(char **args, int priority)
+{
+    int count = countArgs(args);
+    size_t length = 1;
+    int at = queuedCount;
+
+    if(queuedCount == queuedCapacity)
+    {
+        queuedCapacity = queuedCapacity ? queuedCapacity * 2 : MAX_NUMBER_JOBS;
+        queuedJobs = realloc(queuedJobs, sizeof(struct QueuedJob) * queuedCapacity);
+    }
+    struct QueuedJob queued;
+    queued.args = malloc(sizeof(char *) * (count + 1));
+    for(int i=0; i<count; i++)
+        length += strlen(args[i]) + 1;
+    queued.line = malloc(length);
+    if(!queuedJobs || !queued.args || !queued.line)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    queued.line[0] = '\0';
+    for(int i=0; i<count; i++)
+    {
+        queued.args[i] = isOperatorWord(args[i]) ? args[i] : strdup(args[i]);
+        if(i > 0) strcat(queued.line, " ");
+        strcat(queued.line, args[i]);
+    }
+    queued.args[count] = NULL;
+    queued.priority = priority;
+
+    while(at > 0 && queuedJobs[at - 1].priority < priority)
+        at--;
+    memmove(&queuedJobs[at + 1], &queuedJobs[at], sizeof(struct QueuedJob) * (queuedCount - at));
+    queuedJobs[at] = queued;
+    queuedCount++;
+    return;
+}
+
+// starts queued jobs from the front while the limits allow. when only the load or pressure holds the queue back a
+// timer checks again later, since nothing else would. returns the number of jobs started
+int admitQueued(void)
+{
+    int limit = queueLimit > 0 ? queueLimit : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int running;
+    int started = 0;
+
+    if(queuedCount == 0 || (running = runningQueuedJobs()) >= limit) return 0;
+    if(queueOverloaded())
+    {
+        startQueueTimer();
+        return 0;
+    }
+    while(queuedCount > 0 && running + started < limit)
+    {
+        struct QueuedJob next = queuedJobs[0];
+        queuedCount--;
+        memmove(&queuedJobs[0], &queuedJobs[1], sizeof(struct QueuedJob) * queuedCount);
+        startQueuedJob(&next);
+        started++;
+    }
+    return started;
+}
+
+// starts a job taken off the queue as if it had been run with '&', leaving $?, $! and the foreground job alone.
+// frees its copy of the command
+void startQueuedJob(struct QueuedJob *queued)
+{
+    int savedStatus = lastStatus;
+    int savedBackgroundPid = lastBackgroundPid;
+    int savedForeground = pid_ch1;
+    int before = activeJobsSize;
+    int count = countArgs(queued->args);
+    // substitutions replace words of the array they're given, so the command gets an array of its own
+    char **args = malloc(sizeof(char *) * (count + 1));
+
+    if(!args)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(args, queued->args, sizeof(char *) * (count + 1));
+    addToJobs(&jobs, queued->line, pactiveJobsSize, &jobsCapacity);
+    startCommand(args, 1, pipeQty(args), pipeCapacity, pipeAdaptive);
+    // a command that couldn't be started has already left the table, one that failed to fork hasn't
+    if(activeJobsSize > before && jobs[activeJobsSize-1].procCount == 0)
+        removeLastFromJobs(jobs, pactiveJobsSize);
+    else if(activeJobsSize > before)
+        jobs[activeJobsSize-1].queued = 1;
+    lastStatus = savedStatus;
+    lastBackgroundPid = savedBackgroundPid;
+    pid_ch1 = savedForeground;
+
+    free(args);
+    for(int i=0; i<count; i++)
+        if(!isOperatorWord(queued->args[i])) free(queued->args[i]);
+    free(queued->args);
+    free(queued->line);
+    return;
+}
+
+// counts the jobs started by the queue that still have a process running
+int runningQueuedJobs(void)
+{
+    int running = 0;
+
+    for(int i=0; i<activeJobsSize; i++)
+    {
+        if(jobs[i].queued && !jobFinished(&jobs[i])) running++;
+    }
+    return running;
+}
+
+// returns 1 when the load average or the pressure stall information is past the queue's limits
+int queueOverloaded(void)
+{
+    double load;
+    double maxLoad = queueMaxLoad < 0 ? (double) sysconf(_SC_NPROCESSORS_ONLN) : queueMaxLoad;
+
+    if(maxLoad > 0 && getloadavg(&load, 1) == 1 && load > maxLoad) return 1;
+    if(queueMaxPressure > 0)
+    {
+        if(readPressure("/proc/pressure/cpu") > queueMaxPressure) return 1;
+        if(readPressure("/proc/pressure/io") > queueMaxPressure) return 1;
+        if(readPressure("/proc/pressure/memory") > queueMaxPressure) return 1;
+    }
+    return 0;
+}
+
+// reads the 'some avg10' percentage of a pressure stall information file, or -1 on a kernel without them
+double readPressure(char *path)
+{
+    char text[256];
+    double pressure = -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if(fd == -1) return -1;
+    ssize_t length = read(fd, text, sizeof(text) - 1);
+    close(fd);
+    if(length <= 0) return -1;
+    text[length] = '\0';
+    if(sscanf(text, "some avg10=%lf", &pressure) != 1) return -1;
+    return pressure;
+}
+
+// has the queue checked again in QUEUE_RECHECK_MS unless a check is already pending
+void startQueueTimer(void)
+{
+    if(queueTimer || openTimerFd() == -1) return;
+    queueTimer = malloc(sizeof(struct Timer));
+    if(!queueTimer)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    if(timerCount == 0) wheelTime = monotonicMs();
+    queueTimer->pid_no = 0;
+    queueTimer->deadline = monotonicMs() + QUEUE_RECHECK_MS;
+    queueTimer->signal = 0;
+    addTimer(queueTimer);
+    armTimerFd();
+    return;
+}
+
+// drops every queued job without starting it
+void clearQueue(void)
+{
+    for(int q=0; q<queuedCount; q++)
+    {
+        for(int i=0; queuedJobs[q].args[i]; i++)
+        {
+            if(!isOperatorWord(queuedJobs[q].args[i])) free(queuedJobs[q].args[i]);
+        }
+        free(queuedJobs[q].args);
+        free(queuedJobs[q].line);
+    }
+    free(queuedJobs);
+    queuedJobs = NULL;
+    queuedCount = 0;
+    queuedCapacity = 0;
+    return;
+}
+
+// built in enable command. enable -f LIBRARY NAME ... loads the built ins NAME from a shared library, enable -d NAME
+// ... drops loaded ones and with no arguments the loaded built ins are listed as the commands that would load them
+int yash_enable(char **args)
+{
+    char *option = args[1];
+
+    if(!option)
+    {
+        for(int i=0; i<loadedCount; i++)
+            printf("enable -f %s %s\n", loadedBuiltins[i].path, loadedBuiltins[i].name);
+        return FINISHED_INPUT;
+    }
+    if((strcmp(option, "-f") != 0 || !args[2] || !args[3]) && (strcmp(option, "-d") != 0 || !args[2]))
+    {
+        fprintf(stderr, "yash: enable: usage: enable [-f LIBRARY NAME ... | -d NAME ...]\n");
+        lastStatus = 2;
+        return FINISHED_INPUT;
+    }
+    int first = strcmp(option, "-f") == 0 ? 3 : 2;
+    for(int i=first; args[i]; i++)
+    {
+        if(first == 3 && loadBuiltin(args[2], args[i]) == -1)
+            lastStatus = 1;
+        else if(first == 2 && findLoadedBuiltin(args[i]))
+            unloadBuiltin(findLoadedBuiltin(args[i]) - loadedBuiltins);
+        else if(first == 2)
+        {
+            fprintf(stderr, "yash: enable: %s: not a loaded built in\n", args[i]);
+            lastStatus = 1;
+        }
+    }
+    return FINISHED_INPUT;
+}
+
+// loads the built in name from the shared library at path, looking for the struct YashBuiltin the library exports
+// as yash_builtin_NAME. a built in loaded under the same name before is replaced. returns -1 when it can't be loaded
+int loadBuiltin(char *path, char *name)
+{
+    if(isBuiltIn(name) && !findLoadedBuiltin(name))
+    {
+        fprintf(stderr, "yash: enable: %s: is a shell built in\n", name);
+        return -1;
+    }
+    // RTLD_NOW finds missing symbols here instead of in the middle of a command
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if(!handle)
+    {
+        fprintf(stderr, "yash: enable: %s\n", dlerror());
+        return -1;
+    }
+    char symbol[strlen(BUILTIN_SYMBOL_PREFIX) + strlen(name) + 1];
+    stpcpy(stpcpy(symbol, BUILTIN_SYMBOL_PREFIX), name);
+    struct YashBuiltin *builtin = dlsym(handle, symbol);
+    if(!builtin || !builtin->name || strcmp(builtin->name, name) != 0 || !builtin->run)
+    {
+        fprintf(stderr, "yash: enable: %s: no built in %s\n", path, name);
+        dlclose(handle);
+        return -1;
+    }
+    if(builtin->abi != YASH_BUILTIN_ABI)
+    {
+        fprintf(stderr, "yash: enable: %s: %s was built for interface %d, this shell has %d\n", path, name,
+                builtin->abi, YASH_BUILTIN_ABI);
+        dlclose(handle);
+        return -1;
+    }
+
+    struct LoadedBuiltin *previous = findLoadedBuiltin(name);
+    if(previous) unloadBuiltin(previous - loadedBuiltins);
+    if(loadedCount == loadedCapacity)
+    {
+        loadedCapacity = loadedCapacity ? loadedCapacity * 2 : LOADED_BUILTINS_INITIAL;
+        loadedBuiltins = realloc(loadedBuiltins, sizeof(struct LoadedBuiltin) * loadedCapacity);
+    }
+    struct LoadedBuiltin *loaded = &loadedBuiltins[loadedCount];
+    loaded->name = strdup(name);
+    loaded->path = strdup(path);
+    if(!loadedBuiltins || !loaded->name || !loaded->path)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    loaded->handle = handle;
+    loaded->builtin = builtin;
+    loadedCount++;
+    return 0;
+}
+
+// drops the loaded built in at index and closes its library
+void unloadBuiltin(int index)
+{
+    struct LoadedBuiltin *loaded = &loadedBuiltins[index];
+
+    free(loaded->name);
+    free(loaded->path);
+    dlclose(loaded->handle);
+    loadedCount--;
+    memmove(loaded, loaded + 1, sizeof(struct LoadedBuiltin) * (loadedCount - index));
+    return;
+}
+
+// returns the built in loaded under name, or NULL
+struct LoadedBuiltin *findLoadedBuiltin(char *name)
+{
+    for(int i=0; i<loadedCount; i++)
+    {
+        if(strcmp(loadedBuiltins[i].name, name) == 0) return &loadedBuiltins[i];
+    }
+    return NULL;
+}
+
+// runs a loaded built in in the shell process on its stdin, stdout and stderr. redirections among args are taken out
+// and applied around the call like a function's, so the built in gets the redirected descriptors. what the shell still
+// has buffered is written out first so the built in's output comes after it
+int runLoadedBuiltin(struct LoadedBuiltin *loaded, char **args)
+{
+    static const struct YashShell shell = {YASH_BUILTIN_ABI, pluginGetVar, pluginSetVar, pluginUnsetVar};
+    struct SavedFd saved[MAX_GROUP_REDIRS];
+    char *redirs[MAX_GROUP_REDIRS * 2 + 1];
+
+    int argCount = takeRedirections(args, redirs);
+    int savedFds = applyRedirections(redirs, saved);
+    if(savedFds == -1)
+    {
+        lastStatus = 1;
+        return FINISHED_INPUT;
+    }
+    fflush(stderr);
+    lastStatus = loaded->builtin->run(argCount, args, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, &shell) & 0xff;
+    restoreRedirections(saved, savedFds);
+    return FINISHED_INPUT;
+}
+
+// shell variable access given to loaded built ins
+const char *pluginGetVar(const char *name)
+{
+    return getVar((char *) name, strlen(name));
+}
+
+int pluginSetVar(const char *name, const char *value)
+{
+    if(!isValidName((char *) name, strlen(name))) return -1;
+    setVar((char *) name, (char *) value);
+    return 0;
+}
+
+int pluginUnsetVar(const char *name)
+{
+    if(!isValidName((char *) name, strlen(name))) return -1;
+    unsetVar((char *) name);
+    return 0;
+}
+
+// reads the options of a timeout prefix: timeout [-k DURATION] [-s SIGNAL] [--preserve-status] DURATION, where the
+// long options may also be written --kill-after=DURATION and --signal=SIGNAL. returns the index of the first word of
+// the command, -1 when a duration or signal is not valid, or 0 for any other option, which is left to the timeout
+// program
+int parseTimeout(char **args, int *timeoutMs, int *killAfterMs, int *signo, int *preserveStatus)
+{
+    int i = 1;
+
+    for(; args[i] && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        char *value = NULL;
+        if(strcmp(args[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        if(strcmp(args[i], "--preserve-status") == 0)
+        {
+            *preserveStatus = 1;
+            continue;
+        }
+        if(strcmp(args[i], "-k") == 0 || strcmp(args[i], "-s") == 0 || strcmp(args[i], "--kill-after") == 0 ||
+           strcmp(args[i], "--signal") == 0)
+        {
+            if(!args[i + 1]) return -1;
+            value = args[i + 1];
+        } else if(strncmp(args[i], "--kill-after=", 13) == 0 || strncmp(args[i], "--signal=", 9) == 0)
+            value = strchr(args[i], '=') + 1;
+        else
+            return 0;
+
+        if(args[i][1] == 'k' || strncmp(args[i], "--kill-after", 12) == 0)
+        {
+            if(parseDuration(value, killAfterMs) == -1) return -1;
+        } else if((*signo = parseSignal(value)) == -1)
+            return -1;
+        if(value == args[i + 1]) i++;
+    }
+    if(!args[i] || parseDuration(args[i], timeoutMs) == -1) return -1;
+    return i + 1;
+}
+
+// converts a signal given by number or by name, with or without SIG in front, to its number. returns -1 for an unknown
+// signal
+int parseSignal(char *text)
+{
+    static struct
+    {
+        char *name;
+        int signo;
+    } names[] = {{"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"ABRT", SIGABRT}, {"KILL", SIGKILL},
+                 {"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"PIPE", SIGPIPE}, {"ALRM", SIGALRM}, {"TERM", SIGTERM},
+                 {"CONT", SIGCONT}, {"STOP", SIGSTOP}, {"TSTP", SIGTSTP}, {"TTIN", SIGTTIN}, {"TTOU", SIGTTOU},
+                 {"WINCH", SIGWINCH}};
+    char *end;
+    long number = strtol(text, &end, 10);
+
+    if(end != text && *end == '\0') return number > 0 && number < NSIG ? (int) number : -1;
+    if(strncmp(text, "SIG", 3) == 0) text += 3;
+    for(size_t n=0; n<sizeof(names)/sizeof(names[0]); n++)
+    {
+        if(strcmp(text, names[n].name) == 0) return names[n].signo;
+    }
+    return -1;
+}
+
+// converts a duration in seconds, which may have a fraction and an s, m, h or d suffix, to milliseconds. returns -1
+// when it isn't valid
+int parseDuration(char *text, int *ms)
+{
+    char *end;
+    double value = strtod(text, &end);
+
+    if(end == text || value < 0) return -1;
+    switch(*end)
+    {
+        case 'd':
+            value *= 24;
+            // fall through
+        case 'h':
+            value *= 60;
+            // fall through
+        case 'm':
+            value *= 60;
+            // fall through
+        case 's':
+            end++;
+            break;
+    }
+    if(*end != '\0' || value * 1000 > INT_MAX) return -1;
+    *ms = (int) (value * 1000);
+    return 0;
+}
+
+// returns the time on CLOCK_MONOTONIC in milliseconds
+long long monotonicMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+// starts the time limit of a job whose first process was just started. the timerfd is made on first use and added to
+// the jobs epoll set, so the timers of every job share it
+void startJobTimer(struct Job *job)
+{
+    if(openTimerFd() == -1) return;
+    struct Timer *timer = malloc(sizeof(struct Timer));
+    if(!timer)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    if(timerCount == 0) wheelTime = monotonicMs();
+    timer->pid_no = job->pid_no;
+    timer->deadline = monotonicMs() + job->timeoutMs;
+    timer->signal = job->timeoutSignal;
+    job->timer = timer;
+    addTimer(timer);
+    armTimerFd();
+    return;
+}
+
+// makes the timerfd on first use and adds it to the jobs epoll set. returns -1 if it can't be made
+int openTimerFd(void)
+{
+    if(timerFd >= 0) return 0;
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(timerFd < 0)
+    {
+        perror("timeout");
+        return -1;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = TIMER_EPOLL_KEY;
+    epoll_ctl(jobsEpollFd, EPOLL_CTL_ADD, timerFd, &event);
+    return 0;
+}
+
+// puts a timer in the wheel slot of the tick its deadline falls on. deadlines more than a turn of the wheel away share
+// the slot with nearer ones and are skipped until their turn comes
+void addTimer(struct Timer *timer)
+{
+    int slot = (int) ((timer->deadline / TIMER_TICK_MS) % TIMER_WHEEL_SLOTS);
+
+    timer->next = timerWheel[slot];
+    timerWheel[slot] = timer;
+    timerCount++;
+    return;
+}
+
+// takes a pending timer out of the wheel and frees it
+void cancelTimer(struct Timer *timer)
+{
+    struct Timer **link = &timerWheel[(timer->deadline / TIMER_TICK_MS) % TIMER_WHEEL_SLOTS];
+
+    while(*link && *link != timer)
+        link = &(*link)->next;
+    if(*link)
+    {
+        *link = timer->next;
+        timerCount--;
+    }
+    free(timer);
+    return;
+}
+
+// called when the timerfd is readable. advances the wheel to the current time, firing the timers of every slot passed
+// whose deadline has come, then arms the timerfd for the next slot holding one
+void runTimers(void)
+{
+    uint64_t expirations;
+    long long now = monotonicMs();
+    long long tick = wheelTime / TIMER_TICK_MS;
+    long long lastTick = now / TIMER_TICK_MS;
+
+    if(read(timerFd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) perror("timeout");
+    // past a whole turn every slot has been visited once
+    if(lastTick - tick >= TIMER_WHEEL_SLOTS) tick = lastTick - TIMER_WHEEL_SLOTS + 1;
+    for(; tick <= lastTick; tick++)
+    {
+        struct Timer **link = &timerWheel[tick % TIMER_WHEEL_SLOTS];
+        while(*link)
+        {
+            struct Timer *timer = *link;
+            if(timer->deadline > now)
+            {
+                link = &timer->next;
+                continue;
+            }
+            *link = timer->next;
+            timerCount--;
+            fireTimer(timer);
+        }
+    }
+    wheelTime = now;
+    armTimerFd();
+    // started after the walk, as starting a job can add timers
+    if(queueDue)
+    {
+        queueDue = 0;
+        admitQueued();
+    }
+    return;
+}
+
+// acts on a timer whose deadline has come: the job it limits gets SIGTERM and a second timer for SIGKILL, or SIGKILL
+// when that one runs out too. the queue timer has the queue checked again once the walk is over
+void fireTimer(struct Timer *timer)
+{
+    if(timer == queueTimer)
+    {
+        queueTimer = NULL;
+        queueDue = 1;
+        free(timer);
+        return;
+    }
+    int i = findJob(jobs, timer->pid_no, activeJobsSize);
+
+    if(i < 0)
+    {
+        free(timer);
+        return;
+    }
+    struct Job *job = &jobs[i];
+    int first = !job->timedOut;
+    signalJob(job, timer->signal);
+    job->timedOut = 1;
+    if(first) publishJobs();
+    if(!first || timer->signal == SIGKILL)
+    {
+        job->timer = NULL;
+        free(timer);
+        return;
+    }
+    // a stopped job has to run to act on SIGTERM
+    signalJob(job, SIGCONT);
+    timer->signal = SIGKILL;
+    timer->deadline = monotonicMs() + job->killAfterMs;
+    addTimer(timer);
+    return;
+}
+
+// sends a signal to the whole process group of a job, which a timed job always has, so processes its commands started
+// are reached as well. the processes of a job that somehow ended up in the shell's group are signalled one at a time
+// instead, as the shell mustn't signal itself
+void signalJob(struct Job *job, int signo)
+{
+    if(job->pgid > 0 && job->pgid != getpgrp())
+    {
+        kill(-job->pgid, signo);
+        return;
+    }
+    for(int p=0; p<job->procCount; p++)
+    {
+        if(!job->procs[p].done) kill(job->procs[p].pid, signo);
+    }
+    return;
+}
+
+// arms the timerfd for the earliest deadline in the next turn of the wheel, a turn ahead when they are all further
+// away, or disarms it when there are no timers
+void armTimerFd(void)
+{
+    struct itimerspec spec;
+    long long next = 0;
+
+    memset(&spec, 0, sizeof(spec));
+    if(timerFd < 0) return;
+    if(timerCount > 0)
+    {
+        long long tick = wheelTime / TIMER_TICK_MS;
+        next = (tick + TIMER_WHEEL_SLOTS) * TIMER_TICK_MS;
+        for(int s=0; s<TIMER_WHEEL_SLOTS && next == (tick + TIMER_WHEEL_SLOTS) * TIMER_TICK_MS; s++)
+        {
+            for(struct Timer *timer = timerWheel[(tick + s) % TIMER_WHEEL_SLOTS]; timer; timer = timer->next)
+            {
+                if(timer->deadline < next) next = timer->deadline;
+            }
+        }
+        // a deadline already passed still needs a non zero time or the timerfd would be disarmed
+        if(next <= wheelTime) next = wheelTime + 1;
+        long long delay = next - monotonicMs();
+        if(delay < 1) delay = 1;
+        spec.it_value.tv_sec = delay / 1000;
+        spec.it_value.tv_nsec = (delay % 1000) * 1000000;
+    }
+    timerfd_settime(timerFd, 0, &spec, NULL);
+    return;
+}
+
+// drops every timer and the timerfd, for a forked child whose jobs are not the shell's
+void clearTimers(void)
+{
+    for(int s=0; s<TIMER_WHEEL_SLOTS; s++)
+    {
+        while(timerWheel[s])
+        {
+            struct Timer *timer = timerWheel[s];
+            timerWheel[s] = timer->next;
+            free(timer);
+        }
+    }
+    timerCount = 0;
+    queueTimer = NULL;
+    queueDue = 0;
+    if(timerFd >= 0) close(timerFd);
+    timerFd = -1;
+    return;
+}
+
+// creates the shared memory object name for the job board and maps it. the shell is the only writer; readers map
+// it read only and never have to call into the shell. an object already there is only replaced when it is the board
+// of a shell that is gone, never another shell's live board. returns -1 if the object can't be created
+int openJobBoard(char *name)
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+    if(fd == -1 && errno == EEXIST && isStaleJobBoard(name))
+    {
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    }
+    if(fd == -1 && errno == EEXIST)
+    {
+        fprintf(stderr, "yash: %s: in use by another shell or not a job board\n", name);
+        return -1;
+    }
+    if(fd == -1 || ftruncate(fd, sizeof(struct JobBoard)) == -1)
+    {
+        perror(name);
+        if(fd >= 0)
+        {
+            close(fd);
+            shm_unlink(name);
+        }
+        return -1;
+    }
+    jobBoard = mmap(NULL, sizeof(struct JobBoard), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(jobBoard == MAP_FAILED)
+    {
+        perror(name);
+        jobBoard = NULL;
+        shm_unlink(name);
+        return -1;
+    }
+    jobBoardName = name;
+    jobBoardOwner = getpid();
+    jobBoard->version = BOARD_VERSION;
+    jobBoard->shellPid = jobBoardOwner;
+    // the magic goes in last so a reader that sees it sees a whole header
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(jobBoard->magic, BOARD_MAGIC, sizeof(jobBoard->magic));
+    publishJobs();
+    return 0;
+}
+
+// returns 1 if the shared memory object name is a job board left behind by a shell that is no longer running
+int isStaleJobBoard(char *name)
+{
+    struct stat info;
+    int stale = 0;
+    int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+
+    if(fd == -1) return 0;
+    if(fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(struct JobBoard))
+    {
+        struct JobBoard *board = mmap(NULL, sizeof(struct JobBoard), PROT_READ, MAP_SHARED, fd, 0);
+        if(board != MAP_FAILED)
+        {
+            stale = memcmp(board->magic, BOARD_MAGIC, sizeof(board->magic)) == 0 && board->shellPid > 0 &&
+                    kill(board->shellPid, 0) == -1 && errno == ESRCH;
+            munmap(board, sizeof(struct JobBoard));
+        }
+    }
+    close(fd);
+    return stale;
+}
+
+// removes the job board before the shell exits or replaces itself. a shell killed by a signal leaves the object
+// behind, which readers tell from shellPid no longer running
+void closeJobBoard(void)
+{
+    if(!jobBoard || getpid() != jobBoardOwner) return;
+    munmap(jobBoard, sizeof(struct JobBoard));
+    shm_unlink(jobBoardName);
+    jobBoard = NULL;
+    return;
+}
+
+// copies the jobs table to the job board after a job changed. the sequence is made odd before the first write and
+// even again after the last, so a reader that saw the same even sequence before and after its copy has a consistent
+// snapshot. the shell never waits on readers
+void publishJobs(void)
+{
+    if(!jobBoard || getpid() != jobBoardOwner) return;
+
+    uint32_t sequence = jobBoard->sequence;
+    int count = activeJobsSize < BOARD_SLOTS ? activeJobsSize : BOARD_SLOTS;
+
+    __atomic_store_n(&jobBoard->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for(int i=0; i<count; i++)
+    {
+        struct BoardSlot *slot = &jobBoard->slots[i];
+        struct Job *job = &jobs[i];
+
+        slot->pid = job->pid_no;
+        slot->pgid = job->pgid;
+        slot->task_no = job->task_no;
+        if(job->timedOut)
+            slot->state = BOARD_TIMED_OUT;
+        else if(jobFinished(job))
+            slot->state = BOARD_DONE;
+        else
+            // a job whose first process is still being started is published as running, not as never started
+            slot->state = job->runningStatus || job->procCount == 0 ? BOARD_RUNNING : BOARD_STOPPED;
+        slot->startedNs = job->startedNs;
+        slot->procCount = job->procCount;
+        for(int p=0; p<job->procCount && p<BOARD_PROCS; p++)
+            slot->pids[p] = job->procs[p].pid;
+        snprintf(slot->line, sizeof(slot->line), "%s", job->line ? job->line : "");
+    }
+    jobBoard->count = count;
+    jobBoard->total = activeJobsSize;
+    __atomic_store_n(&jobBoard->sequence, sequence + 2, __ATOMIC_RELEASE);
+    return;
+}
+
+// waits for a foreground process to exit or stop like waitProcess. while any job has a time limit the shell sleeps on
+// the process's pidfd and the timerfd together so the limits run out on time, with SIGCHLD unblocked only during the
+// sleep to catch the process stopping
+int waitJobProcess(struct Process *proc, int *status)
+{
+    if(timerCount == 0 || proc->pidfd < 0) return waitProcess(proc, 0, status);
+
+    sigset_t blocked, saved, unblocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &blocked, &saved);
+    unblocked = saved;
+    sigdelset(&unblocked, SIGCHLD);
+
+    int result;
+    while((result = waitProcess(proc, WNOHANG | WUNTRACED, status)) == 0)
+    {
+        struct pollfd fds[2] = {{proc->pidfd, POLLIN, 0}, {timerFd, POLLIN, 0}};
+        if(ppoll(fds, 2, NULL, &unblocked) > 0 && (fds[1].revents & POLLIN)) runTimers();
+    }
+    sigprocmask(SIG_SETMASK, &saved, NULL);
+    return result;
+}
+
+// adds a started process to the most recent job and gives the job a 'running' status. the first process started
+// gives the job its pid number and starts its time limit. each process gets a pidfd in the epoll set so it can be
+// waited on individually
+void startJobsPID(struct Job *jobs, int pid, int activeJobsSize)
+{
+    struct Job *job = &jobs[activeJobsSize-1];
+
+    if(job->procCount == 0)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        job->pid_no = pid;
+        job->startedNs = (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+        if(jobBoard || job->timeoutMs > 0) job->pgid = getpgid(pid);
+        if(job->timeoutMs > 0) startJobTimer(job);
+    }
+    job->runningStatus = RUNNING;
+    job->procs = realloc(job->procs, sizeof(struct Process) * (job->procCount + 1));
+    if(!job->procs)
+    {
+        fprintf(stderr, "jobs table allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct Process *proc = &job->procs[job->procCount++];
+    proc->pid = pid;
+    proc->done = 0;
+    proc->status = 0;
+    proc->auxiliary = 0;
+    proc->pidfd = (int) syscall(SYS_pidfd_open, pid, 0);
+    if(proc->pidfd >= 0)
+    {
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = (uint64_t) pid;
+        if(epoll_ctl(jobsEpollFd, EPOLL_CTL_ADD, proc->pidfd, &event) == -1)
+        {
+            close(proc->pidfd);
+            proc->pidfd = -1;
+        }
+    }
+    publishJobs();
+    return;
+}
+
+// removes a job by pid number from the jobs table. should be used when a job is finished or killed.
+void removeFromJobs(struct Job *jobs, int pid, int *activeJobsSize)
+{
+    for(int i=0; i<*activeJobsSize; i++)
+    {
+        if((jobs[i].pid_no == pid))
+        {
+            free(jobs[i].line);
+            for(int p=0; p<jobs[i].procCount; p++)
+            {
+                struct Process *proc = &jobs[i].procs[p];
+                int status;
+                if(proc->done) continue;
+                // reap a process that has already exited while its pidfd can still name it, or it stays a zombie
+                if(waitProcess(proc, WNOHANG, &status) <= 0 || WIFSTOPPED(status)) status = 0;
+                finishProcess(proc, status);
+            }
+            free(jobs[i].procs);
+            if(jobs[i].timer) cancelTimer(jobs[i].timer);
+            for(int j=i; j<(*activeJobsSize-1); j++)
+                jobs[j] = jobs[j+1];
+            jobs[*activeJobsSize-1].pid_no = 0;
+            jobs[*activeJobsSize-1].runningStatus = STOPPED;
+            jobs[*activeJobsSize-1].task_no = 0;
+            jobs[*activeJobsSize-1].line = NULL;
+            jobs[*activeJobsSize-1].procs = NULL;
+            jobs[*activeJobsSize-1].procCount = 0;
+            jobs[*activeJobsSize-1].timer = NULL;
+            (*activeJobsSize)--;
+            publishJobs();
+            return;
+        }
+    }
+    return;
+}
+
+// changes the status of a job in the jobs table in the event that it is stopped or restarted
+void setJobStatus(struct Job *jobs, int pid, int activeJobsSize, int runningStatus)
+{
+    for(int i=0; i<activeJobsSize; i++)
+    {
+        if(jobs[i].pid_no == pid) jobs[i].runningStatus = runningStatus;
+    }
+    publishJobs();
+    return;
+}
+
+// kills all process in the jobs table in the event that the shell is killed with ctrl + d
+void killProcs(struct Job *jobs, int *activeJobsSize)
+{
+    while(*activeJobsSize > 0)
+    {
+        if(jobs[0].pid_no > 0)
+        {
+            kill(-jobs[0].pid_no, SIGINT);
+            kill(jobs[0].pid_no, SIGINT);
+        }
+        removeFromJobs(jobs, jobs[0].pid_no, activeJobsSize);
+    }
+}
+
+// removes the most recent job from the jobs table in the event that the job was put in the table but killed before
+// the pid no was assigned
+void removeLastFromJobs(struct Job *jobs, int *activeJobsSize)
+{
+    free(jobs[*activeJobsSize-1].line);
+    free(jobs[*activeJobsSize-1].procs);
+    if(jobs[*activeJobsSize-1].timer) cancelTimer(jobs[*activeJobsSize-1].timer);
+    jobs[*activeJobsSize-1].procs = NULL;
+    jobs[*activeJobsSize-1].procCount = 0;
+    jobs[*activeJobsSize-1].timer = NULL;
+    jobs[*activeJobsSize-1].pid_no = 0;
+    jobs[*activeJobsSize-1].runningStatus = STOPPED;
+    jobs[*activeJobsSize-1].task_no = 0;
+    jobs[*activeJobsSize-1].line = NULL;
+
+    (*activeJobsSize)--;
+    publishJobs();
+    return;
+}
+
+// checks if input arguments have a '<' symbol and returns the index of the symbol in the args array
+int containsInRedir(char **args)
+{
+    int symbolPos = -1; // return -1 if '<' is not in args
+    int argCount = countArgs(args);
+
+    for(int i=0; i<argCount; i++)
+    {
+        if(isOperator(args[i], OPERATOR_IN))
+            symbolPos = i;
+    }
+
+    return symbolPos;
+}
+
+// checks if input arguments have a '>' symbol and returns the index of the symbol in the args array
+int containsOutRedir(char **args)
+{
+    int symbolPos = -1; // return -1 if '<' is not in args
+    int argCount = countArgs(args);
+
+    for(int i=0; i<argCount; i++)
+    {
+        if(isOperator(args[i], OPERATOR_OUT))
+            symbolPos = i;
+    }
+
+    return symbolPos;
+}
+
+// removes the redirect argument and the next argument in the array. assumes the next argument is the name of the file
+// any additional input in the args command will not be recognized by path command
+void removeRedirArgs(char **args, int redirIndex)
+{
+    args[redirIndex] = NULL;
+    args[redirIndex + 1] = NULL;
+    return;
+}
+
+// set stdout to go to file specified by the writeFilePointer. when args has more than one '>' the output goes to every
+// file named, duplicated by a fan-out process
+int setRedirOut(char **args, int redirOut, FILE *writeFilePointer, int argCount)
+{
+    int targets = 0;
+    for(int i=0; i<argCount; i++)
+    {
+        if(args[i] && isOperator(args[i], OPERATOR_OUT)) targets++;
+    }
+    if(targets > 1)
+        return setMultiRedirOut(args, argCount, targets);
+
+    if (redirOut + 1 < argCount)
+    {
+        writeFilePointer = fopen(args[redirOut + 1], "w+");
+        if (writeFilePointer)
+        {
+            dup2(fileno(writeFilePointer), STDOUT_FILENO);
+            removeRedirArgs(args, redirOut);
+        } else
+        {
+            fprintf(stderr, "Cannot open file %s\n", args[redirOut + 1]);
+            return -1; // return -1 as error value
+        }
+    } else
+    {
+        fprintf(stderr, "Invalid Expression\n");
+        return -1; // return -1 as error value
+    }
+
+    return 1; // Finished without error
+}
+
+// opens every file following a '>' in args and starts a fan-out process copying stdout into all of them
+int setMultiRedirOut(char **args, int argCount, int targets)
+{
+    int outputs[targets];
+    int count = 0;
+
+    for(int i=0; i<argCount; i++)
+    {
+        if(!args[i] || !isOperator(args[i], OPERATOR_OUT)) continue;
+        if(i + 1 >= argCount)
+        {
+            fprintf(stderr, "Invalid Expression\n");
+            return -1;
+        }
+        outputs[count] = open(args[i + 1], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if(outputs[count] == -1)
+        {
+            fprintf(stderr, "Cannot open file %s\n", args[i + 1]);
+            return -1;
+        }
+        count++;
+    }
+    for(int i=argCount-1; i>=0; i--)
+    {
+        if(args[i] && isOperator(args[i], OPERATOR_OUT)) removeRedirArgs(args, i);
+    }
+    startFanOut(outputs, count);
+    return 1;
+}
+
+int setRedirIn(char **args, int redirIn, FILE *readFilePointer, int argCount)
+{
+    if (redirIn + 1 < argCount)
+    {
+        readFilePointer = fopen(args[redirIn + 1], "r");
+        if (readFilePointer)
+        {
+            dup2(fileno(readFilePointer), STDIN_FILENO);
+            removeRedirArgs(args, redirIn);
+        } else
+        {
+            fprintf(stderr, "Cannot open file %s\n", args[redirIn + 1]);
+            return -1;
+        }
+    } else
+    {
+        fprintf(stderr, "Invalid Expression\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+// starts producer |+ consumer |+ consumer ..., where every consumer reads its own copy of the producer's output. a
+// fan-out process between them duplicates the data with tee and splice. the job waits for all of them and its status
+// is the last consumer's
+int startFanOutOperation(char **args, int fanOuts, int capacity)
+{
+    char **segments[fanOuts + 1];
+    int sinks[fanOuts][2];
+    int source[2];
+    int pids[fanOuts + 2];
+    int count = 0;
+
+    // cut args into the producer and consumers at each |+
+    segments[0] = args;
+    for(int i=0, s=1; args[i]; i++)
+    {
+        if(!isOperator(args[i], OPERATOR_FAN_OUT)) continue;
+        args[i] = NULL;
+        segments[s++] = &args[i + 1];
+    }
+    for(int s=0; s<=fanOuts; s++)
+    {
+        if(!segments[s][0])
+        {
+            fprintf(stderr, "Invalid Expression\n");
+            removeLastFromJobs(jobs, pactiveJobsSize);
+            lastStatus = 1;
+            return FINISHED_INPUT;
+        }
+    }
+
+    if(pipe2(source, O_CLOEXEC) == -1)
+    {
+        perror("pipe");
+        removeLastFromJobs(jobs, pactiveJobsSize);
+        lastStatus = 1;
+        return FINISHED_INPUT;
+    }
+    for(int s=0; s<fanOuts; s++)
+    {
+        if(pipe2(sinks[s], O_CLOEXEC) == -1)
+        {
+            perror("pipe");
+            sinks[s][0] = sinks[s][1] = -1;
+        } else if(capacity > 0)
+            setPipeCapacity(sinks[s][0], capacity);
+    }
+    if(capacity > 0) setPipeCapacity(source[0], capacity);
+
+    // the producer, then the fan-out process, then each consumer. the producer's pid names the job
+    fflush(stdout);
+    for(int stage=0; stage<fanOuts + 2; stage++)
+    {
+        int child = fork();
+        if(child == 0)
+        {
+            enterJobGroup(0);
+            if(stage == 0)
+            {
+                dup2(source[1], STDOUT_FILENO);
+                execSegment(segments[0]);
+            } else if(stage == 1)
+            {
+                int outputs[fanOuts];
+                close(source[1]);
+                for(int s=0; s<fanOuts; s++)
+                {
+                    close(sinks[s][0]);
+                    outputs[s] = sinks[s][1];
+                }
+                fanOut(source[0], outputs, fanOuts);
+                _exit(0);
+            } else
+            {
+                dup2(sinks[stage - 2][0], STDIN_FILENO);
+                execSegment(segments[stage - 1]);
+            }
+        } else if(child < 0)
+        {
+            perror("error forking");
+            break;
+        }
+        enterJobGroup(child);
+        pids[count++] = child;
+        startJobsPID(jobs, child, activeJobsSize);
+    }
+
+    close(source[0]);
+    close(source[1]);
+    for(int s=0; s<fanOuts; s++)
+    {
+        close(sinks[s][0]);
+        close(sinks[s][1]);
+    }
+    if(count == 0)
+    {
+        removeLastFromJobs(jobs, pactiveJobsSize);
+        lastStatus = 1;
+        return FINISHED_INPUT;
+    }
+    launchSubstitutions(jobGroup > 0 ? jobGroup : 0);
+    pid_ch1 = pids[0];
+    waitForJob(jobs, pids[0], pactiveJobsSize);
+    return FINISHED_INPUT;
+}
+
+// applies the redirections of one command of a fan-out in its forked child and runs it. never returns
+void execSegment(char **args)
+{
+    int argCount = countArgs(args);
+    int redirIn = containsInRedir(args);
+    int redirOut = containsOutRedir(args);
+
+    if(redirOut >= 0 && setRedirOut(args, redirOut, NULL, argCount) == -1)
+        _exit(EXIT_FAILURE);
+    if(redirIn >= 0 && setRedirIn(args, redirIn, NULL, argCount) == -1)
+        _exit(EXIT_FAILURE);
+    if(execCommand(args) == -1)
+        perror("Problem executing command");
+    _Exit(EXIT_FAILURE);
+}
+
+// returns the number of |+ operators in args
+int fanOutQty(char **args)
+{
+    int fanOuts = 0;
+
+    for(int i=0; args[i]; i++)
+    {
+        if(isOperator(args[i], OPERATOR_FAN_OUT)) fanOuts++;
+    }
+    return fanOuts;
+}
+
+// makes stdout of the calling process a pipe whose data is copied into every one of outputs. the process is split in
+// two: the child returns and carries on with stdout on the pipe, the parent stays behind to do the copying and then
+// exits with the child's status, so a job waiting on it sees the command finish only once every output is written
+void startFanOut(int *outputs, int count)
+{
+    int pfd[2];
+
+    fflush(stdout);
+    if(pipe2(pfd, O_CLOEXEC) == -1)
+    {
+        perror("pipe");
+        _exit(EXIT_FAILURE);
+    }
+    int child = fork();
+    if(child == 0)
+    {
+        dup2(pfd[1], STDOUT_FILENO);
+        close(pfd[0]);
+        close(pfd[1]);
+        for(int i=0; i<count; i++)
+            close(outputs[i]);
+        return;
+    } else if(child < 0)
+    {
+        perror("error forking");
+        _exit(EXIT_FAILURE);
+    }
+
+    int status;
+    close(pfd[1]);
+    fanOut(pfd[0], outputs, count);
+    while(waitpid(child, &status, 0) == -1 && errno == EINTR);
+    _exit(statusToExitCode(status));
+}
+
+// copies everything read from the pipe input into each of outputs until end of file. the data is duplicated inside
+// the kernel: every output but the last takes a copy with tee, the bytes copied are then moved along to the next
+// stage with splice, and the last output gets them moved in by splice. a file output is fed through a pipe of its own
+// since tee only writes to pipes. outputs that splice can't write to fall back to read and write
+void fanOut(int input, int *outputs, int count)
+{
+    int capacity = fcntl(input, F_GETPIPE_SZ);
+    int ins[count];         //pipe each stage reads from
+    int chains[count][2];   //pipe from each stage to the next
+    int privates[count][2]; //pipe a file output is teed into, -1 for a pipe output
+    int stages = 0;
+
+    for(int i=0; i<count; i++)
+    {
+        struct stat st;
+        if(fstat(outputs[i], &st) == -1 || (!S_ISFIFO(st.st_mode) && !S_ISREG(st.st_mode)))
+        {
+            copyFanOut(input, outputs, count);
+            return;
+        }
+    }
+
+    ins[0] = input;
+    for(int i=0; i<count - 1; i++)
+    {
+        struct stat st;
+        privates[i][0] = privates[i][1] = -1;
+        fstat(outputs[i], &st);
+        // every pipe is at least as large as the input so one stage's data always fits in the next
+        if(pipe2(chains[i], O_CLOEXEC) == -1 ||
+           (!S_ISFIFO(st.st_mode) && pipe2(privates[i], O_CLOEXEC) == -1))
+            break;
+        if(capacity > 0) setPipeCapacity(chains[i][0], capacity);
+        if(capacity > 0 && privates[i][0] >= 0) setPipeCapacity(privates[i][0], capacity);
+        ins[i + 1] = chains[i][0];
+        stages++;
+    }
+    if(stages < count - 1)
+    {
+        copyFanOut(input, outputs, count);
+        return;
+    }
+
+    while(1)
+    {
+        ssize_t chunk;
+        if(count == 1)
+        {
+            chunk = splice(input, NULL, outputs[0], NULL, capacity > 0 ? capacity : PIPE_BUF, SPLICE_F_MOVE);
+            if(chunk == -1 && errno == EINTR) continue;
+            if(chunk <= 0) break;
+            continue;
+        }
+
+        // the first stage takes whatever the producer has written, every later stage passes on exactly that much
+        chunk = tee(input, privates[0][1] >= 0 ? privates[0][1] : outputs[0], capacity > 0 ? capacity : PIPE_BUF, 0);
+        if(chunk == -1 && errno == EINTR) continue;
+        if(chunk <= 0) break;
+        if(teeStage(0, chunk, chunk, ins, chains, privates, outputs) == -1) break;
+        for(int i=1; i<count - 1; i++)
+        {
+            if(teeStage(i, chunk, 0, ins, chains, privates, outputs) == -1) return;
+        }
+        if(spliceAll(ins[count - 1], outputs[count - 1], chunk) == -1) break;
+    }
+    return;
+}
+
+// runs one tee stage of fanOut for chunk bytes, of which teed have already been teed into the stage's output. the
+// bytes are teed into the output a piece at a time as it has room, each piece moved on to the next stage's pipe
+int teeStage(int i, ssize_t chunk, ssize_t teed, int *ins, int (*chains)[2], int (*privates)[2], int *outputs)
+{
+    int target = privates[i][1] >= 0 ? privates[i][1] : outputs[i];
+
+    while(chunk > 0)
+    {
+        ssize_t got = teed;
+        teed = 0;
+        if(got == 0)
+        {
+            got = tee(ins[i], target, chunk, 0);
+            if(got == -1 && errno == EINTR) continue;
+            if(got <= 0) return -1;
+        }
+        if(privates[i][0] >= 0 && spliceAll(privates[i][0], outputs[i], got) == -1) return -1;
+        if(spliceAll(ins[i], chains[i][1], got) == -1) return -1;
+        chunk -= got;
+    }
+    return 0;
+}
+
+// moves exactly length bytes from the pipe in to out with splice. returns -1 on an error or early end of file
+int spliceAll(int in, int out, ssize_t length)
+{
+    while(length > 0)
+    {
+        ssize_t moved = splice(in, NULL, out, NULL, length, SPLICE_F_MOVE);
+        if(moved == -1 && errno == EINTR) continue;
+        if(moved <= 0) return -1;
+        length -= moved;
+    }
+    return 0;
+}
+
+// the plain version of fanOut for outputs splice can't write to, such as a terminal
+void copyFanOut(int input, int *outputs, int count)
+{
+    char buffer[PIPE_BUF * 16];
+    ssize_t got;
+
+    while((got = read(input, buffer, sizeof(buffer))) != 0)
+    {
+        if(got == -1)
+        {
+            if(errno == EINTR) continue;
+            return;
+        }
+        for(int i=0; i<count; i++)
+        {
+            for(ssize_t done = 0; done < got; )
+            {
+                ssize_t written = write(outputs[i], buffer + done, got - done);
+                if(written == -1 && errno == EINTR) continue;
+                if(written <= 0) return;
+                done += written;
+            }
+        }
+    }
+    return;
+}
+
+// returns 1 when word is a whole <(cmd) or >(cmd) process substitution
+int isSubstitution(char *word)
+{
+    if((word[0] != '<' && word[0] != '>') || word[1] != '(') return 0;
+    char *close = skipBracketed(word + 1);
+    return close && close[1] == '\0';
+}
+
+// returns 1 when one of the words in args is a process substitution
+int hasSubstitution(char **args)
+{
+    for(int i=0; args[i]; i++)
+    {
+        if(isSubstitution(args[i])) return 1;
+    }
+    return 0;
+}
+
+// makes a pipe for every <(cmd) and >(cmd) word in args and replaces the word with the /dev/fd path of the end the
+// command uses: the read end for <(cmd), the write end for >(cmd). the processes are started by launchSubstitutions
+// once the command is running. returns -1 when a pipe can't be made
+int prepareSubstitutions(char **args)
+{
+    for(int i=0; args[i]; i++)
+    {
+        if(!isSubstitution(args[i])) continue;
+        struct Substitution *substitution = realloc(substitutions,
+                                                    sizeof(struct Substitution) * (substitutionCount + 1));
+        int pfd[2];
+        if(!substitution)
+        {
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        substitutions = substitution;
+        if(pipe2(pfd, O_CLOEXEC) == -1)
+        {
+            perror("pipe");
+            return -1;
+        }
+        substitution = &substitutions[substitutionCount++];
+        substitution->output = args[i][0] == '>';
+        substitution->fd = substitution->output ? pfd[1] : pfd[0];
+        substitution->other = substitution->output ? pfd[0] : pfd[1];
+        substitution->text = strndup(args[i] + 2, strlen(args[i]) - 3);
+        fcntl(substitution->fd, F_SETFD, 0);
+        substitution->path = malloc(32);
+        snprintf(substitution->path, 32, "/dev/fd/%d", substitution->fd);
+        args[i] = substitution->path;
+    }
+    return 0;
+}
+
+// puts a process just forked for the foreground job being started in the job's own group, when it gets one. the
+// child calls it with pid 0 and the parent with the child's pid, so the group exists whichever of them runs first.
+// the first process leads the group and the group gets the terminal
+void enterJobGroup(pid_t pid)
+{
+    if(jobGroup < 0) return;
+    pid_t group = jobGroup > 0 ? jobGroup : pid > 0 ? pid : getpid();
+    setpgid(pid, group);
+    if(jobGroup == 0) setTerminalGroup(group);
+    jobGroup = group;
+    return;
+}
+
+// makes pgid the foreground process group of the shell's terminal, if the shell has one. the caller may already be in
+// the background, so SIGTTOU is held off meanwhile
+void setTerminalGroup(pid_t pgid)
+{
+    sigset_t ttou, previous;
+
+    if(!terminalShell) return;
+    sigemptyset(&ttou);
+    sigaddset(&ttou, SIGTTOU);
+    sigprocmask(SIG_BLOCK, &ttou, &previous);
+    tcsetpgrp(STDIN_FILENO, pgid);
+    sigprocmask(SIG_SETMASK, &previous, NULL);
+    return;
+}
+
+// forks a process for each prepared substitution. each one runs its commands with stdout, or stdin for >(cmd), on
+// its end of the pipe, and is added to the current job as an auxiliary process. pgid puts them in the process group
+// of a background or timed job, 0 leaves them in the shell's. the shell's copies of the pipe ends are closed
+// afterwards so the command sees end of file once the process is done, and the process once the command is done
+void launchSubstitutions(int pgid)
+{
+    fflush(stdout);
+    for(int i=0; i<substitutionCount; i++)
+    {
+        struct Substitution *substitution = &substitutions[i];
+        int child = fork();
+        if(child == 0)
+        {
+            char *text = substitution->text;
+            if(pgid > 0) setpgid(0, pgid);
+            dup2(substitution->other, substitution->output ? STDIN_FILENO : STDOUT_FILENO);
+            closeSubstitutionEnds(1);
+            enterSubshell();
+            execTail = tailExecEnabled;
+            runText(text);
+            fflush(stdout);
+            _exit(lastStatus);
+        } else if(child < 0)
+        {
+            perror("error forking");
+            continue;
+        }
+        if(pgid > 0) setpgid(child, pgid);
+        startJobsPID(jobs, child, activeJobsSize);
+        jobs[activeJobsSize-1].procs[jobs[activeJobsSize-1].procCount-1].auxiliary = 1;
+    }
+    closeSubstitutionEnds(1);
+    return;
+}
+
+// closes the ends of the prepared substitution pipes used by the substituted processes, and the ends given to the
+// command too when commandEnds is set
+void closeSubstitutionEnds(int commandEnds)
+{
+    for(int i=0; i<substitutionCount; i++)
+    {
+        if(commandEnds && substitutions[i].fd >= 0)
+        {
+            close(substitutions[i].fd);
+            substitutions[i].fd = -1;
+        }
+        if(substitutions[i].other >= 0) close(substitutions[i].other);
+        substitutions[i].other = -1;
+    }
+    return;
+}
+
+// drops the substitutions of the command that was just started, closing pipes that were never handed out
+void finishSubstitutions(void)
+{
+    closeSubstitutionEnds(1);
+    for(int i=0; i<substitutionCount; i++)
+    {
+        free(substitutions[i].text);
+        free(substitutions[i].path);
+    }
+    substitutionCount = 0;
+    return;
+}
+
+// runs the shell as a command server on the unix socket at path: each request on a connection is a command line
+// sent with the caller's stdin, stdout and stderr, run in a forked worker like 'yash -c', and answered with its exit
+// status. at most limit workers run at once, further requests wait in their connections. never returns unless the
+// socket can't be set up
+int serveCommands(char *path, int limit)
+{
+    struct sockaddr_un address;
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "yash: %s: socket path too long\n", path);
+        return 2;
+    }
+    strcpy(address.sun_path, path);
+    // only a socket left by an earlier server is replaced, anything else at path is kept
+    struct stat st;
+    if(lstat(path, &st) == 0)
+    {
+        if(!S_ISSOCK(st.st_mode))
+        {
+            fprintf(stderr, "yash: %s: exists and is not a socket\n", path);
+            return 2;
+        }
+        unlink(path);
+    }
+    if(listener == -1 || bind(listener, (struct sockaddr *) &address, sizeof(address)) == -1 ||
+       listen(listener, SOMAXCONN) == -1)
+    {
+        perror(path);
+        return 2;
+    }
+
+    // workers are watched in an epoll set of their own, nested in the one for the sockets. at the limit only the
+    // workers' set is waited on, so ready connections are left alone until a worker finishes
+    int serveEpoll = epoll_create1(EPOLL_CLOEXEC);
+    int workerEpoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(serveEpoll, EPOLL_CTL_ADD, listener, &event);
+    event.data.fd = workerEpoll;
+    epoll_ctl(serveEpoll, EPOLL_CTL_ADD, workerEpoll, &event);
+
+    struct ServeWorker *workers = calloc(limit, sizeof(struct ServeWorker));
+    char *text = malloc(SERVE_MESSAGE_MAX + 1);
+    if(!workers || !text)
+    {
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    for(int w=0; w<limit; w++)
+        workers[w].pid = 0;
+
+    int running = 0;
+    while(1)
+    {
+        struct epoll_event events[MAX_REAP_EVENTS];
+        int ready = epoll_wait(running == limit ? workerEpoll : serveEpoll, events, MAX_REAP_EVENTS, -1);
+        if(ready == -1 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            break;
+        }
+        if(running == limit)
+        {
+            for(int e=0; e<ready; e++)
+                running -= finishServeWorker(&workers[events[e].data.u64], serveEpoll);
+            continue;
+        }
+        for(int e=0; e<ready; e++)
+        {
+            int fd = events[e].data.fd;
+            if(fd == listener)
+            {
+                int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+                if(connection == -1) continue;
+                if(!isOwnPeer(connection))
+                {
+                    close(connection);
+                    continue;
+                }
+                event.data.fd = connection;
+                epoll_ctl(serveEpoll, EPOLL_CTL_ADD, connection, &event);
+            } else if(fd == workerEpoll)
+            {
+                struct epoll_event finished[MAX_REAP_EVENTS];
+                int count = epoll_wait(workerEpoll, finished, MAX_REAP_EVENTS, 0);
+                for(int f=0; f<count; f++)
+                    running -= finishServeWorker(&workers[finished[f].data.u64], serveEpoll);
+            } else if(running < limit)
+            {
+                int w = 0;
+                while(workers[w].pid != 0)
+                    w++;
+                running += startServeWorker(&workers[w], w, fd, text, serveEpoll, workerEpoll);
+            }
+        }
+    }
+    free(workers);
+    free(text);
+    close(serveEpoll);
+    close(workerEpoll);
+    close(listener);
+    return 1;
+}
+
+// returns 1 if the process at the other end of connection runs as the shell's own user. commands from anyone else are
+// never run, whatever the permissions of the socket allow
+int isOwnPeer(int connection)
+{
+    struct ucred peer;
+    socklen_t length = sizeof(peer);
+
+    if(getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &peer, &length) == -1 || length != sizeof(peer))
+    {
+        perror("yash: SO_PEERCRED");
+        return 0;
+    }
+    if(peer.uid != getuid())
+    {
+        fprintf(stderr, "yash: refused a connection from uid %d\n", (int) peer.uid);
+        return 0;
+    }
+    return 1;
+}
+
+// reads the next request from a connection and forks a worker for it in slot w. the connection stays out of the
+// epoll set until the worker has answered. a closed or malformed connection is dropped. returns 1 if a worker started
+int startServeWorker(struct ServeWorker *worker, int w, int connection, char *text, int serveEpoll, int workerEpoll)
+{
+    int fds[3];
+    ssize_t length = receiveRequest(connection, text, fds);
+
+    epoll_ctl(serveEpoll, EPOLL_CTL_DEL, connection, NULL);
+    if(length < 0)
+    {
+        close(connection);
+        return 0;
+    }
+    text[length] = '\0';
+
+    fflush(stdout);
+    fflush(stderr);
+    int pid = fork();
+    if(pid == 0)
+    {
+        for(int i=0; i<3; i++)
+            dup2(fds[i], i);
+        for(int i=0; i<3; i++)
+        {
+            if(fds[i] > 2) close(fds[i]);
+        }
+        enterSubshell();
+        execTail = tailExecEnabled;
+        runText(text);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(lastStatus);
+    }
+    for(int i=0; i<3; i++)
+        close(fds[i]);
+    if(pid < 0)
+    {
+        perror("error forking");
+        close(connection);
+        return 0;
+    }
+
+    struct epoll_event event;
+    worker->pid = pid;
+    worker->connection = connection;
+    worker->pidfd = (int) syscall(SYS_pidfd_open, pid, 0);
+    event.events = EPOLLIN;
+    event.data.u64 = (uint64_t) w;
+    if(worker->pidfd < 0 || epoll_ctl(workerEpoll, EPOLL_CTL_ADD, worker->pidfd, &event) == -1)
+    {
+        // without a pidfd the request is served one at a time
+        int status;
+        waitpid(pid, &status, 0);
+        worker->status = status;
+        if(worker->pidfd >= 0) close(worker->pidfd);
+        worker->pidfd = -1;
+        finishServeWorker(worker, serveEpoll);
+        return 0;
+    }
+    return 1;
+}
+
+// reaps a finished worker, sends its exit status back on its connection and puts the connection back in the epoll
+// set for the next request. returns 1 if the worker had finished
+int finishServeWorker(struct ServeWorker *worker, int serveEpoll)
+{
+    if(worker->pidfd >= 0)
+    {
+        siginfo_t info;
+        info.si_pid = 0;
+        if(waitid(YASH_P_PIDFD, worker->pidfd, &info, WEXITED | WNOHANG) == -1 || info.si_pid == 0) return 0;
+        worker->status = info.si_code == CLD_EXITED ? (info.si_status & 0xff) << 8 : info.si_status & 0x7f;
+        close(worker->pidfd);
+    }
+
+    int32_t reply = statusToExitCode(worker->status);
+    if(send(worker->connection, &reply, sizeof(reply), MSG_NOSIGNAL) == sizeof(reply))
+    {
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = worker->connection;
+        epoll_ctl(serveEpoll, EPOLL_CTL_ADD, worker->connection, &event);
+    } else
+        close(worker->connection);
+    worker->pid = 0;
+    return 1;
+}
+
+// receives one request: the command text into text and the three descriptors passed with it into fds. returns the
+// length of the text, or -1 when the peer closed the connection or didn't send a whole request
+ssize_t receiveRequest(int connection, char *text, int *fds)
+{
+    char control[CMSG_SPACE(sizeof(int) * 3)];
+    struct iovec iov = {text, SERVE_MESSAGE_MAX};
+    struct msghdr message;
+
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t length = recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+    if(length <= 0) return -1;
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if(!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS ||
+       header->cmsg_len != CMSG_LEN(sizeof(int) * 3))
+    {
+        fprintf(stderr, "yash: request without stdin, stdout and stderr\n");
+        if(header && header->cmsg_type == SCM_RIGHTS)
+        {
+            int count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for(int i=0; i<count; i++)
+                close(((int *) CMSG_DATA(header))[i]);
+        }
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(header), sizeof(int) * 3);
+    if(message.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+    {
+        fprintf(stderr, "yash: request longer than %d bytes\n", SERVE_MESSAGE_MAX);
+        for(int i=0; i<3; i++)
+            close(fds[i]);
+        return -1;
+    }
+    return length;
+}
+
+// the client of --serve: sends command with this process's stdin, stdout and stderr to the server at path and
+// returns the exit status it answers with
+int runClient(char *path, char *command)
+{
+    struct sockaddr_un address;
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(fds))];
+    int connection = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+    if(*command == '\0') return 0;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    if(connection == -1 || connect(connection, (struct sockaddr *) &address, sizeof(address)) == -1)
+    {
+        perror(path);
+        return 127;
+    }
+    if(strlen(command) > SERVE_MESSAGE_MAX)
+    {
+        fprintf(stderr, "yash: command longer than %d bytes\n", SERVE_MESSAGE_MAX);
+        return 2;
+    }
+
+    struct iovec iov = {command, strlen(command)};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    memset(control, 0, sizeof(control));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    int32_t reply;
+    if(sendmsg(connection, &message, MSG_NOSIGNAL) == -1 || recv(connection, &reply, sizeof(reply), 0) != sizeof(reply))
+    {
+        fprintf(stderr, "yash: %s: no answer from the server\n", path);
+        close(connection);
+        return 127;
+    }
+    close(connection);
+    return reply;
+}
+
+// built in pipesize command. with no arguments prints the capacity given to new pipes. SIZE (bytes, or with a K or M
+// suffix) sets it, 'default' goes back to the kernel default, -a grows pipes while their producer is blocked and +a
+// turns that off again
+int yash_pipesize(char **args)
+{
+    int argCount = countArgs(args);
+
+    for(int i=1; i<argCount; i++)
+    {
+        if(strcmp(args[i], "-a") == 0)
+            pipeAdaptive = 1;
+        else if(strcmp(args[i], "+a") == 0)
+            pipeAdaptive = 0;
+        else if(parsePipeSize(args[i], &pipeCapacity, &pipeAdaptive) == -1)
+        {
+            fprintf(stderr, "pipesize: invalid size %s\n", args[i]);
+            lastStatus = 1;
+            return FINISHED_INPUT;
+        }
+    }
+    if(argCount == 1)
+    {
+        if(pipeCapacity == 0)
+            printf("pipesize default%s (max %d)\n", pipeAdaptive ? " adaptive" : "", maxPipeCapacity());
+        else
+            printf("pipesize %d%s (max %d)\n", pipeCapacity, pipeAdaptive ? " adaptive" : "", maxPipeCapacity());
+    }
+    return FINISHED_INPUT;
+}
+
+// parses a pipe size of the form 'default', 'auto' or a byte count with an optional K or M suffix. a size above the
+// system limit is clamped to it. returns -1 if the text is not a valid size
+int parsePipeSize(char *text, int *capacity, int *adaptive)
+{
+    char *end;
+
+    if(strcmp(text, "default") == 0)
+    {
+        *capacity = 0;
+        *adaptive = 0;
+        return 1;
+    }
+    if(strcmp(text, "auto") == 0)
+    {
+        *adaptive = 1;
+        return 1;
+    }
+
+    long size = strtol(text, &end, 10);
+    long multiplier = 1;
+    if(end == text || size <= 0) return -1;
+    if(*end == 'k' || *end == 'K')
+    {
+        multiplier = 1024;
+        end++;
+    } else if(*end == 'm' || *end == 'M')
+    {
+        multiplier = 1024 * 1024;
+        end++;
+    }
+    if(*end != '\0') return -1;
+    // strtol gives LONG_MAX for a count too long for a long, which clamps like any other large size
+    if(size > LONG_MAX / multiplier || size * multiplier > maxPipeCapacity())
+        size = maxPipeCapacity();
+    else
+        size *= multiplier;
+    *capacity = (int) size;
+    *adaptive = 0;
+    return 1;
+}
+
+// returns the largest capacity an unprivileged process may give a pipe
+int maxPipeCapacity(void)
+{
+    static int limit = 0;
+
+    if(limit == 0)
+    {
+        FILE *limitFile = fopen("/proc/sys/fs/pipe-max-size", "r");
+        if(!limitFile || fscanf(limitFile, "%d", &limit) != 1)
+            limit = DEFAULT_PIPE_MAX_SIZE;
+        if(limitFile) fclose(limitFile);
+    }
+    return limit;
+}
+
+// resizes the pipe behind fd, clamped to the system limit. returns the capacity the pipe ended up with
+int setPipeCapacity(int fd, int capacity)
+{
+    int limit = maxPipeCapacity();
+
+    if(capacity > limit) capacity = limit;
+    if(fcntl(fd, F_SETPIPE_SZ, capacity) == -1)
+        perror("F_SETPIPE_SZ");
+    return fcntl(fd, F_GETPIPE_SZ);
+}
+
+// grows the pipe of a running two stage pipeline. a pipe that stays full means the producer is blocked waiting on the
+// consumer, so its capacity is doubled (up to the system limit) to let the producer run further ahead. returns when a
+// stage exits or stops, when the limit is reached, or when the processes have no pidfds to watch
+void monitorPipe(int readFd, struct Job *job)
+{
+    struct pollfd fds[2];
+    int signalsSeen = childSignals;
+    int limit = maxPipeCapacity();
+    int capacity = fcntl(readFd, F_GETPIPE_SZ);
+    int queued;
+
+    if(job->procCount != 2 || job->procs[0].pidfd < 0 || job->procs[1].pidfd < 0) return;
+    for(int i=0; i<2; i++)
+    {
+        fds[i].fd = job->procs[i].pidfd;
+        fds[i].events = POLLIN;
+    }
+
+    while(capacity > 0 && capacity < limit && signalsSeen == childSignals)
+    {
+        if(poll(fds, 2, PIPE_MONITOR_INTERVAL_MS) != 0) return;
+        if(ioctl(readFd, FIONREAD, &queued) == -1) return;
+        if(queued >= capacity - PIPE_BUF)
+        {
+            int grown = setPipeCapacity(readFd, capacity * 2);
+            if(grown <= capacity) return;
+            capacity = grown;
+        }
+    }
+    return;
+}
+
+// reads a line from the terminal with the terminal's echo and line editing turned off, so TAB can complete command
+// and file names. returns the line with its newline like readLineIn, "" for an empty line and NULL on end of file
+char *editLine(void)
+{
+    struct termios saved, raw;
+    struct LineBuffer line = {NULL, 0, 0};
+    int lastWasTab = 0;
+    unsigned char c;
+
+    fflush(stdout);
+    if(tcgetattr(STDIN_FILENO, &saved) == -1) return NULL;
+    raw = saved;
+    // signals from ^C and ^Z still work, only canonical input and echo are off
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    appendLine(&line, "", 0);
+
+    while(1)
+    {
+        // time limits of background jobs keep running out, prompt segments come in and queued jobs take the place of
+        // finished ones while a line is typed. finished jobs are only reported at the next prompt
+        if(timerCount > 0 || promptHelperFd >= 0 || queuedCount > 0)
+        {
+            struct pollfd fds[4] = {{STDIN_FILENO, POLLIN, 0}, {timerCount > 0 ? timerFd : -1, POLLIN, 0},
+                                    {promptHelperFd, POLLIN, 0}, {queuedCount > 0 ? jobsEpollFd : -1, POLLIN, 0}};
+            if(poll(fds, 4, -1) > 0)
+            {
+                if(fds[1].revents & POLLIN) runTimers();
+                if(fds[2].revents) readPromptSegments(&line);
+                if(fds[3].revents & POLLIN)
+                {
+                    collectUntracked();
+                    admitQueued();
+                }
+            }
+            if(!fds[0].revents) continue;
+        }
+        ssize_t got = read(STDIN_FILENO, &c, 1);
+        if(got == -1 && errno == EINTR) continue;
+        if(got <= 0 || (c == CTRL_KEY('d') && line.length == 0))
+        {
+            if(line.length > 0) break;
+            tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+            free(line.text);
+            return NULL;
+        }
+        if(c == '\n' || c == '\r') break;
+
+        int isTab = c == '\t';
+        if(isTab)
+        {
+            completeLine(&line, lastWasTab);
+        } else if(c == 127 || c == '\b')
+        {
+            eraseChars(&line, 1);
+        } else if(c == CTRL_KEY('u'))
+        {
+            eraseChars(&line, line.length);
+        } else if(c == CTRL_KEY('w'))
+        {
+            size_t end = line.length;
+            while(end > 0 && line.text[end - 1] == ' ') end--;
+            while(end > 0 && line.text[end - 1] != ' ') end--;
+            eraseChars(&line, line.length - end);
+        } else if(c == CTRL_KEY('l'))
+        {
+            writeText("\033[H\033[2J", 7);
+            redrawLine(&line);
+        } else if(c == 27)
+        {
+            // cursor keys and other escape sequences aren't supported, read past them
+            unsigned char next;
+            if(read(STDIN_FILENO, &next, 1) == 1 && (next == '[' || next == 'O'))
+            {
+                while(read(STDIN_FILENO, &next, 1) == 1 && !isalpha(next) && next != '~');
+            }
+        } else if(c >= ' ')
+        {
+            appendLine(&line, (char *) &c, 1);
+            writeText((char *) &c, 1);
+        }
+        lastWasTab = isTab;
+    }
+
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    writeText("\n", 1);
+    if(line.length > 0) appendLine(&line, "\n", 1);
+    return line.text;
+}
+
+// builds the primary prompt from PS1, "# " when it isn't set. \w is the working directory with ~ for HOME, \u the
+// user, \h the host name, \$ '#' for root and '$' for anyone else, \T how long the last command took and \\ a
+// backslash. \g (git branch, with a * when there are changes) and \l (load average) are slow to find out, so they
+// show the last values the prompt helper sent and are patched in once it sends new ones
+void buildPrompt(void)
+{
+    struct LineBuffer prompt = {NULL, 0, 0};
+    char *format = getVar("PS1", 3);
+    char text[PATH_MAX];
+
+    appendLine(&prompt, "", 0);
+    if(!format) format = "# ";
+    for(char *p = format; *p; p++)
+    {
+        if(*p != '\\' || !p[1])
+        {
+            appendLine(&prompt, p, 1);
+            continue;
+        }
+        text[0] = '\0';
+        switch(*++p)
+        {
+            case 'w':
+            {
+                char *home = getenv("HOME");
+                size_t homeLength = home ? strlen(home) : 0;
+                if(!getcwd(text, sizeof(text))) strcpy(text, "?");
+                if(homeLength > 1 && strncmp(text, home, homeLength) == 0 &&
+                   (text[homeLength] == '/' || text[homeLength] == '\0'))
+                {
+                    appendLine(&prompt, "~", 1);
+                    memmove(text, text + homeLength, strlen(text + homeLength) + 1);
+                }
+                break;
+            }
+            case 'u':
+            {
+                struct passwd *user = getpwuid(geteuid());
+                snprintf(text, sizeof(text), "%s", user ? user->pw_name : "?");
+                break;
+            }
+            case 'h':
+                if(gethostname(text, HOST_NAME_MAX) == -1) strcpy(text, "?");
+                text[HOST_NAME_MAX] = '\0';
+                break;
+            case '$':
+                strcpy(text, geteuid() == 0 ? "#" : "$");
+                break;
+            case 'T':
+                if(lastCommandMs < 1000)
+                    snprintf(text, sizeof(text), "%lldms", lastCommandMs);
+                else if(lastCommandMs < 60000)
+                    snprintf(text, sizeof(text), "%lld.%llds", lastCommandMs / 1000, lastCommandMs % 1000 / 100);
+                else
+                    snprintf(text, sizeof(text), "%lldm%llds", lastCommandMs / 60000, lastCommandMs % 60000 / 1000);
+                break;
+            case 'g':
+            case 'l':
+            {
+                int segment = *p == 'g' ? PROMPT_GIT : PROMPT_LOAD;
+                if(promptSegments[segment]) snprintf(text, sizeof(text), "%s", promptSegments[segment]);
+                break;
+            }
+            default:
+                // \\ and unknown escapes stand for the character itself
+                text[0] = *p;
+                text[1] = '\0';
+        }
+        appendLine(&prompt, text, strlen(text));
+    }
+    free(promptLine);
+    promptLine = prompt.text;
+    return;
+}
+
+// forks the prompt helper when PS1 has slow segments, stopping the one for the previous prompt. the helper finds
+// their values in its own process group, so ^C at the prompt doesn't reach it or git, and writes each one to a pipe
+// as its letter followed by the value and a newline. the line editor reads them while the user types
+void startPromptHelper(void)
+{
+    char *format = getVar("PS1", 3);
+    int pfd[2];
+
+    stopPromptHelper();
+    if(!format || (!strstr(format, "\\g") && !strstr(format, "\\l"))) return;
+    if(!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || pipe2(pfd, O_CLOEXEC) == -1) return;
+    // a git segment from another directory doesn't apply here
+    char cwd[PATH_MAX];
+    if(getcwd(cwd, sizeof(cwd)) && promptSegmentsDir && strcmp(cwd, promptSegmentsDir) != 0)
+    {
+        free(promptSegments[PROMPT_GIT]);
+        promptSegments[PROMPT_GIT] = NULL;
+    }
+    free(promptSegmentsDir);
+    promptSegmentsDir = strdup(cwd);
+
+    fflush(stdout);
+    int pid = fork();
+    if(pid == 0)
+    {
+        char value[PROMPT_SEGMENT_MAX];
+        char message[PROMPT_SEGMENT_MAX + 3];
+        setpgid(0, 0);
+        close(pfd[0]);
+        if(strstr(format, "\\l"))
+        {
+            findLoadSegment(value, sizeof(value));
+            writeAll(pfd[1], message, snprintf(message, sizeof(message), "l%s\n", value));
+        }
+        if(strstr(format, "\\g"))
+        {
+            findGitSegment(value, sizeof(value));
+            writeAll(pfd[1], message, snprintf(message, sizeof(message), "g%s\n", value));
+        }
+        _exit(0);
+    }
+    close(pfd[1]);
+    if(pid < 0)
+    {
+        close(pfd[0]);
+        return;
+    }
+    setpgid(pid, pid);
+    fcntl(pfd[0], F_SETFL, O_NONBLOCK);
+    promptHelperPid = pid;
+    promptHelperFd = pfd[0];
+    promptHelperLength = 0;
+    return;
+}
+
+// kills a prompt helper that is still working, with the git it may be running, and reaps it
+void stopPromptHelper(void)
+{
+    if(promptHelperFd >= 0) close(promptHelperFd);
+    promptHelperFd = -1;
+    if(promptHelperPid > 0)
+    {
+        kill(-promptHelperPid, SIGKILL);
+        waitpid(promptHelperPid, NULL, 0);
+    }
+    promptHelperPid = -1;
+    return;
+}
+
+// reads what the prompt helper has sent so far and takes in every complete segment. when a segment changes the
+// prompt is built again and, while it is the one shown, the line being edited is drawn again after it
+void readPromptSegments(struct LineBuffer *line)
+{
+    ssize_t got;
+    int changed = 0;
+
+    while((got = read(promptHelperFd, promptHelperBuffer + promptHelperLength,
+                      sizeof(promptHelperBuffer) - promptHelperLength - 1)) > 0)
+    {
+        promptHelperLength += got;
+        promptHelperBuffer[promptHelperLength] = '\0';
+        char *end;
+        while((end = strchr(promptHelperBuffer, '\n')) != NULL)
+        {
+            int segment = promptHelperBuffer[0] == 'g' ? PROMPT_GIT : PROMPT_LOAD;
+            *end = '\0';
+            if(!promptSegments[segment] || strcmp(promptSegments[segment], promptHelperBuffer + 1) != 0)
+            {
+                free(promptSegments[segment]);
+                promptSegments[segment] = strdup(promptHelperBuffer + 1);
+                changed = 1;
+            }
+            promptHelperLength -= end + 1 - promptHelperBuffer;
+            memmove(promptHelperBuffer, end + 1, promptHelperLength + 1);
+        }
+        // a line too long for the buffer is dropped
+        if(promptHelperLength == sizeof(promptHelperBuffer) - 1) promptHelperLength = 0;
+    }
+    if(got == 0 || (got == -1 && errno != EAGAIN && errno != EINTR)) stopPromptHelper();
+    if(!changed) return;
+
+    int shown = promptText == promptLine;
+    buildPrompt();
+    if(!shown) return;
+    promptText = promptLine;
+    writeText("\r\033[K", 4);
+    redrawLine(line);
+    return;
+}
+
+// the git segment: the current branch, or the abbreviated commit when detached, with a * when tracked files have
+// changes. empty outside of a git work tree
+void findGitSegment(char *value, size_t size)
+{
+    char *branchArgs[] = {"git", "symbolic-ref", "--short", "-q", "HEAD", NULL};
+    char *commitArgs[] = {"git", "rev-parse", "--short", "HEAD", NULL};
+    char *statusArgs[] = {"git", "status", "--porcelain", "--untracked-files=no", NULL};
+    char changes[2];
+
+    if(captureOutput(branchArgs, value, size - 1) != 0 && captureOutput(commitArgs, value, size - 1) != 0)
+    {
+        value[0] = '\0';
+        return;
+    }
+    if(captureOutput(statusArgs, changes, sizeof(changes)) == 0 && changes[0] != '\0')
+        strcat(value, "*");
+    return;
+}
+
+// the load average segment: the load over the last minute
+void findLoadSegment(char *value, size_t size)
+{
+    int fd = open("/proc/loadavg", O_RDONLY | O_CLOEXEC);
+    ssize_t got = fd >= 0 ? read(fd, value, size - 1) : -1;
+
+    if(fd >= 0) close(fd);
+    value[got > 0 ? got : 0] = '\0';
+    value[strcspn(value, " \n")] = '\0';
+    return;
+}
+
+// runs a command with its stdout in value, up to size - 1 bytes without the trailing newline, and its stderr thrown
+// away. returns its exit status, or -1 when it couldn't be run
+int captureOutput(char **args, char *value, size_t size)
+{
+    int pfd[2];
+    size_t length = 0;
+    ssize_t got;
+    int status;
+
+    value[0] = '\0';
+    if(pipe2(pfd, O_CLOEXEC) == -1) return -1;
+    int pid = fork();
+    if(pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(pfd[1], STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execvp(args[0], args);
+        _exit(127);
+    }
+    close(pfd[1]);
+    if(pid < 0)
+    {
+        close(pfd[0]);
+        return -1;
+    }
+    // the rest of the output is read and dropped so the command isn't stopped by a full pipe
+    char discard[4096];
+    while((got = read(pfd[0], length < size - 1 ? value + length : discard,
+                      length < size - 1 ? size - 1 - length : sizeof(discard))) > 0)
+    {
+        if(length < size - 1) length += got;
+    }
+    close(pfd[0]);
+    value[length] = '\0';
+    if(length > 0 && value[length - 1] == '\n') value[length - 1] = '\0';
+    if(waitpid(pid, &status, 0) == -1) return -1;
+    return statusToExitCode(status);
+}
+
+
+// appends length bytes of text to the line being edited, keeping it NUL terminated
+void appendLine(struct LineBuffer *line, char *text, size_t length)
+{
+    if(line->length + length + 1 > line->capacity)
+    {
+        while(line->length + length + 1 > line->capacity)
+            line->capacity = line->capacity ? line->capacity * 2 : 128;
+        line->text = realloc(line->text, line->capacity);
+        if(!line->text)
+        {
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(line->text + line->length, text, length);
+    line->length += length;
+    line->text[line->length] = '\0';
+    return;
+}
+
+// removes up to count characters from the end of the line and from the screen. the bytes of a multi-byte character
+// are removed together
+void eraseChars(struct LineBuffer *line, size_t count)
+{
+    for(size_t i=0; i<count && line->length > 0; i++)
+    {
+        do
+            line->length--;
+        while(line->length > 0 && (line->text[line->length] & 0xc0) == 0x80);
+        writeText("\b \b", 3);
+    }
+    line->text[line->length] = '\0';
+    return;
+}
+
+// prints the prompt and the line again, after completions were listed or the screen was cleared
+void redrawLine(struct LineBuffer *line)
+{
+    writeText(promptText, strlen(promptText));
+    writeText(line->text, line->length);
+    return;
+}
+
+// writes to the terminal straight away, stdout is only flushed at the end of a line
+void writeText(char *text, size_t length)
+{
+    writeAll(STDOUT_FILENO, text, length);
+    return;
+}
+
+// writes all of text to fd
+void writeAll(int fd, char *text, size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t written = write(fd, text, length);
+        if(written == -1 && errno == EINTR) continue;
+        if(written <= 0) return;
+        text += written;
+        length -= written;
+    }
+    return;
+}
+
+// completes the word at the end of the line. the first word of a command is completed from the executables in PATH
+// and the built ins, any other word, or one with a '/', from the file names in its directory. the word is extended as
+// far as every candidate agrees, and a second TAB without anything to add lists the candidates
+void completeLine(struct LineBuffer *line, int listCandidates)
+{
+    struct Candidates candidates = {NULL, 0, 0};
+    size_t start = line->length;
+    size_t typed;
+
+    while(start > 0 && !strchr(" \t;&|<>()", line->text[start - 1]))
+        start--;
+    char *word = line->text + start;
+    size_t before = start;
+    while(before > 0 && line->text[before - 1] == ' ')
+        before--;
+    int commandPosition = before == 0 || strchr(";&|({", line->text[before - 1]);
+
+    if(commandPosition && !strchr(word, '/'))
+    {
+        completeCommand(word, &candidates);
+        typed = strlen(word);
+    } else
+    {
+        completeFilename(word, &candidates);
+        char *slash = strrchr(word, '/');
+        typed = strlen(slash ? slash + 1 : word);
+    }
+
+    if(candidates.count > 0)
+    {
+        size_t common = strlen(candidates.names[0]);
+        for(int i=1; i<candidates.count; i++)
+        {
+            size_t same = 0;
+            while(same < common && candidates.names[i][same] == candidates.names[0][same])
+                same++;
+            common = same;
+        }
+        if(common > typed)
+        {
+            appendLine(line, candidates.names[0] + typed, common - typed);
+            writeText(candidates.names[0] + typed, common - typed);
+        }
+        if(candidates.count == 1)
+        {
+            // a directory carries on with its contents, anything else ends the word
+            char *end = candidates.names[0][common - 1] == '/' ? "" : " ";
+            appendLine(line, end, strlen(end));
+            writeText(end, strlen(end));
+        } else if(common == typed && listCandidates)
+        {
+            listCompletions(&candidates);
+            redrawLine(line);
+        }
+    }
+    for(int i=0; i<candidates.count; i++)
+        free(candidates.names[i]);
+    free(candidates.names);
+    return;
+}
+
+// prints the candidates for a completion on the lines below the one being edited
+void listCompletions(struct Candidates *candidates)
+{
+    writeText("\n", 1);
+    if(candidates->count > COMPLETION_LIST_LIMIT)
+    {
+        char message[64];
+        int length = snprintf(message, sizeof(message), "%d possibilities\n", candidates->count);
+        writeText(message, length);
+        return;
+    }
+    for(int i=0; i<candidates->count; i++)
+    {
+        writeText(candidates->names[i], strlen(candidates->names[i]));
+        writeText(i + 1 < candidates->count ? "  " : "\n", i + 1 < candidates->count ? 2 : 1);
+    }
+    return;
+}
+
+// adds a copy of length bytes of name to the candidates
+void addCandidate(struct Candidates *candidates, char *name, size_t length)
+{
+    if(candidates->count == candidates->capacity)
+    {
+        candidates->capacity = candidates->capacity ? candidates->capacity * 2 : 16;
+        candidates->names = realloc(candidates->names, sizeof(char*) * candidates->capacity);
+        if(!candidates->names)
+        {
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    candidates->names[candidates->count++] = strndup(name, length);
+    return;
+}
+
+// collects the command names starting with prefix. the trie of PATH is built on the first completion and after
+// PATH changes, and otherwise only updated for the names inotify reports as changed
+void completeCommand(char *prefix, struct Candidates *candidates)
+{
+    char *path = getenv("PATH") ? getenv("PATH") : "";
+
+    if(commandTrie.built && strcmp(commandTrie.path, path) != 0)
+        freeCommandTrie(&commandTrie);
+    if(!commandTrie.built)
+        buildCommandTrie(&commandTrie, path);
     else
-        jobs[*activeJobsSize].task_no = jobs[*activeJobsSize-1].task_no + 1;
+        updateCommandTrie(&commandTrie);
 
-    jobs[*activeJobsSize].runningStatus = STOPPED;
-    jobs[*activeJobsSize].pid_no = 0;
+    // walk down to the node for the prefix, then every name below it is a candidate
+    int node = 0;
+    for(char *p = prefix; *p && node >= 0; p++)
+        node = findTrieChild(&commandTrie, node, *p);
+    if(node < 0) return;
 
-    (*activeJobsSize)++;
+    struct LineBuffer name = {NULL, 0, 0};
+    appendLine(&name, prefix, strlen(prefix));
+    collectTrieNames(&commandTrie, node, &name, candidates);
+    free(name.text);
     return;
 }
 
-// built in jobs command. prints out each job's pid number, jobs number, and status
-int yash_jobs(struct Job *jobs, int activeJobsSize)
+// adds every name in the subtree of node to the candidates, in byte order. name holds the characters leading to node
+void collectTrieNames(struct CommandTrie *trie, int node, struct LineBuffer *name, struct Candidates *candidates)
 {
-    for(int i=0; i<activeJobsSize; i++)
+    if(trie->nodes[node].count > 0)
+        addCandidate(candidates, name->text, name->length);
+    for(int child = trie->nodes[node].child; child >= 0; child = trie->nodes[child].sibling)
     {
-        char *runningStr;
-
-        if(jobs[i].runningStatus)
-            runningStr = "Running";
-        else
-            runningStr = "Stopped";
-
-        if(i == activeJobsSize-1)
-            printf("[%d] + %s  %d  %s\n", jobs[i].task_no, runningStr ,jobs[i].pid_no ,jobs[i].line);
-        else
-            printf("[%d] - %s  %d  %s\n", jobs[i].task_no, runningStr, jobs[i].pid_no ,jobs[i].line);
+        appendLine(name, &trie->nodes[child].c, 1);
+        collectTrieNames(trie, child, name, candidates);
+        name->text[--name->length] = '\0';
     }
-    if(activeJobsSize == 0) printf("No active jobs\n");
-    return FINISHED_INPUT;
+    return;
 }
 
-// built in fg command. puts the most recent command from the jobs table into the foreground
-void yash_fg(struct Job *jobs, int activeJobSize, int *pActiveJobSize)
+// returns the child of node for character c, or -1
+int findTrieChild(struct CommandTrie *trie, int node, char c)
 {
-    int status;
-
-    if(activeJobSize == 0)
+    for(int child = trie->nodes[node].child; child >= 0; child = trie->nodes[child].sibling)
     {
-        printf("yash: No active jobs");
-        return;
+        if(trie->nodes[child].c == c) return child;
+        if((unsigned char) trie->nodes[child].c > (unsigned char) c) break;
     }
+    return -1;
+}
 
-    pid_ch1 = jobs[activeJobSize - 1].pid_no;
-    setJobStatus(jobs, pid, activeJobSize, RUNNING);
-    for(int i=0; i<activeJobSize; i++)
+// returns the node for name, adding the nodes that are missing. children are kept in byte order
+int addTrieName(struct CommandTrie *trie, char *name)
+{
+    int node = 0;
+
+    for(char *p = name; *p; p++)
     {
-        char *runningStr;
-        if(jobs[i].runningStatus)
-            runningStr = "Running";
-        else
-            runningStr = "Stopped";
-        if(i == activeJobSize-1)
+        int *link = &trie->nodes[node].child;
+        while(*link >= 0 && (unsigned char) trie->nodes[*link].c < (unsigned char) *p)
+            link = &trie->nodes[*link].sibling;
+        if(*link >= 0 && trie->nodes[*link].c == *p)
         {
-            if(jobs[i].pid_no == pid_ch1)
-                printf("[%d] + %s    %s\n", jobs[i].task_no, runningStr , jobs[i].line);
+            node = *link;
+            continue;
+        }
 
-        } else
+        if(trie->nodeCount == trie->nodeCapacity)
         {
-            if(jobs[i].pid_no == pid_ch1)
-                printf("[%d] - %s    %s\n", jobs[i].task_no, runningStr, jobs[i].line);
+            // link points into the array being moved, so it is found again by its offset
+            ptrdiff_t offset = (char *) link - (char *) trie->nodes;
+            trie->nodeCapacity = trie->nodeCapacity ? trie->nodeCapacity * 2 : 1024;
+            trie->nodes = realloc(trie->nodes, sizeof(struct TrieNode) * trie->nodeCapacity);
+            if(!trie->nodes)
+            {
+                fprintf(stderr, "yash: allocation error\n");
+                exit(EXIT_FAILURE);
+            }
+            link = (int *) ((char *) trie->nodes + offset);
         }
+        int added = trie->nodeCount++;
+        trie->nodes[added].c = *p;
+        trie->nodes[added].count = 0;
+        trie->nodes[added].child = -1;
+        trie->nodes[added].sibling = *link;
+        *link = added;
+        node = added;
     }
-    char *line_cpy = strdup(jobs[activeJobSize -1].line);
-    if(pipeQty(parseLine(line_cpy)) > 0) {
-        kill(-pid_ch1, SIGCONT);
-    } else {
-        kill(pid_ch1, SIGCONT);
-    }
-    pid = waitpid(-1, &status, WUNTRACED | WCONTINUED);
-    fflush(stdout);
-    if (WIFCONTINUED(status)) {
-        pid = waitpid(-1, &status, WUNTRACED | WCONTINUED);
-    }
-    if (pid == -1) {
-        perror("waitpid");
-    }
-    if (WIFEXITED(status) || WIFSIGNALED(status)) {
-        removeFromJobs(jobs, pid, pActiveJobSize);
-    } else if (WIFSTOPPED(status)) {
-        setJobStatus(jobs, pid, activeJobSize, STOPPED);
-    }
-    return;
+    return node;
 }
 
-// build in bg command. puts the most recent stopped job in the background
-void yash_bg(struct Job *jobs, int activeJobSize)
+// builds the trie of the built ins and of the executables in every directory of path, and starts watching the
+// directories for files being added, removed or made executable
+void buildCommandTrie(struct CommandTrie *trie, char *path)
 {
-    int pid=0;
-    int made_it_to_end = 1;
+    char **builtIns = completedBuiltIns();
 
-    if(activeJobSize == 0)
-    {
-        printf("yash: No active jobs");
-        return;
-    }
-    for(int i=activeJobSize-1; i>=0; i--)
+    memset(trie, 0, sizeof(struct CommandTrie));
+    trie->path = strdup(path);
+    trie->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // the root is the only node added without addTrieName
+    trie->nodeCapacity = 1024;
+    trie->nodes = malloc(sizeof(struct TrieNode) * trie->nodeCapacity);
+    if(!trie->nodes || !trie->path)
     {
-        char *line_cpy = strdup(jobs[i].line);
-        int num_pipes = pipeQty(parseLine(line_cpy));
-        if((num_pipes == 0) && (jobs[i].runningStatus == STOPPED)) {
-            pid = jobs[i].pid_no;
-            made_it_to_end = 0;
-            break;
-        }
-    }
-    if(made_it_to_end == 1){
-        printf("No jobs available to put in background.\n");
-        return;
+        fprintf(stderr, "yash: allocation error\n");
+        exit(EXIT_FAILURE);
     }
-    setJobStatus(jobs, pid, activeJobSize, RUNNING);
-    for(int i=0; i<activeJobSize; i++)
-    {
-        char *runningStr;
-
-        if(jobs[i].runningStatus)
-            runningStr = "Running";
-        else
-            runningStr = "Stopped";
+    trie->nodes[0].c = '\0';
+    trie->nodes[0].count = 0;
+    trie->nodes[0].child = -1;
+    trie->nodes[0].sibling = -1;
+    trie->nodeCount = 1;
 
-        if(i == activeJobSize-1)
-        {
-            if(jobs[i].pid_no == pid)
-                printf("[%d] + %s    %s\n", jobs[i].task_no, runningStr , jobs[i].line);
+    for(int i=0; builtIns[i]; i++)
+        trie->nodes[addTrieName(trie, builtIns[i])].count++;
 
-        } else
+    char *dirs = strdup(path);
+    for(char *dir = strtok(dirs, ":"); dir; dir = strtok(NULL, ":"))
+    {
+        trie->dirs = realloc(trie->dirs, sizeof(char*) * (trie->dirCount + 1));
+        trie->dirFds = realloc(trie->dirFds, sizeof(int) * (trie->dirCount + 1));
+        trie->watches = realloc(trie->watches, sizeof(int) * (trie->dirCount + 1));
+        if(!trie->dirs || !trie->dirFds || !trie->watches)
         {
-            if(jobs[i].pid_no == pid)
-                printf("[%d] - %s    %s\n", jobs[i].task_no, runningStr, jobs[i].line);
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
         }
+        int d = trie->dirCount++;
+        trie->dirs[d] = strdup(dir);
+        trie->dirFds[d] = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        trie->watches[d] = trie->inotifyFd >= 0 ?
+                inotify_add_watch(trie->inotifyFd, dir, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                                       IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR) : -1;
+        if(trie->dirFds[d] >= 0) scanCommandDir(trie, trie->dirFds[d]);
     }
-    kill(pid, SIGCONT);
+    free(dirs);
+    trie->built = 1;
     return;
 }
 
-// updates the jobs table with the pid number and gives the job a 'running' status
-void startJobsPID(struct Job *jobs, int pid, int activeJobsSize)
+// adds the executables of one PATH directory to the trie, reading the directory with getdents64
+void scanCommandDir(struct CommandTrie *trie, int dirFd)
 {
-    jobs[activeJobsSize-1].pid_no = pid;
-    jobs[activeJobsSize-1].runningStatus = RUNNING;
+    struct DirReader reader;
+    struct LinuxDirent64 *entry;
+    char buffer[DIR_BUFFER_SIZE] __attribute__((aligned(8)));
+
+    // the descriptor is kept for recounting names later, so the directory is read through a duplicate
+    reader.fd = fcntl(dirFd, F_DUPFD_CLOEXEC, 0);
+    reader.length = 0;
+    reader.offset = 0;
+    reader.buffer = buffer;
+    if(reader.fd < 0) return;
+    while((entry = nextDirEntry(&reader)) != NULL)
+    {
+        if(entry->d_type == DT_DIR || entry->d_name[0] == '.') continue;
+        if(isExecutableAt(dirFd, entry->d_name, entry->d_type))
+            trie->nodes[addTrieName(trie, entry->d_name)].count++;
+    }
+    close(reader.fd);
     return;
 }
 
-// removes a job by pid number from the jobs table. should be used when a job is finished or killed.
-void removeFromJobs(struct Job *jobs, int pid, int *activeJobsSize)
+// applies the changes inotify has reported since the last completion. each changed name is counted again over every
+// PATH directory, so files being renamed, removed or made executable are all handled the same way
+void updateCommandTrie(struct CommandTrie *trie)
 {
-    for(int i=0; i<*activeJobsSize; i++)
+    char buffer[INOTIFY_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+
+    if(trie->inotifyFd < 0) return;
+    while((length = read(trie->inotifyFd, buffer, sizeof(buffer))) > 0)
     {
-        if((jobs[i].pid_no == pid))
+        for(char *p = buffer; p < buffer + length; p += sizeof(struct inotify_event) + ((struct inotify_event *) p)->len)
         {
-            for(int j=i; j<(*activeJobsSize-1); j++)
+            struct inotify_event *event = (struct inotify_event *) p;
+            if(event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF))
             {
-                jobs[j].pid_no = jobs[j+1].pid_no;
-                jobs[j].runningStatus = jobs[j+1].runningStatus;
-                jobs[j].task_no = jobs[j+1].task_no;
-                jobs[j].line = strdup(jobs[j+1].line);
+                // events were lost or a whole directory went away, start over on the next completion
+                freeCommandTrie(trie);
+                return;
             }
-            jobs[*activeJobsSize-1].pid_no = 0;
-            jobs[*activeJobsSize-1].runningStatus = STOPPED;
-            jobs[*activeJobsSize-1].task_no = 0;
-            jobs[*activeJobsSize-1].line = NULL;
-            (*activeJobsSize)--;
+            if(event->len > 0 && event->name[0] != '.')
+                recountCommand(trie, event->name);
         }
     }
     return;
 }
 
-// changes the status of a job in the jobs table in the event that it is stopped or restarted
-void setJobStatus(struct Job *jobs, int pid, int activeJobsSize, int runningStatus)
+// sets how many PATH directories provide name as an executable
+void recountCommand(struct CommandTrie *trie, char *name)
 {
-    for(int i=0; i<activeJobsSize; i++)
+    int count = isWordIn(name, completedBuiltIns());
+
+    for(int d=0; d<trie->dirCount; d++)
     {
-        if(jobs[i].pid_no == pid) jobs[i].runningStatus = runningStatus;
+        if(trie->dirFds[d] >= 0 && isExecutableAt(trie->dirFds[d], name, DT_UNKNOWN)) count++;
     }
+    int node = 0;
+    for(char *p = name; *p && node >= 0; p++)
+        node = findTrieChild(trie, node, *p);
+    // names that disappear keep their nodes with a count of 0, which completion skips
+    if(node < 0 && count > 0) node = addTrieName(trie, name);
+    if(node >= 0) trie->nodes[node].count = count;
     return;
 }
 
-// kills all process in the jobs table in the event that the shell is killed with ctrl + d
-void killProcs(struct Job *jobs, int *activeJobsSize)
+// returns the NULL terminated list of built ins offered as commands by completion
+char **completedBuiltIns(void)
 {
-    for(int i=0; i<*activeJobsSize; i++)
+    static char *builtIns[] = {BUILT_IN_BG, BUILT_IN_FG, BUILT_IN_JOBS, BUILT_IN_PIPESIZE, BUILT_IN_CD, BUILT_IN_EXIT,
+                               BUILT_IN_EXPORT, BUILT_IN_UNSET, BUILT_IN_TRUE, BUILT_IN_FALSE, BUILT_IN_RETURN, NULL};
+    return builtIns;
+}
+
+// returns 1 if name in the directory is a regular file, or a link to one, that can be executed
+int isExecutableAt(int dirFd, char *name, unsigned char type)
+{
+    struct stat st;
+
+    if(type != DT_REG && type != DT_LNK && type != DT_UNKNOWN) return 0;
+    if(fstatat(dirFd, name, &st, 0) == -1 || !S_ISREG(st.st_mode)) return 0;
+    return faccessat(dirFd, name, X_OK, AT_EACCESS) == 0;
+}
+
+// releases the trie so it is built again on the next completion
+void freeCommandTrie(struct CommandTrie *trie)
+{
+    for(int d=0; d<trie->dirCount; d++)
     {
-        kill(-jobs[i].pid_no, SIGINT);
-        removeFromJobs(jobs, jobs[i].pid_no, activeJobsSize);
-        (*activeJobsSize)--;
+        if(trie->dirFds[d] >= 0) close(trie->dirFds[d]);
+        free(trie->dirs[d]);
     }
+    if(trie->inotifyFd >= 0) close(trie->inotifyFd);
+    free(trie->dirs);
+    free(trie->dirFds);
+    free(trie->watches);
+    free(trie->nodes);
+    free(trie->path);
+    memset(trie, 0, sizeof(struct CommandTrie));
+    return;
 }
 
-// checks if the input arguments contain an & as an argument
-int containsAmp(char **args)
+// collects the file names matching the word being completed, which may start with a directory. directories get a
+// trailing '/'. the directory is read with getdents64
+void completeFilename(char *word, struct Candidates *candidates)
 {
-    int argCount = countArgs(args);
-    for (int i=0; i<argCount; i++)
+    struct DirReader reader;
+    struct LinuxDirent64 *entry;
+    char buffer[DIR_BUFFER_SIZE] __attribute__((aligned(8)));
+    char *slash = strrchr(word, '/');
+    char *prefix = slash ? slash + 1 : word;
+    size_t prefixLength = strlen(prefix);
+    char *dir;
+
+    if(!slash)
+        dir = strdup(".");
+    else if(word[0] == '~' && word + 1 == slash && getenv("HOME"))
+        dir = strdup(getenv("HOME"));
+    else
+        dir = strndup(word, slash - word + 1);
+
+    reader.fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    reader.length = 0;
+    reader.offset = 0;
+    reader.buffer = buffer;
+    free(dir);
+    if(reader.fd < 0) return;
+    while((entry = nextDirEntry(&reader)) != NULL)
     {
-        if(strstr(args[i],"&")) return 1;
+        char *name = entry->d_name;
+        if(strncmp(name, prefix, prefixLength) != 0) continue;
+        if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || (name[0] == '.' && prefix[0] != '.')) continue;
+
+        struct stat st;
+        int isDir = entry->d_type == DT_DIR ||
+                    ((entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) &&
+                     fstatat(reader.fd, name, &st, 0) == 0 && S_ISDIR(st.st_mode));
+        addCandidate(candidates, name, strlen(name));
+        if(isDir)
+        {
+            char **added = &candidates->names[candidates->count - 1];
+            *added = realloc(*added, strlen(name) + 2);
+            strcat(*added, "/");
+        }
     }
-    return 0;
+    close(reader.fd);
+    qsort(candidates->names, candidates->count, sizeof(char*), compareNames);
+    return;
 }
 
-// removes the most recent job from the jobs table in the event that the job was put in the table but killed before
-// the pid no was assigned
-void removeLastFromJobs(struct Job *jobs, int *activeJobsSize)
+// orders names for qsort
+int compareNames(const void *a, const void *b)
 {
-    jobs[*activeJobsSize-1].pid_no = 0;
-    jobs[*activeJobsSize-1].runningStatus = STOPPED;
-    jobs[*activeJobsSize-1].task_no = 0;
-    jobs[*activeJobsSize-1].line = NULL;
+    return strcmp(*(char **) a, *(char **) b);
+}
 
-    (*activeJobsSize)--;
-    return;
+// returns the next entry of the directory being read, filling the reader's buffer with getdents64 as it empties.
+// returns NULL at the end of the directory or on an error
+struct LinuxDirent64 *nextDirEntry(struct DirReader *reader)
+{
+    if(reader->offset >= reader->length)
+    {
+        reader->length = syscall(SYS_getdents64, reader->fd, reader->buffer, DIR_BUFFER_SIZE);
+        reader->offset = 0;
+        if(reader->length <= 0) return NULL;
+    }
+    struct LinuxDirent64 *entry = (struct LinuxDirent64 *) (reader->buffer + reader->offset);
+    reader->offset += entry->d_reclen;
+    return entry;
 }
 
-// removes the '&' from the input arguments so the path command can be executed
-void removeAmp(char **args)
+#ifdef YASH_ALLOC_STATS
+// the accounting wrappers reach the C library as (malloc) and so on, which the macros in helpers.h don't replace
+
+// built in allocs command. prints the calls and bytes of every call site over the session and for the previous
+// command line, with the blocks it allocated that are still live, most live bytes first. -r starts the session
+// counts over
+int yash_allocs(char **args)
 {
-    int argCount = countArgs(args);
-    if(strcmp(args[argCount-1],"&") == 0)
-        args[argCount-1] = NULL;
-    return;
+    int order[ALLOC_SITE_LIMIT];
+    int count = 0;
+    struct AllocSite total;
+
+    if(args[1] && strcmp(args[1], "-r") == 0)
+    {
+        for(int s=0; s<ALLOC_SITE_LIMIT; s++)
+        {
+            allocSites[s].calls = 0;
+            allocSites[s].bytes = 0;
+        }
+        return FINISHED_INPUT;
+    }
+    memset(&total, 0, sizeof(total));
+    for(int s=0; s<ALLOC_SITE_LIMIT; s++)
+    {
+        if(allocSites[s].function) order[count++] = s;
+    }
+    qsort(order, count, sizeof(int), compareSites);
+    printf("%-32s %10s %12s %8s %10s %8s %10s\n", "SITE", "CALLS", "BYTES", "LAST", "LAST BYTES", "LIVE", "LIVE BYTES");
+    for(int i=0; i<count; i++)
+    {
+        struct AllocSite *site = &allocSites[order[i]];
+        char name[64];
+        snprintf(name, sizeof(name), "%s:%d", site->function, site->line);
+        printf("%-32s %10ld %12lld %8ld %10lld %8ld %10lld\n", name, site->calls, site->bytes, site->lastCalls,
+               site->lastBytes, site->liveBlocks, site->liveBytes);
+        total.calls += site->calls;
+        total.bytes += site->bytes;
+        total.lastCalls += site->lastCalls;
+        total.lastBytes += site->lastBytes;
+        total.liveBlocks += site->liveBlocks;
+        total.liveBytes += site->liveBytes;
+    }
+    printf("%-32s %10ld %12lld %8ld %10lld %8ld %10lld\n", "total", total.calls, total.bytes, total.lastCalls,
+           total.lastBytes, total.liveBlocks, total.liveBytes);
+    return FINISHED_INPUT;
 }
 
-// checks if input arguments have a '<' symbol and returns the index of the symbol in the args array
-int containsInRedir(char **args)
+// orders call sites by live bytes, then by bytes allocated, largest first
+int compareSites(const void *a, const void *b)
 {
-    int symbolPos = -1; // return -1 if '<' is not in args
-    int argCount = countArgs(args);
+    struct AllocSite *siteA = &allocSites[*(const int *) a];
+    struct AllocSite *siteB = &allocSites[*(const int *) b];
 
-    for(int i=0; i<argCount; i++)
+    if(siteA->liveBytes != siteB->liveBytes) return siteA->liveBytes < siteB->liveBytes ? 1 : -1;
+    if(siteA->bytes != siteB->bytes) return siteA->bytes < siteB->bytes ? 1 : -1;
+    return 0;
+}
+
+// called before each command line is read: the counts of the line that just ran become the previous line's
+void startAllocLine(void)
+{
+    for(int s=0; s<ALLOC_SITE_LIMIT; s++)
     {
-        if(strcmp(args[i],"<") == 0)
-            symbolPos = i;
+        allocSites[s].lastCalls = allocSites[s].lineCalls;
+        allocSites[s].lastBytes = allocSites[s].lineBytes;
+        allocSites[s].lineCalls = 0;
+        allocSites[s].lineBytes = 0;
     }
+    return;
+}
 
-    return symbolPos;
+void *accountMalloc(size_t size, const char *function, int line)
+{
+    return recordBlock((malloc)(size), size, function, line);
 }
 
-// checks if input arguments have a '>' symbol and returns the index of the symbol in the args array
-int containsOutRedir(char **args)
+void *accountCalloc(size_t count, size_t size, const char *function, int line)
 {
-    int symbolPos = -1; // return -1 if '<' is not in args
-    int argCount = countArgs(args);
+    return recordBlock((calloc)(count, size), count * size, function, line);
+}
 
-    for(int i=0; i<argCount; i++)
+// a block that moves is counted as freed and allocated again at the realloc's call site
+// the old block leaves the table before realloc can free it, and goes back as it was when realloc fails
+void *accountRealloc(void *pointer, size_t size, const char *function, int line)
+{
+    struct AllocBlock old = {NULL, 0, 0};
+
+    if(pointer && allocBlockCapacity > 0) old = *findBlock(pointer);
+    if(pointer) forgetBlock(pointer);
+    void *moved = (realloc)(pointer, size);
+    if(!moved && size > 0)
     {
-        if(strcmp(args[i],">") == 0)
-            symbolPos = i;
+        if(old.pointer) restoreBlock(&old);
+        return NULL;
     }
+    return recordBlock(moved, size, function, line);
+}
 
-    return symbolPos;
+char *accountStrdup(const char *text, const char *function, int line)
+{
+    return recordBlock((strdup)(text), strlen(text) + 1, function, line);
 }
 
-// removes the redirect argument and the next argument in the array. assumes the next argument is the name of the file
-// any additional input in the args command will not be recognized by path command
-void removeRedirArgs(char **args, int redirIndex)
+char *accountStrndup(const char *text, size_t length, const char *function, int line)
 {
-    args[redirIndex] = NULL;
-    args[redirIndex + 1] = NULL;
+    char *copy = (strndup)(text, length);
+
+    return recordBlock(copy, copy ? strlen(copy) + 1 : 0, function, line);
+}
+
+// blocks the C library allocated itself are not in the table and are just freed
+void accountFree(void *pointer)
+{
+    if(!pointer) return;
+    forgetBlock(pointer);
+    (free)(pointer);
     return;
 }
 
-// set stdout to go to file specified by the writeFilePointer
-int setRedirOut(char **args, int redirOut, FILE *writeFilePointer, int argCount)
+// counts a new block under its call site and adds it to the table of live blocks. returns pointer
+void *recordBlock(void *pointer, size_t size, const char *function, int line)
 {
-    if (redirOut + 1 < argCount)
+    if(!pointer) return NULL;
+    int s = findAllocSite(function, line);
+    if(s < 0) return pointer;
+
+    struct AllocSite *site = &allocSites[s];
+    site->calls++;
+    site->bytes += size;
+    site->lineCalls++;
+    site->lineBytes += size;
+    site->liveBlocks++;
+    site->liveBytes += size;
+    insertBlock(pointer, size, s);
+    return pointer;
+}
+
+// puts a block taken out by forgetBlock back in the table and on its call site's live count, without counting it as
+// a new allocation
+void restoreBlock(struct AllocBlock *block)
+{
+    allocSites[block->site].liveBlocks++;
+    allocSites[block->site].liveBytes += block->size;
+    insertBlock(block->pointer, block->size, block->site);
+    return;
+}
+
+// adds a block to the table of live blocks, growing the table first when needed
+void insertBlock(void *pointer, size_t size, int s)
+{
+    // the table is kept at most half full so probe runs stay short
+    if((allocBlockCount + 1) * 2 > allocBlockCapacity)
     {
-        writeFilePointer = fopen(args[redirOut + 1], "w+");
-        if (writeFilePointer)
+        struct AllocBlock *old = allocBlocks;
+        size_t oldCapacity = allocBlockCapacity;
+        allocBlockCapacity = oldCapacity ? oldCapacity * 2 : ALLOC_BLOCKS_INITIAL;
+        allocBlocks = (calloc)(allocBlockCapacity, sizeof(struct AllocBlock));
+        if(!allocBlocks)
         {
-            dup2(fileno(writeFilePointer), STDOUT_FILENO);
-            removeRedirArgs(args, redirOut);
-        } else
+            fprintf(stderr, "yash: allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        for(size_t i=0; i<oldCapacity; i++)
         {
-            fprintf(stderr, "Cannot open file %s\n", args[redirOut + 1]);
-            return -1; // return -1 as error value
+            if(old[i].pointer) *findBlock(old[i].pointer) = old[i];
         }
-    } else
-    {
-        fprintf(stderr, "Invalid Expression\n");
-        return -1; // return -1 as error value
+        (free)(old);
     }
-
-    return 1; // Finished without error
+    struct AllocBlock *block = findBlock(pointer);
+    block->pointer = pointer;
+    block->size = size;
+    block->site = s;
+    allocBlockCount++;
+    return;
 }
 
-int setRedirIn(char **args, int redirIn, FILE *readFilePointer, int argCount)
+// takes a block out of the table of live blocks and off its call site's live count. returns its size, or 0 for a
+// block that isn't in the table
+size_t forgetBlock(void *pointer)
 {
-    if (redirIn + 1 < argCount)
+    if(allocBlockCapacity == 0) return 0;
+    struct AllocBlock *block = findBlock(pointer);
+    if(!block->pointer) return 0;
+
+    size_t size = block->size;
+    allocSites[block->site].liveBlocks--;
+    allocSites[block->site].liveBytes -= size;
+    allocBlockCount--;
+
+    // later blocks of the probe run are moved back into the hole unless their home slot lies after it
+    size_t mask = allocBlockCapacity - 1;
+    size_t hole = block - allocBlocks;
+    size_t next = hole;
+    block->pointer = NULL;
+    while(allocBlocks[next = (next + 1) & mask].pointer)
     {
-        readFilePointer = fopen(args[redirIn + 1], "r");
-        if (readFilePointer)
-        {
-            dup2(fileno(readFilePointer), STDIN_FILENO);
-            removeRedirArgs(args, redirIn);
-        } else
+        size_t home = hashBlock(allocBlocks[next].pointer);
+        if(((next - home) & mask) >= ((next - hole) & mask))
         {
-            fprintf(stderr, "Cannot open file %s\n", args[redirIn + 1]);
-            return -1;
+            allocBlocks[hole] = allocBlocks[next];
+            allocBlocks[next].pointer = NULL;
+            hole = next;
         }
-    } else
+    }
+    return size;
+}
+
+// returns the index of the entry for a call site, adding it on first use, or -1 when the table is full
+int findAllocSite(const char *function, int line)
+{
+    int s = line % ALLOC_SITE_LIMIT;
+
+    for(int probes=0; probes<ALLOC_SITE_LIMIT; probes++, s = (s + 1) % ALLOC_SITE_LIMIT)
     {
-        fprintf(stderr, "Invalid Expression\n");
-        return -1;
+        if(!allocSites[s].function)
+        {
+            allocSites[s].function = function;
+            allocSites[s].line = line;
+            return s;
+        }
+        if(allocSites[s].line == line && strcmp(allocSites[s].function, function) == 0) return s;
     }
+    return -1;
+}
 
-    return 1;
+// returns the table entry holding pointer, or the empty entry where it would go
+struct AllocBlock *findBlock(void *pointer)
+{
+    size_t mask = allocBlockCapacity - 1;
+    size_t i = hashBlock(pointer);
+
+    while(allocBlocks[i].pointer && allocBlocks[i].pointer != pointer)
+        i = (i + 1) & mask;
+    return &allocBlocks[i];
+}
+
+// home slot of a block in the table. the low bits of an address are the same for every block, so they are mixed in
+// from above
+size_t hashBlock(void *pointer)
+{
+    uint64_t key = (uint64_t) (uintptr_t) pointer;
+
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t) key & (allocBlockCapacity - 1);
+}
+#else
+// built in allocs command, which needs a build with allocation accounting
+int yash_allocs(char **args)
+{
+    (void) args;
+    fprintf(stderr, "yash: allocs: built without allocation accounting, configure with -DYASH_ALLOC_STATS=ON\n");
+    lastStatus = 1;
+    return FINISHED_INPUT;
+}
+
+void startAllocLine(void)
+{
+    return;
 }
+#endif
@@ -0,0 +1,45 @@
+#!/bin/sh
+# long soak test. runs a mix of built ins, expansions, functions, subshells and reads tens of thousands of times in
+# one shell and fails if its resident size or, in a build with allocation accounting, its count of live blocks keeps
+# growing after the first rounds
+# usage: alloc_soak.sh YASH [ROUNDS_PER_PASS [PASSES]]
+# SOAK_ROUNDS and SOAK_PASSES in the environment set the same counts. a round runs about 170 commands, so
+# SOAK_ROUNDS=1000 makes the six passes run about a million
+
+yash=$1
+rounds=${2:-${SOAK_ROUNDS:-100}}
+passes=${3:-${SOAK_PASSES:-5}}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+printf 'one:two three\n' > "$dir/line"
+
+list=$(seq -s ' ' 1 "$rounds")
+allocs=
+"$yash" --norc -c allocs > /dev/null 2>&1 && allocs="allocs | grep '^total';"
+# each pass prints the shell's resident size and, when allocs works, the live block count from its total line
+cat > "$dir/soak" <<EOF
+round() { x=\$1; y="\${x}abc"; z=\${y%c}; case \$z in *b) : ;; esac; (v=\$x; : \$v); w=\$((x * 2)); }
+reader() { read a b < $dir/line; IFS=: read c d < $dir/line; unset a b c d; }
+measure() { grep VmRSS /proc/\$\$/status; $allocs }
+for p in $(seq -s ' ' 0 "$passes"); do
+    for a in $list; do
+        for b in 1 2 3 4 5 6 7 8 9 10; do round \$a\$b; reader; g() { echo \$1 > /dev/null; }; g \$b; done
+    done
+    measure
+done
+EOF
+
+"$yash" --norc "$dir/soak" > "$dir/out" 2>&1
+# the first pass warms up, after that neither number may grow by more than a little from pass to pass
+awk -v rounds="$rounds" '
+    /^VmRSS:/ { rss[++r] = $2 }
+    /^total/ { live[++l] = $(NF - 1) }
+    END {
+        if(r < 3) { print "soak: missing measurements"; exit 1 }
+        printf "%d passes of %d rounds, about %d commands, rss %d kB -> %d kB", r, rounds, r * rounds * 170, rss[2],
+               rss[r]
+        if(l >= 3) printf ", live blocks %d -> %d", live[2], live[r]
+        printf "\n"
+        if(rss[r] - rss[2] > 256) { print "soak: resident size keeps growing"; exit 1 }
+        if(l >= 3 && live[l] != live[2]) { print "soak: live blocks keep growing"; exit 1 }
+    }' "$dir/out"
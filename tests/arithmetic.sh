@@ -0,0 +1,23 @@
+#!/bin/sh
+# $(( )) arithmetic tests. checks operators, assignments and how variables are read, and that a variable that isn't a
+# number fails the expansion the way a division by zero does
+# usage: arithmetic.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+failed=0
+
+check "operators" "7 1 -4 1 8" 'echo $((1 + 2 * 3)) $((7 % 3)) $((-2 << 1)) $((3 > 2 && 0 <= 1)) $((1 ? 8 : 9))'
+check "assignments" "5 6 6 12" 'x=5; echo $((x++)) $x $((x)) $((x *= 2))'
+check "variables" "1 8 31 -2 1" 'e=; s=" 4 "; h=0x1f; n=-3; echo $((e + 1)) $((s * 2)) $((h)) $((n + 1)) $((unset + 1))'
+check "division by zero" "yash: arithmetic: division by zero
+1" 'echo $((1 / 0)); echo $?'
+check "not a number" "yash: arithmetic: x: 'abc' is not a number
+1" 'x=abc; echo $((x + 1)); echo $?'
+check "trailing garbage" "yash: arithmetic: x: '12abc' is not a number
+1" 'x=12abc; echo $((x)); echo $?'
+check "not a number left alone" "yash: arithmetic: x: 'abc' is not a number
+abc" 'x=abc; : $((x += 1)); echo $x'
+check "not a number not evaluated" "0" 'x=abc; echo $((0 && x))'
+
+exit $failed
@@ -0,0 +1,58 @@
+#!/bin/sh
+# job board tests. reads the board of a yash --board shell with board_reader, checks that it is removed on exit, that
+# a second shell doesn't take over a live board or an object that isn't one but does replace a board left behind,
+# and that a reader copying the board while jobs start and finish never sees a torn copy
+# usage: board.sh YASH BOARD_READER
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+reader=$2
+board=/yash-board-test-$$
+shell=
+dir=$(mktemp -d)
+trap '[ -n "$shell" ] && kill $shell; rm -rf "$dir"; rm -f /dev/shm$board' EXIT
+cd "$dir" || exit 1
+failed=0
+
+check "jobs on the board" "running sleep 0.5 &
+running $reader $board dump" "sleep 0.5 & $reader $board dump; wait" --board $board
+[ -e /dev/shm$board ] && { echo "the board was left behind on exit"; failed=1; }
+
+# a live board stays with its shell
+"$yash" --norc --board $board -c 'sleep 2; true' &
+shell=$!
+n=0
+while [ ! -e /dev/shm$board ] && [ $n -lt 100 ]; do
+    sleep 0.05
+    n=$((n + 1))
+done
+report "live board" "yash: $board: in use by another shell or not a job board
+2" "$("$yash" --norc --board $board -c 'echo ran' 2>&1; echo $?)"
+check "live board kept" "running sleep 2" "$reader $board dump"
+kill -9 $shell
+wait $shell 2> /dev/null
+shell=
+# the board of a killed shell is replaced, anything else isn't
+check "board left behind" "ran" 'echo ran' --board $board
+echo data > /dev/shm$board
+report "not a board" "yash: $board: in use by another shell or not a job board
+2 data" "$("$yash" --norc --board $board -c 'echo ran' 2>&1; echo $? $(cat /dev/shm$board))"
+rm -f /dev/shm$board
+
+# jobs start and finish as fast as the shell can while the reader copies the board
+seq 1 2000 | tr '\n' ' ' > items
+"$reader" $board watch 3 > watched &
+watcher=$!
+"$yash" --norc --board $board -c 'read -r list < items; for i in $list; do sh -c "sleep 0.2" & true; done; wait'
+if ! wait $watcher; then
+    echo "the reader saw a torn copy"
+    failed=1
+fi
+versions=$(sed 's/.* \([0-9]*\) versions.*/\1/' watched)
+echo "seqlock, $(cat watched)"
+if [ "${versions:-0}" -lt 20 ]; then
+    echo "the reader only saw ${versions:-0} versions of the board"
+    failed=1
+fi
+
+exit $failed
@@ -0,0 +1,121 @@
+//
+// job board reader for board.sh. board_reader NAME dump maps the yash --board object NAME and prints one line per job
+// as its state and command line. board_reader NAME watch SECONDS copies the board over and over for SECONDS the way a
+// monitor would, checks every copy for a torn read and prints how many copies and distinct versions it saw. exits 1
+// if the board can't be read or a copy isn't consistent
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "yash_board.h"
+
+// copies the board into copy under its seqlock, giving the processor back to the shell while it is writing. returns
+// the even sequence of the copy
+static uint32_t readBoard(struct JobBoard *board, struct JobBoard *copy, long *retries)
+{
+    for(;;)
+    {
+        uint32_t before = __atomic_load_n(&board->sequence, __ATOMIC_ACQUIRE);
+        if(before % 2 == 0)
+        {
+            memcpy(copy, board, sizeof(*copy));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if(__atomic_load_n(&board->sequence, __ATOMIC_RELAXED) == before) return before;
+        }
+        (*retries)++;
+        sched_yield();
+    }
+}
+
+// returns NULL if the copy is consistent, otherwise what is wrong with it. every job the test starts is a background
+// job whose first process leads its process group, so a slot mixing two jobs shows up as pid, pgid and pids[0]
+// disagreeing
+static char *checkBoard(struct JobBoard *copy)
+{
+    if(copy->count < 0 || copy->count > BOARD_SLOTS || copy->count > copy->total) return "bad count";
+    if(copy->count != (copy->total < BOARD_SLOTS ? copy->total : BOARD_SLOTS)) return "count doesn't match total";
+    for(int i=0; i<copy->count; i++)
+    {
+        struct BoardSlot *slot = &copy->slots[i];
+        if(slot->state < BOARD_RUNNING || slot->state > BOARD_TIMED_OUT) return "bad state";
+        if(memchr(slot->line, '\0', sizeof(slot->line)) == NULL) return "line not terminated";
+        if(slot->procCount > 0 && slot->pids[0] != slot->pid) return "pid and pids[0] differ";
+        if(slot->procCount > 0 && strncmp(slot->line, "sh -c", 5) == 0 && slot->pgid != slot->pid)
+            return "pid and pgid differ";
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3 || (strcmp(argv[2], "dump") != 0 && (strcmp(argv[2], "watch") != 0 || argc != 4)))
+    {
+        fprintf(stderr, "usage: board_reader NAME dump | board_reader NAME watch SECONDS\n");
+        return 2;
+    }
+    // the shell may not have created the board yet
+    int fd = -1;
+    struct stat info;
+    for(int tries=0; tries<500; tries++)
+    {
+        fd = shm_open(argv[1], O_RDONLY, 0);
+        if(fd >= 0 && fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(struct JobBoard)) break;
+        if(fd >= 0) close(fd);
+        fd = -1;
+        usleep(10000);
+    }
+    if(fd == -1)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    struct JobBoard *board = mmap(NULL, sizeof(struct JobBoard), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(board == MAP_FAILED || memcmp(board->magic, BOARD_MAGIC, sizeof(board->magic)) != 0 ||
+       board->version != BOARD_VERSION)
+    {
+        fprintf(stderr, "board_reader: %s is not a job board\n", argv[1]);
+        return 1;
+    }
+
+    static struct JobBoard copy;
+    long retries = 0;
+    if(strcmp(argv[2], "dump") == 0)
+    {
+        static char *states[] = {"", "running", "stopped", "done", "timed out"};
+        readBoard(board, &copy, &retries);
+        for(int i=0; i<copy.count; i++)
+            printf("%s %s\n", states[copy.slots[i].state], copy.slots[i].line);
+        return 0;
+    }
+
+    struct timespec start, now;
+    double seconds = atof(argv[3]);
+    long copies = 0, versions = 0;
+    uint32_t last = 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do
+    {
+        uint32_t sequence = readBoard(board, &copy, &retries);
+        char *problem = checkBoard(&copy);
+        if(problem)
+        {
+            fprintf(stderr, "board_reader: torn copy at sequence %u: %s\n", sequence, problem);
+            return 1;
+        }
+        copies++;
+        if(sequence != last) versions++;
+        last = sequence;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while((double) (now.tv_sec - start.tv_sec) + (double) (now.tv_nsec - start.tv_nsec) / 1e9 < seconds);
+    printf("%ld copies, %ld versions, %ld retries\n", copies, versions, retries);
+    return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+# loaded built in tests. loads the greet built in from tests/greet.c and checks its output, status and redirections
+# usage: builtin.sh YASH LIBRARY
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+library=$2
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+printf 'in\n' > input
+
+# every script loads greet first
+prelude="enable -f $library greet; "
+
+check "output" "hello x" 'greet x'
+check "variables" "hi x
+x" 'GREETING=hi; greet x; echo $GREETED'
+check "status" "greet: usage: greet NAME
+2" 'greet; echo $?'
+check "output redirected" "0
+hello x" 'greet x > out; echo $?; cat out'
+check "redirected among arguments" "hello x" 'greet > out x; cat out'
+check "input redirected" "hello x" 'greet x < input'
+check "output restored" "after" 'greet x > out; echo after'
+check "unopenable file" "Cannot open file missing/out
+1" 'greet x > missing/out; echo $?'
+check "in a pipeline" "hello x" 'greet x | cat'
+
+exit $failed
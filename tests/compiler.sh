@@ -0,0 +1,81 @@
+#!/bin/sh
+# compiler tests. runs small scripts through the bytecode compiler and checks what they print and the files they leave
+# usage: compiler.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+
+# operators only act when they were written unquoted
+check "quoted redirection" "> q
+no q" 'echo ">" q; test -e q && echo q || echo no q'
+check "quoted pipe" "a | wc -c" 'echo a "|" wc -c'
+check "expanded redirection" "> f
+no f" 'x=">"; echo $x f; test -e f && echo f || echo no f'
+check "expanded pipe" "a | cat" 'p="|"; echo a $p cat'
+check "quoted input redirection" "< in" 'echo "<" in'
+check "quoted fan out" "a |+ cat" "echo a '|+' cat"
+check "pipe" "3" 'echo hi | wc -c'
+check "fan out" "a
+a" 'echo a |+ cat |+ cat'
+check "redirections" "out" 'echo out > file; cat < file'
+check "function redirection" "in f" 'f(){ echo in f; }; f > fo; cat fo'
+check "group redirection" "2" '{ echo g; echo h; } > go; cat < go | wc -l'
+
+# control flow
+check "for" "1
+2
+3" 'for i in 1 2 3; do echo $i; done'
+check "for pipe" "1
+2" 'for i in 1 2; do echo $i | cat; done'
+check "while" "0
+1
+2" 'i=0; while test $i -lt 3; do echo $i; i=$((i+1)); done'
+check "break continue" "1
+3" 'for i in 1 2 3 4; do if test $i = 2; then continue; fi; if test $i = 4; then break; fi; echo $i; done'
+check "if else" "no" 'if false; then echo yes; else echo no; fi'
+check "elif" "two" 'x=2; if test $x = 1; then echo one; elif test $x = 2; then echo two; fi'
+check "and or" "b
+c" 'false && echo a; true && echo b; false || echo c'
+check "case" "fruit" 'x=apple; case $x in carrot) echo veg;; a*) echo fruit;; esac'
+check "case quoted pattern" "star" 'x="*"; case $x in "*") echo star;; *) echo other;; esac'
+check "function arguments" "b a" 'f(){ echo $2 $1; }; f a b'
+check "function return" "3" 'f(){ return 3; echo no; }; f; echo $?'
+check "subshell" "in
+out" 'x=out; (x=in; echo $x); echo $x'
+check "break in subshell" "1
+2
+3" 'for i in 1 2 3; do (break); echo $i; done'
+check "continue in subshell" "no
+a" 'for i in a; do (continue; echo no); echo $i; done'
+check "function in subshell" "$dir
+x=" 'f(){ cd /; x=1; }; (f); pwd; echo "x=$x"'
+check "return in subshell" "after 3" 'f(){ (return 3); echo after $?; }; f'
+check "expanded command in subshell" "$dir" 'g(){ cd /; }; h=g; ($h); pwd'
+check "arithmetic in subshell" "0" 'i=0; (: $((i=7))); echo $i'
+check "arithmetic case word in subshell" "0" 'i=0; (case $((i=7)) in *) ;; esac); echo $i'
+
+# compound commands as pipeline stages, each stage in a child of its own
+check "loop reading a pipe" "<a>
+<b>" 'printf "a\nb\n" | while read l; do echo "<$l>"; done'
+check "group reading a pipe" "2 1" 'printf "1\n2\n" | { read a; read b; echo "$b $a"; }'
+check "group writing a pipe" "y
+x" '{ echo x; echo y; } | sort -r'
+check "loop between commands" "N1
+N2" 'for i in 1 2; do echo $i; done | while read n; do echo "n$n"; done | tr n N'
+check "if as a stage" "yes" 'if true; then echo yes; fi | cat'
+check "status of the last stage" "1 0" 'echo a | { false; }; a=$?; ! echo a | { false; }; echo $a $?'
+check "stage state stays in the stage" "x=1
+$dir" 'x=1; echo / | { read x; cd $x; }; echo "x=$x"; pwd'
+check "stage redirection" "a" 'echo a | { cat; } > out; cat out'
+check "background pipe" "fg
+bg" '{ sleep 0.2; echo bg; } | cat & echo fg; wait'
+check "newline after the pipe" "a" 'echo a |
+{ cat; }'
+check "function piped" "yash: syntax error near '|'" 'f() { echo a; } | cat'
+check "stage missing" "yash: syntax error near '}'" '{ echo a; } | }'
+
+exit $failed
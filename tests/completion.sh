@@ -0,0 +1,42 @@
+#!/bin/sh
+# completion tests. types lines with TABs into an interactive yash on a terminal made by script, and checks that
+# commands are completed from PATH, that the completions follow executables being created, removed and chmod'ed
+# while the shell runs, and that file names are completed
+# usage: completion.sh YASH
+
+yash=$1
+command -v script > /dev/null || { echo "completion: script is not installed, skipped"; exit 0; }
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+mkdir bin
+printf '#!/bin/sh\necho ran ${0##*/}\n' > bin/yashtestcmd
+chmod +x bin/yashtestcmd
+echo notes > notes.txt
+echo one > alpha_one
+echo two > alpha_two
+
+# each line is sent on its own after the one before it has run, so the commands changing bin are done before the
+# next TAB
+{
+    for line in 'yashtest\t' 'cp bin/yashtestcmd bin/yashnewcmd' 'yashnew\t' \
+        'rm bin/yashnewcmd; cp bin/yashtestcmd bin/yashnewercmd' 'yashnew\t' 'chmod -x bin/yashtestcmd' 'yashtes\t' \
+        'chmod +x bin/yashtestcmd' 'yashtes\t' 'cat notes.t\t' 'cat alp\to\t' 'exit'; do
+        sleep 0.3
+        printf "$line\n"
+    done
+} | PATH=$dir/bin:$PATH script -qfec "$yash --norc" /dev/null | tr -d '\r' | grep -v '^# \|^$' > got
+
+cat > expected <<'EOF2'
+ran yashtestcmd
+ran yashnewcmd
+ran yashnewercmd
+Problem executing command: No such file or directory
+ran yashtestcmd
+notes
+one
+EOF2
+if ! cmp -s expected got; then
+    printf 'completion: expected\n%s\ngot\n%s\n' "$(cat expected)" "$(cat got)"
+    exit 1
+fi
@@ -0,0 +1,40 @@
+#!/bin/sh
+# ${} expansion tests. checks each pattern, replacement and slice operator on set, empty and unset values
+# usage: expansion.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+failed=0
+
+check "length" "5 0 0" 'v=hello; e=; echo ${#v} ${#e} ${#unset}'
+check "length of positionals" "3 3" 'f(){ echo ${#@} ${#*}; }; f a b c'
+check "shortest prefix" "b.c" 'v=a.b.c; echo ${v#*.}'
+check "longest prefix" "c" 'v=a.b.c; echo ${v##*.}'
+check "shortest suffix" "a.b" 'v=a.b.c; echo ${v%.*}'
+check "longest suffix" "a" 'v=a.b.c; echo ${v%%.*}'
+check "literal prefix and suffix" "cabc abca abcabc abcabc" 'v=abcabc; echo ${v#ab} ${v%bc} ${v#x} ${v%x}'
+check "whole value removed" "<><>" 'v=abc; echo "<${v#abc}><${v%%*}>"'
+check "bracket pattern" "file4 file ile42" 'v=file42; echo ${v%[0-9]} ${v%%[0-9]*} ${v#[a-f]}'
+check "question mark" "cd abc" 'v=abcd; echo ${v#??} ${v%?}'
+check "quoted pattern" "b b" 'v="a*b"; echo ${v#"a*"} ${v#a\*}'
+check "pattern from a variable" "b.c c" 'v=a.b.c p="*."; echo ${v#$p} ${v##$p}'
+check "replace first" "bANana" 'v=banana; echo ${v/an/AN}'
+check "replace every" "bANANa" 'v=banana; echo ${v//an/AN}'
+check "replace at start" "Xnana banana" 'v=banana; echo ${v/#ba/X} ${v/#an/X}'
+check "replace at end" "banaX banana" 'v=banana; echo ${v/%na/X} ${v/%an/X}'
+check "replace with pattern" "bXa _a_a_a" 'v=banana; echo ${v/a*n/X} ${v//[bn]/_}'
+check "delete matches" "bnana bnn" 'v=banana; echo ${v/a} ${v//a}'
+check "empty pattern" "<abc><abc><abc>" 'v=abc; echo "<${v/}><${v//}><${v//x}>"'
+check "empty anchored pattern" "Pabc abcS" 'v=abc; echo ${v/#/P} ${v/%/S}'
+check "empty anchored pattern on empty value" "<P><S>" 'e=; echo "<${e/#/P}><${e/%/S}>"'
+check "every empty match" "<X>" 'v=abc; echo "<${v//*/X}>"'
+check "slice" "cdef bcd x" 'v=abcdef; echo ${v:2} ${v:1:3} ${v:0:0}x'
+check "negative slice" "ef bcd de" 'v=abcdef; echo ${v: -2} ${v:1:-2} ${v: -3:2}'
+check "slice arithmetic" "cde cdef" 'v=abcdef; n=2; echo ${v:n:n+1} ${v:$n}'
+check "slice out of range" "<><bc>" 'v=abc; echo "<${v:5}><${v:1:10}>"'
+check "unset parameter" "<><><>" 'echo "<${u#a}><${u/a/b}><${u:1}>"'
+check "positional parameter" "hello heLlo.c" 'f(){ echo ${1%.c} ${1/l/L}; }; f hello.c'
+check "double quotes keep spaces" "  b  c" 'v="a  b  c"; echo "${v#a}"'
+check "fields split unquoted" "b c" 'v="a  b  c"; echo ${v#a}'
+
+exit $failed
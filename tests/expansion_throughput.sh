@@ -0,0 +1,65 @@
+#!/bin/sh
+# parameter expansion benchmark. times string edits done with ${var...} in yash against the same edits done by sed,
+# once per item the way a script that forks sed for each value would, and once over one long line, and fails if
+# yash's output differs from sed's
+# usage: expansion_throughput.sh YASH [ITEMS] [MEGABYTES]
+
+yash=$1
+items=${2:-1000}
+megabytes=${3:-64}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+
+# elapsed START END NAME. prints the time between two date +%s.%N readings
+elapsed()
+{
+    awk -v name="$3" -v start="$1" -v end="$2" 'BEGIN { printf "%-34s %.3fs\n", name, end - start }'
+}
+
+# the directory, file name, stem, extension and length of every path, one at a time
+seq 1 "$items" | sed 's|.*|/usr/lib/pkg&/libitem&.so.&|' | tr '\n' ' ' > paths
+start=$(date +%s.%N)
+# echo isn't built in, so yash collects the results and prints them once
+"$yash" --norc -c 'read -r list < paths; out=; for p in $list; do f=${p##*/};
+    out="$out ${p%/*} $f ${f%%.*} ${f#*.} ${#p}"; done; echo $out' > yash.out
+end=$(date +%s.%N)
+elapsed "$start" "$end" "yash expansions, $items paths"
+start=$(date +%s.%N)
+for p in $(cat paths); do
+    f=$(printf '%s\n' "$p" | sed 's|.*/||')
+    echo $(printf '%s\n' "$p" | sed 's|/[^/]*$||') $f $(printf '%s\n' "$f" | sed 's|\..*||') \
+        $(printf '%s\n' "$f" | sed 's|^[^.]*\.||') $(printf '%s' "$p" | sed 's|.|.|g' | wc -c)
+done > sed.lines
+end=$(date +%s.%N)
+elapsed "$start" "$end" "sed for each path, $items paths"
+echo $(cat sed.lines) > sed.out
+if ! cmp -s yash.out sed.out; then
+    echo "paths: yash and sed differ"
+    cmp yash.out sed.out
+    failed=1
+fi
+
+# a literal replacement over one long line, which the vector search handles
+yes 'some text with a needle in it' | head -c $((megabytes * 1048576)) | tr '\n' ' ' > line
+echo >> line
+start=$(date +%s.%N)
+"$yash" --norc -c 'read -r l < line; echo ${#l}' > /dev/null
+end=$(date +%s.%N)
+elapsed "$start" "$end" "yash read alone, $megabytes MB"
+start=$(date +%s.%N)
+# an argument that long can't be passed to echo, so the check is the length and the start of the result
+"$yash" --norc -c 'read -r l < line; r=${l//needle/pin}; echo ${#r} ${r:0:1000}' > yash.out
+end=$(date +%s.%N)
+elapsed "$start" "$end" "yash \${l//needle/pin}, $megabytes MB"
+start=$(date +%s.%N)
+sed 's/needle/pin/g' line > sed.line
+end=$(date +%s.%N)
+elapsed "$start" "$end" "sed s/needle/pin/g, $megabytes MB"
+echo $(($(wc -c < sed.line) - 1)) $(head -c 1000 sed.line) > sed.out
+if ! cmp -s yash.out sed.out; then
+    echo "long line: yash and sed differ"
+    failed=1
+fi
+exit $failed
@@ -0,0 +1,38 @@
+#!/bin/sh
+# fan-out benchmark. copies a large transfer to two files with multios and to two consumers with |+, times each
+# against the same copy done by tee, and fails if an output doesn't get every byte
+# usage: fanout_throughput.sh YASH [MEGABYTES]
+
+yash=$1
+megabytes=${2:-1024}
+bytes=$((megabytes * 1048576))
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+
+# bench NAME EXPECTED SCRIPT. times SCRIPT and compares its output, followed by the sizes of the files a and b when
+# they exist, with EXPECTED
+bench()
+{
+    rm -f a b
+    start=$(date +%s.%N)
+    got=$("$yash" --norc -c "$3" 2>&1)
+    end=$(date +%s.%N)
+    for file in a b; do
+        [ -e $file ] && got="$got $(wc -c < $file)"
+    done
+    got=$(echo $got)
+    if [ "$got" != "$2" ]; then
+        echo "$1: expected '$2', got '$got'"
+        failed=1
+    fi
+    awk -v name="$1" -v mb="$megabytes" -v start="$start" -v end="$end" \
+        'BEGIN { printf "%-32s %6d MB in %.2fs, %.0f MB/s\n", name, mb, end - start, mb / (end - start) }'
+}
+
+bench "multios > a > b" "$bytes $bytes" "head -c $bytes /dev/zero > a > b"
+bench "| tee a > b" "$bytes $bytes" "head -c $bytes /dev/zero | tee a > b"
+bench "|+ wc -c |+ wc -c" "$bytes $bytes" "head -c $bytes /dev/zero |+ wc -c |+ wc -c"
+bench "| tee >(wc -c) > >(wc -c)" "$bytes $bytes" "head -c $bytes /dev/zero | tee >(wc -c) > >(wc -c)"
+exit $failed
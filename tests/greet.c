@@ -0,0 +1,23 @@
+//
+// loadable built in used by builtin.sh. greet NAME writes a greeting for NAME to its output and keeps NAME in the
+// shell variable GREETED
+//
+
+#include <stdio.h>
+#include "yash_builtin.h"
+
+static int greet(int argc, char **argv, int in, int out, int err, const struct YashShell *shell)
+{
+    (void) in;
+    if(argc != 2)
+    {
+        dprintf(err, "%s: usage: %s NAME\n", argv[0], argv[0]);
+        return 2;
+    }
+    const char *greeting = shell->getVar("GREETING");
+    dprintf(out, "%s %s\n", greeting ? greeting : "hello", argv[1]);
+    shell->setVar("GREETED", argv[1]);
+    return 0;
+}
+
+struct YashBuiltin yash_builtin_greet = {YASH_BUILTIN_ABI, "greet", greet};
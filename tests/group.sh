@@ -0,0 +1,37 @@
+#!/bin/sh
+# { } group and ( ) subshell tests. checks that a group changes the shell's own state and a subshell doesn't, and
+# that a subshell only forks when it holds something that would change that state
+# usage: group.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+
+check "cd in a group" "/" '{ cd /; }; pwd'
+check "cd in a subshell" "$dir" '( cd / ); pwd'
+check "assignment in a group" "<1>" '{ x=1; }; echo "<$x>"'
+check "assignment in a subshell" "<>" '(x=1); echo "<$x>"'
+check "export in a subshell" "<>" '(export Z=1); echo "<$Z>"'
+check "unset in a subshell" "<1>" 'y=1; (unset y); echo "<$y>"'
+check "function in a subshell" "Problem executing command: No such file or directory" '(f() { echo inner; }); f'
+report "exit in a group" "4" "$("$yash" --norc -c '{ exit 4; }; echo still here'; echo $?)"
+check "exit in a subshell" "3
+after" '(exit 3); echo $?; echo after'
+check "status of a group" "1" '{ false; }; echo $?'
+check "status of a subshell" "1" '(false); echo $?'
+check "group redirection" "a
+b" '{ echo a; echo b; } > o; cat o'
+check "subshell redirection" "a
+b" '(echo a; echo b) > o; cat o'
+check "background group" "bg" '{ sleep 0.1; echo bg > o; } & wait; cat o'
+
+# a command in the subshell prints its parent. the shell itself is the parent unless the subshell forked
+parent='sh -c "echo \$PPID" > parent; true); read -r p < parent; test "$p" = $$ && echo inline || echo forked'
+check "subshell without state runs inline" "inline" "(echo x > /dev/null; $parent"
+check "subshell with cd forks" "forked" "(cd .; $parent"
+check "subshell with an assignment forks" "forked" "(x=1; $parent"
+
+exit $failed
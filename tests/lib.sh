@@ -0,0 +1,18 @@
+# helpers shared by the test scripts, which source it with . "$(dirname "$0")/lib.sh" and set yash and failed=0
+
+# report NAME EXPECTED GOT. prints both and sets failed when GOT isn't EXPECTED
+report()
+{
+    if [ "$3" != "$2" ]; then
+        printf '%s: expected\n%s\ngot\n%s\n' "$1" "$2" "$3"
+        failed=1
+    fi
+}
+
+# check NAME EXPECTED SCRIPT [OPTION]... runs SCRIPT with -c, after the options and with $prelude in front of it, and
+# compares its output with EXPECTED
+check()
+{
+    # the options are taken in the command substitution, so no variable of the caller is touched
+    report "$1" "$2" "$(script=$3; shift 3; "$yash" --norc "$@" -c "$prelude$script" 2>&1)"
+}
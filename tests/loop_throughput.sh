@@ -0,0 +1,38 @@
+#!/bin/sh
+# loop benchmark. runs loop heavy scripts over 100k items with yash and with dash and bash where they are installed and
+# prints each shell's time, and fails if yash's output differs from theirs
+# usage: loop_throughput.sh YASH [ITEMS]
+
+yash=$1
+items=${2:-100000}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+seq 1 "$items" | tr '\n' ' ' > items
+
+# bench NAME SCRIPT. times SCRIPT under each shell and compares the outputs with yash's
+bench()
+{
+    expected=
+    for shell in "$yash" dash bash; do
+        command -v "$shell" > /dev/null || continue
+        start=$(date +%s.%N)
+        got=$("$shell" -c "$2" 2>&1)
+        end=$(date +%s.%N)
+        [ "$shell" = "$yash" ] && expected=$got
+        if [ "$got" != "$expected" ]; then
+            printf '%s: yash printed\n%s\n%s printed\n%s\n' "$1" "$expected" "$shell" "$got"
+            failed=1
+        fi
+        awk -v name="$1" -v shell="${shell##*/}" -v start="$start" -v end="$end" \
+            'BEGIN { printf "%-14s %-5s %.3fs\n", name, shell, end - start }'
+    done
+}
+
+bench "for" 'read -r list < items; n=0; for i in $list; do n=$((n + i)); done; echo $n'
+bench "while" "i=0; while :; do i=\$((i + 1)); case \$i in $items) break;; esac; done; echo \$i"
+bench "case and if" 'read -r list < items; n=0; for i in $list; do case $i in *7) n=$((n + 1));;
+    *3) if true; then n=$((n + 2)); else n=0; fi;; esac; done; echo $n'
+bench "function call" 'f() { n=$((n + $1)); }; read -r list < items; n=0; for i in $list; do f $i; done; echo $n'
+exit $failed
@@ -0,0 +1,31 @@
+#!/bin/sh
+# pipe throughput benchmark. pushes a large transfer through producer | consumer at each pipe capacity and prints the
+# rate, and fails if a size can't be set, a size past the system limit isn't clamped to it or the consumer doesn't get
+# every byte
+# usage: pipe_throughput.sh YASH [MEGABYTES]
+
+yash=$1
+megabytes=${2:-512}
+bytes=$((megabytes * 1048576))
+max=$(cat /proc/sys/fs/pipe-max-size 2>/dev/null || echo 1048576)
+
+# sizes too large for the system, or for a long once multiplied, end up at the limit
+for size in 4096M 99999999999999999999 9000000000000M; do
+    got=$("$yash" --norc -c "pipesize $size; pipesize" 2>&1)
+    if [ "$got" != "pipesize $max (max $max)" ]; then
+        echo "pipe size $size: expected the limit $max, got '$got'"
+        exit 1
+    fi
+done
+
+for size in default 64K 256K 1M auto; do
+    start=$(date +%s.%N)
+    got=$("$yash" --norc -c "YASH_PIPESIZE=$size head -c $bytes /dev/zero | wc -c")
+    end=$(date +%s.%N)
+    if [ "$got" != "$bytes" ]; then
+        echo "pipe size $size: consumer got '$got' bytes instead of $bytes"
+        exit 1
+    fi
+    awk -v size="$size" -v mb="$megabytes" -v start="$start" -v end="$end" \
+        'BEGIN { printf "%-8s %6d MB in %.2fs, %.0f MB/s\n", size, mb, end - start, mb / (end - start) }'
+done
@@ -0,0 +1,38 @@
+#!/bin/sh
+# two stage pipeline tests. checks that the rewritten forms of a pipeline give what the pipeline itself would, with and
+# without --norewrite
+# usage: pipeline.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+printf 'b\na\nc\n' > letters
+
+# check NAME EXPECTED SCRIPT. runs SCRIPT with -c, rewriting pipelines and not, and compares its output with EXPECTED
+check()
+{
+    for option in "" --norewrite; do
+        report "$1${option:+ $option}" "$2" "$("$yash" --norc $option -c "$3" 2>&1)"
+    done
+}
+
+check "cat input" "a
+b
+c" 'cat letters | sort'
+check "cat input status" "1" 'cat letters | grep -q z; echo $?'
+check "trailing cat" "a
+b
+c" 'sort letters | cat'
+check "trailing cat status" "0" 'false | cat; echo $?'
+check "built in producer" "3" 'echo one two three | wc -w'
+check "built in producer status" "1" 'echo x | false; echo $?'
+check "redirection only stage" "0 0" 'echo a | > out; a=$?; test -e out; echo $a $?'
+check "redirection only producer" "0" '> in | cat; echo $?'
+# the rewritten producer runs in the shell, so jobs sees the table but not the pipeline's own job
+report "jobs producer" "[1] + Running sleep 0.3 &
+No active jobs" "$("$yash" --norc -c 'sleep 0.3 & jobs | sed "s/  [0-9]*  / /"; wait; jobs | cat' 2>&1)"
+
+exit $failed
@@ -0,0 +1,33 @@
+#!/bin/sh
+# process substitution tests. checks <(cmd) and >(cmd) as arguments and redirection targets, in loops, functions and
+# background jobs, and that a command's status isn't taken from the processes substituted into it
+# usage: procsub.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+
+check "same inputs" "0" 'diff <(echo a) <(echo a); echo $?'
+check "different inputs" "1" 'diff <(echo a) <(echo b) > /dev/null; echo $?'
+check "two inputs" "one
+two" 'cat <(echo one) <(echo two)'
+check "a /dev/fd path" "1" 'echo <(true) | grep -c "^/dev/fd/[0-9]*$"'
+check "a list inside" "a
+b" 'cat <(echo a; echo b)'
+check "a pipeline inside" "a_b" 'cat <(echo "a b" | tr " " _)'
+check "nested" "nested" 'cat <(cat <(echo nested))'
+check "input redirection" "2" 'wc -l < <(printf "a\nb\n")'
+check "output redirection" "data" 'echo data > >(cat > out); cat out'
+check "output argument" "2" 'echo x | tee >(wc -c > count) > /dev/null; cat count'
+check "status of the command" "1 0" 'false <(true); a=$?; true <(false); echo $a $?'
+check "in a loop" "1
+2" 'for i in 1 2; do cat <(echo $i); done'
+check "in a function" "in f" 'f() { cat <(echo in f); }; f'
+check "expanded inside" "2" 'x=2; cat <(echo $x)'
+check "background job" "a" 'cat <(echo a) > bg &
+wait; cat bg'
+
+exit $failed
@@ -0,0 +1,44 @@
+#!/bin/sh
+# prompt helper tests. runs an interactive yash on a terminal made by script with a PS1 showing the git branch, where
+# git is slowed down, and checks that a command typed at the prompt runs without waiting for git, that the branch is
+# drawn into the prompt once it is known and follows changes to the tree, and that it is dropped on cd
+# usage: prompt.sh YASH
+
+yash=$1
+command -v script > /dev/null && command -v git > /dev/null || { echo "prompt: needs script and git, skipped"; exit 0; }
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+mkdir bin
+# every git call takes half a second and leaves a mark once it has started the real git
+printf '#!/bin/sh\nsleep 0.5\n: > %s/called\nexec %s "$@"\n' "$dir" "$(command -v git)" > bin/git
+chmod +x bin/git
+for repo in trunk other; do
+    git init -q -b $repo $repo
+    echo a > $repo/file
+    git -C $repo add file
+    git -C $repo -c user.name=t -c user.email=t@t commit -q -m file
+done
+
+# each line waits long enough for the helper to finish, except the one typed right after the prompt appears
+{
+    for line in "PS1='<\\g>\$ '" 'test -e ../called && echo waited for git || echo did not wait' 'echo b >> file' \
+        'cd ../other' 'exit'; do
+        case $line in
+            test*) sleep 0.1 ;;
+            *) sleep 2.5 ;;
+        esac
+        printf '%s\n' "$line"
+    done
+} | (cd trunk && PATH=$dir/bin:$PATH script -qfec "$yash --norc" /dev/null) > out
+
+grep -q 'did not wait' out || { echo "prompt: the command waited for git"; failed=1; }
+# every prompt drawn, in order. the first of each is drawn with what was known before and the helper redraws it
+got=$(grep -o '<[^>\]*>\$' out | tr '\n' ' ')
+expected='<>$ <>$ <trunk>$ <trunk>$ <trunk*>$ <>$ <other>$ '
+if [ "$got" != "$expected" ]; then
+    printf 'prompt: expected\n%s\ngot\n%s\n' "$expected" "$got"
+    failed=1
+fi
+exit $failed
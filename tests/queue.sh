@@ -0,0 +1,48 @@
+#!/bin/sh
+# queue built in tests. checks that queued commands are held while the job limit is reached and start in priority
+# order as jobs finish, that wait drains the queue, and, where the machine is busy enough to tell, that the load and
+# pressure limits hold commands back until they are raised
+# usage: queue.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+
+check "limits" "jobs 3  load 0.00  pressure 0.0%  queued 0" 'queue -j 3 -l 0 -P 0; queue'
+check "bad option" "yash: queue: usage: queue [-j JOBS] [-l LOAD] [-P PERCENT] [-p PRIORITY] [COMMAND [ARG ...]]
+2" 'queue -j x; echo $?'
+check "held at the job limit" "[1] + Running  sh -c sleep 0.3; echo a >> log
+[Q1]   Queued  p0  sh -c echo b >> log
+a
+b" 'queue -j 1 -l 0; queue sh -c "sleep 0.3; echo a >> log"; queue sh -c "echo b >> log"; jobs | sed "s/  [0-9]*  /  /"
+    wait; cat log; rm log'
+check "priority order" "[Q1]   Queued  p5  sh -c echo high >> log
+[Q2]   Queued  p1  sh -c echo low >> log
+first
+high
+low" 'queue -j 1 -l 0; queue sh -c "sleep 0.3; echo first >> log"; queue -p 1 sh -c "echo low >> log"
+    queue -p 5 sh -c "echo high >> log"; jobs | grep Q; wait; cat log; rm log'
+check "wait drains the queue" "3" 'queue -j 1 -l 0; for i in 1 2 3; do queue sh -c "echo $i >> log"; done; wait
+    wc -l < log'
+check "\$! is left alone" "<>" 'queue -j 1 -l 0; queue sh -c "exit 3"; echo "<$!>"; wait'
+
+# an idle machine has nothing to hold the commands back with, so these only run when the load or the pressure is up
+load=$(cut -d ' ' -f 1 /proc/loadavg)
+if awk -v load="$load" 'BEGIN { exit !(load >= 0.05) }'; then
+    check "held by the load" "[Q1]   Queued  p0  sh -c echo ran > f
+ran" 'queue -j 4 -l 0.01; queue sh -c "echo ran > f"; sleep 0.3; jobs; queue -l 0; wait; cat f'
+else
+    echo "load $load is too low to check the load limit, skipped"
+fi
+pressure=$(sed -n 's/^some avg10=\([0-9.]*\).*/\1/p' /proc/pressure/cpu 2> /dev/null)
+if [ -n "$pressure" ] && awk -v p="$pressure" 'BEGIN { exit !(p >= 0.05) }'; then
+    check "held by pressure" "[Q1]   Queued  p0  sh -c echo ran > f
+ran" 'queue -j 4 -l 0 -P 0.01; queue sh -c "echo ran > f"; sleep 0.3; jobs; queue -P 0; wait; cat f'
+else
+    echo "cpu pressure ${pressure:-unknown} is too low to check the pressure limit, skipped"
+fi
+
+exit $failed
@@ -0,0 +1,46 @@
+#!/bin/sh
+# read built in tests. reads prepared files and checks the variables it sets and its status
+# usage: read.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+
+printf '  lead  trail  \n' > spaces
+printf 'one two three four\n' > words
+printf '1:2:3\n' > colons
+printf 'a\\ b c\\\nd\n' > backslashes
+printf 'first\nsecond\nlast' > lines
+{ head -c 70000 /dev/zero | tr '\0' x; echo; } > long
+
+check "fields" "<one><two><three four>" 'read a b c < words; echo "<$a><$b><$c>"'
+check "more names than fields" "<one two three four><>" 'IFS=: read a b < words; echo "<$a><$b>"'
+check "reply" "<  lead  trail  >" 'read < spaces; echo "<$REPLY>"'
+check "leading and trailing whitespace" "<lead  trail>" 'read line < spaces; echo "<$line>"'
+check "empty IFS prefix" "<  lead  trail  >" 'IFS= read -r line < spaces; echo "<$line>"'
+check "IFS prefix" "<1><2:3>" 'IFS=: read a b < colons; echo "<$a><$b>"'
+check "IFS prefix restored" "<1:2:3>" 'IFS=: read a < colons; read b < colons; echo "<$b>"'
+check "IFS prefix keeps the old value" "<x>" 'IFS=x; IFS=: read a < colons; echo "<$IFS>"'
+check "backslashes" "<a b><cd>" 'read a b < backslashes; echo "<$a><$b>"'
+check "raw" "<a\\><b c\\>" 'read -r a b < backslashes; echo "<$a><$b>"'
+check "loop" "[first]
+[second]" 'while read -r line; do echo "[$line]"; done < lines'
+check "end of file" "1 <last>" '{ read a; read b; read c; echo $? "<$c>"; } < lines'
+check "empty input" "1 <>" 'read a < /dev/null; echo $? "<$a>"'
+check "invalid name" "yash: read: 1x: not a valid name
+2" 'read 1x < words; echo $?'
+
+# a loop or group that owns the pipe, which read looks ahead in without taking more than its line
+check "loop on a pipe" "[first]
+[second]" 'cat lines | while read -r line; do echo "[$line]"; done'
+check "group on a pipe" "<second><first>" 'cat lines | { read a; read b; echo "<$b><$a>"; }'
+check "rest of the pipe left" "second
+last" 'cat lines | { read a; cat; }'
+check "loop body reading the pipe" "<1><2>
+<3><4>" 'printf "1\\n2\\n3\\n4\\n" | while read a; do read b; echo "<$a><$b>"; done'
+check "long lines on a pipe" "3 70000" 'cat long long long | { n=0; while read -r l; do n=$((n + 1)); len=${#l}; done; echo $n $len; }'
+
+exit $failed
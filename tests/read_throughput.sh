@@ -0,0 +1,30 @@
+#!/bin/sh
+# line by line read benchmark. reads a large file of 1 KB lines with while read, from a redirection and from a pipe into
+# a compound command, and prints the rates, and fails if either loop doesn't count every line
+# usage: read_throughput.sh YASH [MEGABYTES]
+
+yash=$1
+megabytes=${2:-1024}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+lines=$((megabytes * 1024))
+yes "$(head -c 1023 /dev/zero | tr '\0' x)" | head -n $lines > lines || exit 1
+
+loop='n=0; while read -r l; do n=$((n + 1)); done'
+for source in file pipe; do
+    case $source in
+        file) script="$loop < lines; echo \$n" ;;
+        pipe) script="cat lines | { $loop; echo \$n; }" ;;
+    esac
+    start=$(date +%s.%N)
+    got=$("$yash" --norc -c "$script")
+    end=$(date +%s.%N)
+    if [ "$got" != "$lines" ]; then
+        echo "reading from a $source: counted '$got' lines instead of $lines"
+        exit 1
+    fi
+    awk -v source="$source" -v mb="$megabytes" -v lines="$lines" -v start="$start" -v end="$end" \
+        'BEGIN { printf "%-4s %6d MB in %.2fs, %.0f MB/s, %.0f lines/s\n", source, mb, end - start,
+                 mb / (end - start), lines / (end - start) }'
+done
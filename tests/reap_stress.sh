@@ -0,0 +1,74 @@
+#!/bin/sh
+# reaping stress test. starts thousands of short background jobs that finish together while the shell waits on a
+# foreground command, with fg and bg in between, and checks that every job is reported done exactly once and that
+# the jobs table ends empty. prints how many exits per second were reaped
+# usage: reap_stress.sh YASH [BATCHES [JOBS_PER_BATCH]]
+
+yash=$1
+batches=${2:-6}
+perBatch=${3:-500}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+# jN jobs run in the background and have to be reported done. fN are brought back with fg and bN stop themselves in
+# the foreground and are continued with bg, which makes them background jobs that are reported as well
+b=0
+while [ "$b" -lt "$batches" ]; do
+    awk -v b="$b" -v n="$perBatch" 'BEGIN {
+        for(i = 0; i < n; i++) printf "sh -c \"sleep 0.5\" j%d_%d &\n", b, i
+        print "/bin/sleep 0.7"
+        printf "sh -c \"sleep 0.05\" f%d &\nfg\n", b
+        printf "sh -c \"kill -STOP \\$\\$; exit 0\" b%d\nbg\n", b
+        print "/bin/true"
+    }'
+    b=$((b + 1))
+done > "$dir/script"
+# the last jobs get time to finish on their own, wait would take them without a report
+printf '/bin/sleep 0.6\nwait\njobs\n' >> "$dir/script"
+
+start=$(date +%s.%N)
+"$yash" --norc < "$dir/script" > "$dir/out" 2>&1
+end=$(date +%s.%N)
+
+awk -v batches="$batches" -v perBatch="$perBatch" -v start="$start" -v end="$end" '
+    / DONE / {
+        name = $NF == "&" ? $(NF - 1) : $NF
+        done[name]++
+    }
+    /No active jobs$/ { empty = NR }
+    { last = NR }
+    END {
+        failed = 0
+        for(b = 0; b < batches; b++)
+        {
+            for(i = 0; i < perBatch; i++)
+            {
+                name = "j" b "_" i
+                if(done[name] != 1)
+                {
+                    printf "%s reported done %d times\n", name, done[name]
+                    failed = 1
+                }
+            }
+            if(done["b" b] != 1)
+            {
+                printf "b%d reported done %d times\n", b, done["b" b]
+                failed = 1
+            }
+            if(done["f" b] != 0)
+            {
+                printf "f%d was reported done after fg\n", b
+                failed = 1
+            }
+        }
+        if(!empty)
+        {
+            print "the jobs table is not empty at the end"
+            failed = 1
+        }
+        # the foreground sleeps are left out of the rate
+        exits = batches * (perBatch + 2)
+        busy = end - start - batches * 0.75 - 0.6
+        printf "%d jobs reaped in %.2fs, %.0f exits/s outside of the sleeps\n", exits, end - start, exits / busy
+        exit failed
+    }' "$dir/out" || { tail -20 "$dir/out"; exit 1; }
@@ -0,0 +1,91 @@
+#!/bin/sh
+# command server tests and throughput benchmark. checks what yash --client gets back from a yash --serve started with
+# an rc file, then times requests over persistent connections against starting yash -c for each command, and fails if
+# serving a command is not faster than starting a shell for it
+# usage: serve.sh YASH SERVE_BENCH [REQUESTS]
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+bench=$2
+requests=${3:-2000}
+home=$(mktemp -d)
+socket=$home/socket
+server=
+trap '[ -n "$server" ] && kill $server; rm -rf "$home"' EXIT
+cd "$home" || exit 1
+failed=0
+
+cat > "$home/.yashrc" <<'EOF'
+greet() { echo "hello $1"; }
+where=rc
+EOF
+# a path that is not a socket is never replaced
+echo kept > "$home/file"
+timeout 5 "$yash" --norc --serve "$home/file" 2> /dev/null
+if [ $? != 2 ] || [ "$(cat "$home/file")" != kept ]; then
+    echo "serving on a file: the file was replaced"
+    failed=1
+fi
+
+HOME=$home "$yash" --serve "$socket" --limit 4 &
+server=$!
+n=0
+while [ ! -S "$socket" ] && [ $n -lt 100 ]; do
+    sleep 0.05
+    n=$((n + 1))
+done
+
+# check NAME EXPECTED SCRIPT. sends SCRIPT with --client and compares its output and status with EXPECTED
+check()
+{
+    report "$1" "$2" "$("$yash" --client "$socket" -c "$3" 2>&1; echo "status $?")"
+}
+
+check "output" "hi
+status 0" 'echo hi'
+check "status" "status 3" 'exit 3'
+check "rc functions and variables" "hello rc
+status 0" 'greet $where'
+"$yash" --client "$socket" -c 'x=1'
+check "no state kept between requests" "<>
+status 0" 'echo "<$x>"'
+check "input" "piped
+status 0" 'cat' <<EOF
+piped
+EOF
+check "redirection" "written
+status 0" 'echo written > out; cat out'
+
+# another user's commands are refused even when the socket lets them connect
+nobody="setpriv --reuid=65534 --regid=65534 --clear-groups"
+if [ "$(id -u)" = 0 ] && command -v setpriv > /dev/null && $nobody "$yash" --norc -c true 2> /dev/null; then
+    chmod 755 "$home"
+    chmod 777 "$socket"
+    got=$($nobody "$yash" --client "$socket" -c 'echo ran' 2> /dev/null)
+    if [ $? != 127 ] || [ -n "$got" ]; then
+        echo "other user: the command ran and printed '$got'"
+        failed=1
+    fi
+fi
+[ $failed = 0 ] || exit 1
+
+# one connection shows the cost of a single request, as many connections as the limit show the workers overlapping
+"$bench" "$socket" 1 "$requests" true > one || exit 1
+"$bench" "$socket" 4 "$((requests / 4))" true > four || exit 1
+spawns=$((requests / 10))
+start=$(date +%s%N)
+i=0
+while [ $i -lt $spawns ]; do
+    "$yash" --norc -c true || exit 1
+    i=$((i + 1))
+done
+end=$(date +%s%N)
+spawn=$(((end - start) / 1000 / spawns))
+served=$(sed 's/.* \([0-9]*\)us per request/\1/' one)
+echo "served, $(cat one)"
+echo "served, $(cat four)"
+echo "yash -c true, ${spawn}us per command"
+if [ "$served" -ge "$spawn" ]; then
+    echo "serving a command is not faster than starting yash for it"
+    exit 1
+fi
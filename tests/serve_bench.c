@@ -0,0 +1,101 @@
+//
+// throughput client for serve.sh. serve_bench SOCKET CONNECTIONS REQUESTS COMMAND opens CONNECTIONS connections to a
+// yash --serve socket at once, each in its own process, and sends COMMAND REQUESTS times over each, the way a
+// long lived client would. prints the requests per second and exits 1 if any request didn't answer 0
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+// sends requests copies of command on one connection, each with stdin from /dev/null and this process's stdout and
+// stderr. returns the number of requests that didn't answer 0
+static int sendRequests(char *path, int requests, char *command)
+{
+    struct sockaddr_un address;
+    int fds[3] = {open("/dev/null", O_RDONLY), STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(fds))];
+    int connection = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    int failed = 0;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    if(fds[0] == -1 || connection == -1 || connect(connection, (struct sockaddr *) &address, sizeof(address)) == -1)
+    {
+        perror(path);
+        return requests;
+    }
+    for(int i=0; i<requests; i++)
+    {
+        struct iovec iov = {command, strlen(command)};
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        memset(control, 0, sizeof(control));
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+        int32_t reply;
+        if(sendmsg(connection, &message, MSG_NOSIGNAL) == -1 ||
+           recv(connection, &reply, sizeof(reply), 0) != sizeof(reply))
+        {
+            fprintf(stderr, "serve_bench: no answer from the server\n");
+            return failed + requests - i;
+        }
+        if(reply != 0) failed++;
+    }
+    close(connection);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc != 5 || atoi(argv[2]) < 1 || atoi(argv[3]) < 1)
+    {
+        fprintf(stderr, "usage: serve_bench SOCKET CONNECTIONS REQUESTS COMMAND\n");
+        return 2;
+    }
+    int connections = atoi(argv[2]);
+    int requests = atoi(argv[3]);
+    struct timespec start, end;
+    int failed = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int c=0; c<connections; c++)
+    {
+        int pid = fork();
+        if(pid == 0) _exit(sendRequests(argv[1], requests, argv[4]) ? 1 : 0);
+        if(pid < 0)
+        {
+            perror("fork");
+            return 1;
+        }
+    }
+    int status;
+    while(wait(&status) > 0)
+    {
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed = 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+    double total = (double) connections * requests;
+    printf("%d connections x %d requests in %.2fs, %.0f requests/s, %.0fus per request\n", connections, requests,
+           seconds, total / seconds, seconds * 1e6 / total);
+    if(failed) fprintf(stderr, "serve_bench: a request didn't answer 0\n");
+    return failed;
+}
@@ -0,0 +1,57 @@
+#!/bin/sh
+# startup benchmark. times yash -c true with an rc file, cold with no rc cache and warm with the cache in place, and
+# fails if either average goes past the budget or the cache isn't used
+# usage: startup.sh YASH [RUNS [BUDGET_US]]
+
+yash=$1
+runs=${2:-50}
+budget=${3:-20000}
+home=$(mktemp -d)
+trap 'rm -rf "$home"' EXIT
+
+# an rc file of over a hundred lines with comments, the size a long lived one grows to
+i=0
+while [ $i -lt 40 ]; do
+    cat >> "$home/.yashrc" <<EOF
+# settings $i, don't edit "by hand"
+var$i="value \$HOME $i" # trailing comment
+func$i() { for w in \$@; do case \$w in -*) echo flag;; *) echo \$w | cat;; esac; done; }
+case \$HOME in /*) dir$i=/tmp;; *) dir$i=/;; esac
+EOF
+    i=$((i + 1))
+done
+
+# time RUNS startups, removing the cache before each when the first argument is cold. prints the average in us
+average()
+{
+    total=0
+    n=0
+    while [ $n -lt "$runs" ]; do
+        [ "$1" = cold ] && rm -f "$home/.yashrc.cache"
+        start=$(date +%s%N)
+        HOME=$home "$yash" -c true || exit 1
+        end=$(date +%s%N)
+        total=$((total + end - start))
+        n=$((n + 1))
+    done
+    echo $((total / 1000 / runs))
+}
+
+# the comments are skipped without errors and leave the assignments before them alone
+got=$(HOME=$home "$yash" -c 'echo $var0 $var39' 2>&1)
+if [ "$got" != "value $home 0 value $home 39" ]; then
+    printf 'rc with comments: expected\nvalue %s 0 value %s 39\ngot\n%s\n' "$home" "$home" "$got"
+    exit 1
+fi
+cold=$(average cold)
+HOME=$home "$yash" -c true
+if [ ! -s "$home/.yashrc.cache" ]; then
+    echo "no rc cache was written"
+    exit 1
+fi
+warm=$(average warm)
+echo "cold ${cold}us, warm ${warm}us, budget ${budget}us"
+if [ "$cold" -gt "$budget" ] || [ "$warm" -gt "$budget" ]; then
+    echo "startup is over budget"
+    exit 1
+fi
@@ -0,0 +1,41 @@
+#!/bin/sh
+# process count tests for running the last command in place. a command run in place takes over the process that
+# would have forked it, so it sees that process as its own pid and no extra process is started for it
+# usage: tail_exec.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+
+# the last command prints whether its pid is the shell's, which only happens when it replaced the shell
+pid='sh -c "test \$\$ = $$ && echo same || echo forked"'
+check "last command" "same" "$pid"
+check "after a command" "same" "true; $pid"
+check "right of &&" "same" "true && $pid"
+check "last branch of if" "same" "if true; then $pid; fi"
+check "last item of case" "same" "case a in a) $pid;; esac"
+check "not before the end" "forked
+same" "$pid; $pid"
+check "not in a loop" "forked" "for i in 1; do $pid; done"
+check "not with --notailexec" "forked" "$pid" --notailexec
+
+# a forked subshell runs its last command in the subshell's own process, so the command's parent is the shell
+"$yash" --norc -c '(sh -c "echo \$PPID" > parent); echo $$ > shell'
+if [ "$(cat parent)" != "$(cat shell)" ]; then
+    echo "subshell: the command's parent is $(cat parent), not the shell $(cat shell)"
+    failed=1
+fi
+
+# a command left with nothing but redirections only opens its files, in place or not
+check "redirections only" "0" "> made; echo \$?"
+"$yash" --norc -c '> last'
+status=$?
+if [ $status != 0 ] || [ ! -e made ] || [ ! -e last ]; then
+    echo "redirections only: status $status, files $(ls)"
+    failed=1
+fi
+
+exit $failed
@@ -0,0 +1,58 @@
+#!/bin/sh
+# timeout prefix tests. checks the status of timed commands, the options of the prefix and that a timed job leaves none
+# of its processes behind
+# usage: timeout.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+failed=0
+
+# prints the number of processes running COMMAND LINE, read from /proc so no ps is needed
+running()
+{
+    count=0
+    for cmdline in /proc/[0-9]*/cmdline; do
+        [ "$(tr '\0' ' ' < "$cmdline" 2>/dev/null)" = "$1 " ] && count=$((count + 1))
+    done
+    echo $count
+}
+
+check "finished in time" "0" 'timeout 5 true; echo $?'
+check "status kept" "3" 'timeout 5 sh -c "exit 3"; echo $?'
+check "timed out" "124" 'timeout 0.2 sleep 5; echo $?'
+check "built in" "0 1" 'timeout 1 true; a=$?; timeout 1 false; echo $a $?'
+check "built in output" "hi" 'timeout 1 echo hi'
+check "function" "in f" 'f(){ echo in f; }; timeout 1 f'
+check "pipeline" "124" 'timeout 0.2 sh -c "sleep 5 | cat"; echo $?'
+usage="yash: timeout: usage: timeout [-k DURATION] [-s SIGNAL] [--preserve-status] DURATION COMMAND [ARG ...]"
+check "usage" "$usage
+125" 'timeout 1; echo $?'
+check "signal" "124 137" 'timeout -s INT 0.2 sleep 5; a=$?; timeout --signal=SIGKILL 0.2 sleep 5; echo $a $?'
+check "signal number" "143" 'timeout -s 15 --preserve-status 0.2 sleep 5; echo $?'
+check "bad signal" "$usage
+125" 'timeout -s NOPE 1 true; echo $?'
+check "preserve status" "130 3" 'timeout --preserve-status -s INT 0.2 sleep 5; a=$?
+timeout --preserve-status 5 sh -c "exit 3"; echo $a $?'
+check "kill after" "124" 'timeout --kill-after=0.1 0.2 sh -c "trap \"\" TERM; while :; do :; done"; echo $?'
+check "end of options" "0" 'timeout -- 1 true; echo $?'
+# an option the prefix doesn't know is left to the timeout program
+if command -v timeout > /dev/null; then
+    check "other options" "124" 'timeout --foreground 0.2 sleep 5; echo $?'
+fi
+
+# the sleep is a grandchild of the shell, only reached through the job's process group. the output goes to a file
+# since a leftover sleep would hold a pipe open until it finished
+out=$(mktemp)
+trap 'rm -f "$out"' EXIT
+"$yash" --norc -c "timeout 0.3 sh -c 'sleep 4.25; echo x'; echo \$?" > "$out"
+if [ "$(cat "$out")" != 124 ]; then
+    printf 'grandchild killed: expected 124, got %s\n' "$(cat "$out")"
+    failed=1
+fi
+sleep 0.2
+if [ "$(running "sleep 4.25")" != 0 ]; then
+    echo "grandchild killed: sleep is still running"
+    failed=1
+fi
+
+exit $failed
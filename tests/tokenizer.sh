@@ -0,0 +1,29 @@
+#!/bin/sh
+# tokenizer tests. runs lines where quotes, expansions, escapes, operators, blanks and non ASCII bytes come right
+# after plain words of every length up to a few vector blocks and some much longer ones, and compares the output
+# with /bin/sh running the same lines. the words are skipped a block at a time, so each byte that ends one lands at
+# every offset in a block
+# usage: tokenizer.sh YASH
+
+yash=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+for n in $(seq 1 70) 4095 4096 4097 30000; do
+    w=$(head -c $n /dev/zero | tr '\0' a)
+    printf "v=val; printf '[%%s]\\\\n' %s'q'%s\"d\"%s\$v\\\\ %s\n" $w $w $w $w
+    printf "printf '[%%s]\\\\n' %s;printf '[%%s]\\\\n' %s\n" $w $w
+    printf "printf '[%%s]\\\\n' %s|cat\n" $w
+    printf "printf '[%%s]\\\\n' %s>f;cat<f\n" $w
+    printf "printf '[%%s]\\\\n'\t%s\t%s\n" $w $w
+    printf "printf '[%%s]\\\\n' %s\303\251\377%s\n" $w $w
+done > lines
+
+sh lines > expected 2>&1
+"$yash" --norc lines > got 2>&1
+if ! cmp -s expected got; then
+    echo "tokenizer: output differs from sh, first difference at"
+    cmp expected got
+    exit 1
+fi
@@ -0,0 +1,35 @@
+#!/bin/sh
+# tokenizer microbenchmark. runs scripts of long lines of 4 KB words, from 1 KB to 1 MB per line, with the tokenizer
+# capped at each vector level by YASH_SIMD and prints the rates, and fails if a script doesn't run to its end
+# usage: tokenizer_throughput.sh YASH [MEGABYTES]
+
+yash=$1
+megabytes=${2:-64}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+for kilobytes in 1 16 256 1024; do
+    # each line is : and words of up to 4 KB, padded out to the size
+    lines=$((megabytes * 1024 / kilobytes))
+    awk -v lines=$lines -v size=$((kilobytes * 1024)) 'BEGIN {
+        word = sprintf("%4095s", ""); gsub(/ /, "a", word)
+        line = ":"
+        while(length(line) + 4096 <= size) line = line " " word
+        if(length(line) + 1 < size) line = line " " substr(word, 1, size - length(line) - 1)
+        for(i = 0; i < lines; i++) print line
+        print "echo done"
+    }' > script || exit 1
+    for level in scalar sse2 avx2; do
+        start=$(date +%s.%N)
+        got=$(YASH_SIMD=$level "$yash" --norc script)
+        end=$(date +%s.%N)
+        if [ "$got" != done ]; then
+            echo "$kilobytes KB lines with $level: got '$got'"
+            exit 1
+        fi
+        awk -v kb="$kilobytes" -v level="$level" -v mb="$megabytes" -v start="$start" -v end="$end" \
+            'BEGIN { printf "%5d KB lines, %-6s %4d MB in %.2fs, %.0f MB/s\n", kb, level, mb, end - start,
+                     mb / (end - start) }'
+    done
+done
@@ -0,0 +1,43 @@
+#!/bin/sh
+# wait built in tests. checks waiting for jobs by %n, by pid and all at once, -n, -p, --timeout, the statuses kept for
+# jobs that finished before the wait, unknown jobs, a wait cut short by SIGINT and SIGINT with no foreground job
+# usage: wait.sh YASH
+
+. "$(dirname "$0")/lib.sh"
+yash=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+
+# a job that outlives the shell. it closes stderr, so the output of a check ends when the shell does
+long='sh -c "exec sleep 5 2> /dev/null"'
+check "by job number" "3" 'sh -c "exit 3" & wait %1; echo $?'
+check "by pid" "3" 'sh -c "exit 3" & p=$!; wait $p; echo $?'
+check "status of the last operand" "6" 'sh -c "exit 2" & sh -c "exit 6" & wait %1 %2; echo $?'
+check "every job" "0
+done
+No active jobs" 'sh -c "sleep 0.2; echo done > f; exit 5" & wait; echo $?; cat f; jobs'
+check "-n" "4" "$long"' & sh -c "exit 4" & wait -n; echo $?'
+check "-p" "4 same" "$long"' & sh -c "exit 4" & q=$!; wait -n -p who; a=$?; test "$who" = "$q" && echo $a same'
+check "finished before the wait" "7" 'sh -c "exit 7" & sleep 0.3; wait %1; echo $?'
+check "no such job" "yash: wait: %9: no such job
+127" 'wait %9; echo $?'
+check "no such pid" "yash: wait: 99999999: no such job
+127" 'wait 99999999; echo $?'
+check "interrupted" "130" "$long"' & sh -c "sleep 0.2; kill -INT $$" & wait %1; echo $?'
+# with nothing in the foreground SIGINT must not reach the last background job, here the writer the read waits for
+mkfifo fifo
+report "interrupted with no foreground job" "x" "$(timeout 5 "$yash" --norc -c 'sh -c "sleep 0.1; kill -INT $$" &
+sh -c "sleep 0.3; echo x > fifo" & read line < fifo; echo "$line"' 2>&1)"
+
+# --timeout gives up long before the job ends
+start=$(date +%s%N)
+check "--timeout" "124" "$long"' & wait --timeout 0.2 %1; echo $?'
+took=$((($(date +%s%N) - start) / 1000000))
+if [ $took -gt 2000 ]; then
+    echo "--timeout: returned after ${took}ms"
+    failed=1
+fi
+
+exit $failed
@@ -0,0 +1,45 @@
+//
+// layout of the job board yash --board name keeps in the POSIX shared memory object name, for monitors that read it
+//
+
+#ifndef YASH_BOARD_H
+#define YASH_BOARD_H
+
+#include <stdint.h>
+
+#define BOARD_MAGIC "YASHJOBS"
+#define BOARD_VERSION 1
+#define BOARD_SLOTS 64
+#define BOARD_PROCS 8
+#define BOARD_LINE_MAX 256
+#define BOARD_RUNNING 1
+#define BOARD_STOPPED 2
+#define BOARD_DONE 3
+#define BOARD_TIMED_OUT 4
+
+// the job table as other processes see it with --board name, in the shared memory object name. a reader maps it read
+// only and copies what it needs while sequence is unchanged and even, the shell makes it odd while writing
+struct BoardSlot
+{
+    int32_t pid;       //first process of the job
+    int32_t pgid;
+    int32_t task_no;
+    int32_t state;     //BOARD_RUNNING, BOARD_STOPPED, BOARD_DONE or BOARD_TIMED_OUT
+    int64_t startedNs; //ns on CLOCK_REALTIME
+    int32_t procCount; //processes started for the job, the first BOARD_PROCS are in pids
+    int32_t pids[BOARD_PROCS];
+    char line[BOARD_LINE_MAX]; //command line, cut short and always nul terminated
+};
+struct JobBoard
+{
+    char magic[8];     //BOARD_MAGIC
+    uint32_t version;  //BOARD_VERSION, changes with the layout
+    uint32_t sequence; //seqlock, odd while the shell is writing
+    int32_t shellPid;  //the board is stale once this process is gone
+    int32_t count;     //slots in use
+    int32_t total;     //jobs in the table, more than count when they didn't fit
+    int32_t reserved;
+    struct BoardSlot slots[BOARD_SLOTS];
+};
+
+#endif //YASH_BOARD_H
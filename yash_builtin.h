@@ -0,0 +1,36 @@
+//
+// C interface for built in commands loaded into yash with 'enable -f library name'
+//
+
+#ifndef YASH_BUILTIN_H
+#define YASH_BUILTIN_H
+
+// a library is only loaded when the abi it was built against is the shell's. the number goes up whenever one of the
+// structs below changes in a way old libraries would get wrong
+#define YASH_BUILTIN_ABI 1
+
+// the shell's side of the interface, handed to every call of a built in
+struct YashShell
+{
+    int abi;  //YASH_BUILTIN_ABI of the shell
+    // returns the value of a shell variable, NULL when it isn't set. the value stays valid until the variable changes
+    const char *(*getVar)(const char *name);
+    // sets a shell variable. returns -1 for an invalid name
+    int (*setVar)(const char *name, const char *value);
+    // unsets a shell variable. returns -1 for an invalid name
+    int (*unsetVar)(const char *name);
+};
+
+// runs the built in in the shell process. argv[0] is the name it was called by and argv[argc] is NULL. in, out and
+// err are the command's stdin, stdout and stderr. returns the exit status of the command
+typedef int (*YashBuiltinRun)(int argc, char **argv, int in, int out, int err, const struct YashShell *shell);
+
+// what a library exports for each built in it has, as a variable named yash_builtin_NAME
+struct YashBuiltin
+{
+    int abi;          //YASH_BUILTIN_ABI the library was built against
+    const char *name; //name the command is called by, the NAME of the variable
+    YashBuiltinRun run;
+};
+
+#endif //YASH_BUILTIN_H